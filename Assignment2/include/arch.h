@@ -26,5 +26,10 @@ static constexpr size_t MaxRegs = 256;
  */
 static constexpr uint32_t TestEndMarker = 0x40ffccff;
 
+/* Encoding of "l.nop 0x0". Pipeline registers are initialized with this
+ * instruction, such that bubbles travel through the pipeline as no-ops.
+ */
+static constexpr uint32_t NopInstructionWord = 0x15000000;
+
 
 #endif /* __ARCH_H__ */
@@ -0,0 +1,254 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    branch-predictor.h - Branch prediction in the fetch stage.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __BRANCH_PREDICTOR_H__
+#define __BRANCH_PREDICTOR_H__
+
+#include "arch.h"
+#include "symbol-table.h"
+
+#include <map>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+enum class BranchPredictorType
+{
+  NotTaken,
+  BackwardTaken,
+  Bimodal,
+  GShare,
+  Tournament
+};
+
+struct BranchPredictorConfig
+{
+  BranchPredictorType type = BranchPredictorType::NotTaken;
+
+  unsigned int tableBits = 10;   /* log2 of the number of counters */
+  unsigned int historyBits = 10; /* global history length (gshare) */
+  size_t btbEntries = 64;        /* branch target buffer, power of 2 */
+  size_t rasDepth = 8;           /* return address stack */
+};
+
+/* Kind of control transfer, as recorded in the branch target buffer. */
+enum class BranchKind
+{
+  None,
+  Conditional,  /* l.bf, l.bnf */
+  Jump,         /* l.j */
+  Call,         /* l.jal */
+  Return,       /* l.jr r9 */
+  Indirect      /* l.jr to any other register */
+};
+
+
+/*
+ * Direction predictors
+ */
+
+class BranchPredictor
+{
+  public:
+    virtual ~BranchPredictor() = default;
+
+    virtual bool predict(MemAddress pc, MemAddress target) const = 0;
+    virtual void update(MemAddress pc, MemAddress target, bool taken) = 0;
+};
+
+class StaticNotTakenPredictor : public BranchPredictor
+{
+  public:
+    bool predict(MemAddress pc, MemAddress target) const override;
+    void update(MemAddress pc, MemAddress target, bool taken) override;
+};
+
+/* Backward branches are usually loop branches and thus taken. */
+class StaticBackwardTakenPredictor : public BranchPredictor
+{
+  public:
+    bool predict(MemAddress pc, MemAddress target) const override;
+    void update(MemAddress pc, MemAddress target, bool taken) override;
+};
+
+/* Table of 2-bit saturating counters indexed by the branch address. */
+class BimodalPredictor : public BranchPredictor
+{
+  public:
+    BimodalPredictor(unsigned int tableBits);
+
+    bool predict(MemAddress pc, MemAddress target) const override;
+    void update(MemAddress pc, MemAddress target, bool taken) override;
+
+  private:
+    std::vector<uint8_t> counters;
+
+    size_t index(MemAddress pc) const;
+};
+
+/* 2-bit counters indexed by the branch address XOR the global history
+ * of branch outcomes. The history is updated when a branch resolves.
+ */
+class GSharePredictor : public BranchPredictor
+{
+  public:
+    GSharePredictor(unsigned int tableBits, unsigned int historyBits);
+
+    bool predict(MemAddress pc, MemAddress target) const override;
+    void update(MemAddress pc, MemAddress target, bool taken) override;
+
+  private:
+    std::vector<uint8_t> counters;
+    uint32_t history{};
+    const uint32_t historyMask;
+
+    size_t index(MemAddress pc) const;
+};
+
+/* Chooses between a bimodal and a gshare predictor per branch, using
+ * a table of 2-bit counters that tracks which of the two was right.
+ */
+class TournamentPredictor : public BranchPredictor
+{
+  public:
+    TournamentPredictor(unsigned int tableBits, unsigned int historyBits);
+
+    bool predict(MemAddress pc, MemAddress target) const override;
+    void update(MemAddress pc, MemAddress target, bool taken) override;
+
+  private:
+    BimodalPredictor bimodal;
+    GSharePredictor gshare;
+    std::vector<uint8_t> chooser;
+
+    size_t index(MemAddress pc) const;
+};
+
+std::unique_ptr<BranchPredictor>
+makeBranchPredictor(const BranchPredictorConfig &config);
+
+
+/*
+ * Branch target buffer and return address stack
+ */
+
+/* Direct-mapped, tagged with the full branch address. Only taken
+ * control transfers are allocated.
+ */
+class BranchTargetBuffer
+{
+  public:
+    BranchTargetBuffer(size_t nEntries);
+
+    bool lookup(MemAddress pc, MemAddress &target, BranchKind &kind) const;
+    void update(MemAddress pc, MemAddress target, BranchKind kind);
+
+  private:
+    struct Entry
+    {
+      bool valid{};
+      MemAddress pc{};
+      MemAddress target{};
+      BranchKind kind{};
+    };
+
+    std::vector<Entry> entries;
+};
+
+/* Circular stack; on overflow the oldest return address is lost. */
+class ReturnAddressStack
+{
+  public:
+    ReturnAddressStack(size_t depth);
+
+    void push(MemAddress addr);
+    bool pop(MemAddress &addr);
+
+  private:
+    std::vector<MemAddress> stack;
+    size_t top{};
+    size_t count{};
+};
+
+
+/*
+ * Branch prediction unit, queried in IF and trained in EX.
+ */
+
+struct BranchPrediction
+{
+  bool taken{};
+  MemAddress target{};
+};
+
+class BranchPredictionUnit
+{
+  public:
+    BranchPredictionUnit(const BranchPredictorConfig &config);
+
+    BranchPredictionUnit(const BranchPredictionUnit &) = delete;
+    BranchPredictionUnit &operator=(const BranchPredictionUnit &) = delete;
+
+    /* Predicts whether the instruction fetched from pc transfers control
+     * to another address after its delay slot. linkAddress is the return
+     * address pushed in case the instruction is a call.
+     */
+    BranchPrediction predict(MemAddress pc, MemAddress linkAddress);
+
+    /* Trains the predictor with the actual outcome of a control transfer
+     * instruction. correct tells whether fetch continued at the right
+     * address after the delay slot.
+     */
+    void resolve(MemAddress pc, BranchKind kind, bool taken,
+                 MemAddress target, bool correct);
+
+    uint64_t getBranches() const { return nBranches; }
+    uint64_t getMispredictions() const { return nMispredictions; }
+
+    /* Every taken control transfer costs the squashed fetches without
+     * prediction; with prediction only the mispredictions do.
+     */
+    int64_t getCyclesSaved() const
+    {
+      return (static_cast<int64_t>(nTaken) -
+              static_cast<int64_t>(nMispredictions)) * mispredictPenalty;
+    }
+
+    /* Wrong-path instructions squashed per misprediction */
+    void setMispredictPenalty(unsigned int cycles)
+    {
+      mispredictPenalty = cycles;
+    }
+
+    void dumpStatistics(std::ostream &os, const SymbolTable &symbols) const;
+
+  private:
+    /* Static not-taken: fetch is always sequential, as without a
+     * branch predictor.
+     */
+    bool sequential;
+
+    std::unique_ptr<BranchPredictor> direction;
+    BranchTargetBuffer btb;
+    ReturnAddressStack ras;
+
+    /* Statistics */
+    struct BranchStatistics
+    {
+      uint64_t executed{};
+      uint64_t taken{};
+      uint64_t correct{};
+    };
+
+    std::map<MemAddress, BranchStatistics> branches{};
+    uint64_t nBranches{};
+    uint64_t nTaken{};
+    uint64_t nMispredictions{};
+    unsigned int mispredictPenalty{ 1 };
+};
+
+#endif /* __BRANCH_PREDICTOR_H__ */
@@ -0,0 +1,129 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    cache.h - Set-associative cache timing model.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include "arch.h"
+
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+enum class ReplacementPolicy
+{
+  LRU,
+  PLRU,    /* tree-based pseudo-LRU */
+  Random
+};
+
+struct CacheConfig
+{
+  size_t size = 0;               /* bytes, 0 disables the cache */
+  size_t lineSize = 32;          /* bytes */
+  size_t associativity = 4;
+  ReplacementPolicy replacement = ReplacementPolicy::LRU;
+  bool writeBack = true;         /* write-through otherwise */
+  bool writeAllocate = true;
+
+  unsigned int hitLatency = 1;   /* cycles */
+  unsigned int missPenalty = 20; /* cycles to transfer a line */
+};
+
+/* A level of the memory hierarchy below the L1 caches. access() returns
+ * the number of processor cycles needed to access addr.
+ */
+class MemoryLevel
+{
+  public:
+    virtual ~MemoryLevel() = default;
+
+    virtual unsigned int access(MemAddress addr, bool write) = 0;
+};
+
+/* The cache only models timing: it keeps tags, but no data. Memory
+ * contents are always read from and written to the memory bus, such
+ * that the cache cannot change the behavior of a program.
+ *
+ * Misses and write-backs go to the next level of the hierarchy when
+ * one is given; otherwise they cost a fixed missPenalty.
+ */
+class Cache : public MemoryLevel
+{
+  public:
+    Cache(std::string_view name, const CacheConfig &config,
+          MemoryLevel *next = nullptr);
+
+    Cache(const Cache &) = delete;
+    Cache &operator=(const Cache &) = delete;
+
+    /* Looks up addr and updates the cache state as if the access was
+     * performed. Returns the number of cycles the access takes.
+     */
+    unsigned int access(MemAddress addr, bool write) override;
+
+    /* Brings the line holding addr into the cache without counting a
+     * demand access. Returns the number of cycles the fill takes.
+     */
+    unsigned int prefetch(MemAddress addr);
+
+    bool contains(MemAddress addr) const;
+
+    const std::string &getName() const { return name; }
+    const CacheConfig &getConfig() const { return config; }
+
+    uint64_t getAccesses() const { return nHits + nMisses; }
+    uint64_t getHits() const { return nHits; }
+    uint64_t getMisses() const { return nMisses; }
+    uint64_t getEvictions() const { return nEvictions; }
+    uint64_t getWriteBacks() const { return nWriteBacks; }
+
+    void dumpStatistics(std::ostream &os) const;
+
+  private:
+    struct Line
+    {
+      bool valid{};
+      bool dirty{};
+      MemAddress tag{};
+      uint64_t lastUse{};
+    };
+
+    std::string name;
+    CacheConfig config;
+    MemoryLevel *next;  /* no ownership */
+
+    size_t nSets;
+    unsigned int offsetBits;
+    unsigned int indexBits;
+
+    std::vector<Line> lines{};       /* nSets * associativity */
+    std::vector<uint64_t> plru{};    /* tree bits, one word per set */
+    std::minstd_rand random{};
+    uint64_t useCounter{};
+
+    /* Statistics */
+    uint64_t nHits{};
+    uint64_t nMisses{};
+    uint64_t nEvictions{};
+    uint64_t nWriteBacks{};
+
+    size_t getSet(MemAddress addr) const;
+    MemAddress getTag(MemAddress addr) const;
+    MemAddress getLineAddress(size_t set, MemAddress tag) const;
+    Line *find(size_t set, MemAddress tag);
+    const Line *find(size_t set, MemAddress tag) const;
+
+    size_t findVictim(size_t set);
+    unsigned int fill(size_t set, MemAddress tag, bool dirty);
+    void touch(size_t set, size_t way);
+
+    unsigned int accessNext(MemAddress addr, bool write);
+};
+
+#endif /* __CACHE_H__ */
@@ -1,7 +1,18 @@
+#ifndef __CONTROL_SIGNALS_H__
+#define __CONTROL_SIGNALS_H__
+
 #include "arch.h"
 #include "inst-decoder-enums.h"
 #include "alu.h"
 
+/* Unit of EX that executes an instruction. */
+enum class ExecutionUnit
+{
+  ALU,
+  Multiplier,
+  Divider
+};
+
 enum class InputSelectorIFStage
 {
   InputOne,
@@ -31,6 +42,19 @@ enum class InputSelectorWBStage
   LAST
 };
 
+/* Selects where an operand is taken from: the value read from the
+ * register file, or a result forwarded from the EX/M, M/M2 (split
+ * memory stage only) or M/WB pipeline register.
+ */
+enum class InputSelectorForward
+{
+  RegisterFile,
+  EX_M,
+  M_M2,
+  M_WB,
+  LAST
+};
+
 
 
 class ControlSignals
@@ -53,6 +77,7 @@ public:
     bool jump(bool FLAG) const;
     bool setLinkRegister() const;
     bool signExtendedRead() const;
+    ExecutionUnit getExecutionUnit() const;
 
     // Setter methods for various control signals
     void setOpcode(uint16_t newOpCode) { this->opCode = newOpCode; };
@@ -63,4 +88,6 @@ private:
     uint16_t opCode;
     InstructionMnemonic functionCode;
 
-};
\ No newline at end of file
+};
+
+#endif /* __CONTROL_SIGNALS_H__ */
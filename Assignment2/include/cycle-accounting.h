@@ -0,0 +1,110 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    cycle-accounting.h - Attribution of cycles to stall reasons.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __CYCLE_ACCOUNTING_H__
+#define __CYCLE_ACCOUNTING_H__
+
+#include "arch.h"
+#include "symbol-table.h"
+
+#include <array>
+#include <deque>
+#include <ostream>
+#include <unordered_map>
+
+/* Every cycle is attributed to exactly one category. A cycle in which
+ * an instruction completes is a base cycle; otherwise the cycle is
+ * charged to the reason the retiring stage received no instruction.
+ */
+enum class CycleCategory
+{
+  Base,
+  BranchMispredict,  /* wrong-path instructions squashed */
+  DataHazard,        /* waiting for a result other than a load */
+  LoadUse,           /* waiting for a load directly ahead */
+  ICacheMiss,        /* slow instruction fetch */
+  DCacheMiss,        /* slow data access */
+  Structural,        /* waiting for a functional unit or the bus */
+  Drain,             /* emptying the pipeline at a halt */
+  LAST
+};
+
+const char *getCategoryName(CycleCategory category);
+
+/* Travels with a bubble through the pipeline registers: why it was
+ * inserted and the instruction to blame.
+ */
+struct StallCause
+{
+  CycleCategory category{ CycleCategory::Base };
+  MemAddress address{};
+};
+
+/* Cycles during which the entire pipeline waits, queued per cause. */
+class PipelineWait
+{
+  public:
+    void add(uint64_t cycles, CycleCategory category, MemAddress address);
+
+    uint64_t getCycles() const { return total; }
+
+    /* Passes at most the given number of cycles of the oldest cause,
+     * returns the number passed.
+     */
+    uint64_t advance(uint64_t cycles, StallCause &cause);
+
+  private:
+    std::deque<std::pair<StallCause, uint64_t>> waits{};
+    uint64_t total{};
+};
+
+/* The CPI stack of a run, in total and per function. */
+class CycleAccounting
+{
+  public:
+    explicit CycleAccounting(const SymbolTable &symbols);
+    CycleAccounting(const CycleAccounting &) = delete;
+    CycleAccounting &operator=(const CycleAccounting &) = delete;
+
+    void account(const StallCause &cause, uint64_t cycles = 1);
+    void account(CycleCategory category, MemAddress address,
+                 uint64_t cycles = 1)
+    {
+      account(StallCause{ category, address }, cycles);
+    }
+
+    /* The instruction at address completed. */
+    void retire(MemAddress address);
+
+    uint64_t getCycles(CycleCategory category) const
+    {
+      return total.cycles[static_cast<size_t>(category)];
+    }
+    uint64_t getCycles() const;
+    uint64_t getInstructions() const { return total.instructions; }
+
+    void dumpStatistics(std::ostream &os) const;
+
+  private:
+    struct Counts
+    {
+      std::array<uint64_t, static_cast<size_t>(CycleCategory::LAST)> cycles{};
+      uint64_t instructions{};
+
+      uint64_t getCycles() const;
+    };
+
+    const SymbolTable &symbols;
+    const Symbol *lastSymbol{};    /* lookup hint */
+    Counts total{};
+    std::unordered_map<const Symbol *, Counts> perSymbol{};
+
+    Counts &getCounts(MemAddress address);
+    static void dumpStack(std::ostream &os, const Counts &counts);
+};
+
+#endif /* __CYCLE_ACCOUNTING_H__ */
@@ -0,0 +1,64 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    dram.h - DRAM controller timing model.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __DRAM_H__
+#define __DRAM_H__
+
+#include "cache.h"
+
+#include <ostream>
+#include <vector>
+
+/* Timing parameters are given in bus cycles. */
+struct DRAMConfig
+{
+  bool enabled = false;
+  size_t banks = 8;           /* power of 2 */
+  size_t rowSize = 2048;      /* bytes, power of 2 */
+
+  unsigned int tCAS = 3;      /* column access */
+  unsigned int tRCD = 3;      /* row activate to column access */
+  unsigned int tRP = 3;       /* precharge */
+  unsigned int tBurst = 2;    /* transfer of a cache line */
+};
+
+/* Open-page DRAM controller. Consecutive rows are interleaved over the
+ * banks; every bank keeps its last activated row open in the row
+ * buffer. An access to the open row only needs a column access, an
+ * access to a bank without open row needs an activate first and an
+ * access to another row needs a precharge and an activate.
+ */
+class DRAMController : public MemoryLevel
+{
+  public:
+    DRAMController(const DRAMConfig &config, unsigned int busClockDivider);
+
+    unsigned int access(MemAddress addr, bool write) override;
+
+    uint64_t getRowHits() const { return nRowHits; }
+    uint64_t getRowEmpty() const { return nRowEmpty; }
+    uint64_t getRowConflicts() const { return nRowConflicts; }
+
+    void dumpStatistics(std::ostream &os) const;
+
+  private:
+    static constexpr MemAddress NoRow = ~MemAddress(0);
+
+    DRAMConfig config;
+    unsigned int busClockDivider;
+
+    std::vector<MemAddress> openRow;
+
+    /* Statistics */
+    uint64_t nReads{};
+    uint64_t nWrites{};
+    uint64_t nRowHits{};
+    uint64_t nRowEmpty{};
+    uint64_t nRowConflicts{};
+};
+
+#endif /* __DRAM_H__ */
@@ -0,0 +1,244 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    dual-issue.h - Stages of the 2-wide in-order pipeline.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __DUAL_ISSUE_H__
+#define __DUAL_ISSUE_H__
+
+#include "stages.h"
+
+#include <array>
+#include <deque>
+#include <ostream>
+
+/* In dual-issue mode, IF fetches up to two instructions per cycle into a
+ * fetch queue. ID issues the oldest one or two instructions of the queue
+ * together when the pairing rules allow, and every following stage
+ * handles both slots of an issue group at once. Slot 0 always holds the
+ * older instruction.
+ *
+ * Pairing rules for the instruction in slot 1:
+ *  - it may not read the register written by slot 0;
+ *  - only one of the two may access memory;
+ *  - it may not be a branch. A branch in slot 0 pairs with its delay
+ *    slot.
+ */
+constexpr size_t IssueWidth = 2;
+
+template <typename T>
+using IssueGroup = std::array<T, IssueWidth>;
+
+struct DualIssueRegisters
+{
+  static constexpr size_t FetchQueueSize = 4;
+
+  std::deque<IF_IDRegisters> fetchQueue{};
+  IssueGroup<ID_EXRegisters> id_ex{};
+
+  /* Why IF did not add to the fetch queue in the last cycle */
+  StallCause fetchStall{};
+
+  IssueGroup<EX_MRegisters> ex_m{};
+  IssueGroup<M_WBRegisters> m_wb{};
+};
+
+/* Why the second instruction of the fetch queue was not issued together
+ * with the first.
+ */
+enum class PairingFailure
+{
+  NoInstruction,  /* fetch queue held a single instruction */
+  Dependency,     /* reads the result of slot 0 */
+  LoadUse,        /* waits for a load in EX */
+  MemoryPort,     /* both access memory */
+  Branch,         /* branch in slot 1 */
+  LAST
+};
+
+struct IssueStatistics
+{
+  uint64_t nSingleIssue{};
+  uint64_t nDualIssue{};
+  std::array<uint64_t, static_cast<size_t>(PairingFailure::LAST)> failures{};
+
+  void dump(std::ostream &os) const;
+};
+
+
+/* A mispredicted branch in slot 0 of EX/M squashes every instruction
+ * fetched after its delay slot.
+ */
+bool isSquashed(const IssueGroup<EX_MRegisters> &ex_m, uint64_t sequence);
+
+
+class DualFetchStage : public Stage
+{
+  public:
+    DualFetchStage(DualIssueRegisters &regs,
+                   InstructionMemory instructionMemory,
+                   MemAddress &PC,
+                   BranchPredictionUnit &branchPredictor,
+                   uint64_t &nFetchStalls)
+      : Stage(true),
+      regs(regs), instructionMemory(instructionMemory), PC(PC),
+      branchPredictor(branchPredictor), nFetchStalls(nFetchStalls)
+    { }
+
+    void propagate() override;
+    void clockPulse() override;
+
+  private:
+    DualIssueRegisters &regs;
+    InstructionMemory instructionMemory;
+    MemAddress &PC;  /* next address to fetch */
+    BranchPredictionUnit &branchPredictor;
+    uint64_t &nFetchStalls;
+
+    /* Fetched, but not yet in the fetch queue. */
+    std::vector<IF_IDRegisters> group{};
+    unsigned int fetchWait{};
+    uint64_t fetchSequence{};
+
+    /* Set when a mispredicted branch squashes younger instructions. */
+    bool squash{};
+    uint64_t lastKept{};
+    MemAddress branchAddress{};
+
+    bool redirectAfterDelaySlot{};
+    MemAddress predictedTarget{};
+
+    std::exception_ptr pendingException{};
+    int drainCycles{};
+
+    void fetchGroup();
+};
+
+class DualDecodeStage : public Stage
+{
+  public:
+    DualDecodeStage(DualIssueRegisters &regs,
+                    RegisterFile &regfile,
+                    uint64_t &nInstrIssued,
+                    uint64_t &nStalls,
+                    IssueStatistics &statistics,
+                    const SymbolTable &symbols,
+                    bool debugMode)
+      : Stage(true),
+      regs(regs), regfile(regfile),
+      nInstrIssued(nInstrIssued), nStalls(nStalls),
+      statistics(statistics), symbols(symbols), debugMode(debugMode)
+    { }
+
+    void propagate() override;
+    void clockPulse() override;
+
+  private:
+    DualIssueRegisters &regs;
+    RegisterFile &regfile;
+
+    uint64_t &nInstrIssued;
+    uint64_t &nStalls;
+    IssueStatistics &statistics;
+
+    const SymbolTable &symbols;
+    bool debugMode;
+
+    IssueGroup<InstructionDecoder> decoders{};
+    IssueGroup<ID_EXRegisters> decoded{};
+    size_t nIssue{};
+    bool stall{};
+    StallCause bubbleCause{};  /* when nothing issues */
+    bool paired{};
+    PairingFailure failure{};
+
+    bool decode(size_t slot);
+    bool isLoadUse(size_t slot) const;
+    RegValue readOperand(RegNumber reg, RegValue value) const;
+};
+
+class DualExecuteStage : public Stage
+{
+  public:
+    DualExecuteStage(DualIssueRegisters &regs,
+                     BranchPredictionUnit &branchPredictor,
+                     FunctionalUnits &units,
+                     const uint64_t &cycle,
+                     PipelineWait &waitCycles)
+      : Stage(true),
+      regs(regs), branchPredictor(branchPredictor),
+      units(units), cycle(cycle), waitCycles(waitCycles)
+    { }
+
+    void propagate() override;
+    void clockPulse() override;
+
+  private:
+    DualIssueRegisters &regs;
+    BranchPredictionUnit &branchPredictor;
+
+    /* A multi-cycle operation holds the whole pipeline. */
+    FunctionalUnits &units;
+    const uint64_t &cycle;
+    PipelineWait &waitCycles;
+
+    IssueGroup<ALU> alus{};
+    IssueGroup<EX_MRegisters> results{};
+
+    /* SR[F], shared by both ALUs */
+    bool FLAG{};
+
+    /* Branch in slot 0 */
+    BranchKind BRANCH_KIND{};
+    bool BRANCH_TAKEN{};
+    bool PREDICTION_CORRECT{};
+
+    RegValue forward(RegNumber reg, RegValue value) const;
+    void execute(size_t slot);
+};
+
+class DualMemoryStage : public Stage
+{
+  public:
+    DualMemoryStage(DualIssueRegisters &regs,
+                    DataMemory dataMemory,
+                    PipelineWait &waitCycles)
+      : Stage(true),
+      regs(regs), dataMemory(dataMemory), waitCycles(waitCycles)
+    { }
+
+    void propagate() override;
+    void clockPulse() override;
+
+  private:
+    DualIssueRegisters &regs;
+    DataMemory dataMemory;
+    PipelineWait &waitCycles;
+
+    IssueGroup<M_WBRegisters> results{};
+    bool accessed{};
+    MemAddress accessAddress{};
+};
+
+class DualWriteBackStage : public Stage
+{
+  public:
+    DualWriteBackStage(DualIssueRegisters &regs,
+                       RegisterFile &regfile,
+                       uint64_t &nInstrCompleted)
+      : Stage(true),
+      regs(regs), regfile(regfile), nInstrCompleted(nInstrCompleted)
+    { }
+
+    void propagate() override;
+    void clockPulse() override;
+
+  private:
+    DualIssueRegisters &regs;
+    RegisterFile &regfile;
+    uint64_t &nInstrCompleted;
+};
+
+#endif /* __DUAL_ISSUE_H__ */
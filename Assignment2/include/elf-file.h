@@ -9,6 +9,7 @@
 #define __ELF_FILE_H__
 
 #include "memory-interface.h"
+#include "symbol-table.h"
 
 #include <vector>
 #include <memory>
@@ -16,12 +17,25 @@
 
 #ifdef _MSC_VER
 #include <windows.h>
+#else
+class FlatMemory;
 #endif
 
 /* The ELFFile class loads a program from an ELF file by creating memories
- * for every section that needs to be loaded. During construction of
- * the Processor class, these memories are added to the memory bus
- * of the system.
+ * for every segment that needs to be loaded (its PT_LOAD program
+ * headers). During construction of the Processor class, these memories
+ * are added to the memory bus of the system.
+ *
+ * The segments are not copied out of the file: read-only segments are
+ * backed by the mapping of the file and shared by all memories created
+ * from it. Every call gets its own copy-on-write mapping of the
+ * writable segments, with anonymous zero pages for .bss, so only the
+ * pages the program writes are copied. (On Windows, the writable
+ * segments are copied.)
+ *
+ * Read-only text is also swapped to host byte order once, at load, so
+ * that instruction fetch reads native words. getTextSegment() still
+ * reads the sections.
  */
 class ELFFile
 {
@@ -33,11 +47,18 @@ class ELFFile
     void unload();
 
     std::vector<std::unique_ptr<MemoryInterface>> createMemories() const;
+#ifndef _MSC_VER
+    /* All segments in a single FlatMemory. */
+    std::unique_ptr<FlatMemory> createFlatMemory() const;
+#endif
     bool getTextSegment(std::vector<std::byte> &segmentData,
                         MemAddress &segmentBase,
                         size_t &segmentSize) const;
     uint64_t getEntrypoint() const;
 
+    /* Symbols from .symtab, indexed once at load time. */
+    const SymbolTable &getSymbolTable() const;
+
 
     ELFFile(const ELFFile &) = delete;
     ELFFile &operator=(const ELFFile &) = delete;
@@ -48,16 +69,40 @@ class ELFFile
     HANDLE mapping{};
 #else
     int fd{};
-    size_t programSize{};
 #endif
+    size_t programSize{};
     void *mapAddr = nullptr;
+    /* Owns the mapping of the file, which the segments point into */
+    std::shared_ptr<const std::byte> image{};
 
     bool isBad = true;
 
+    SymbolTable symbols{};
+
+    struct Segment
+    {
+      std::string name{};
+      MemAddress base{};
+      size_t size{};
+      size_t fileSize{};        /* bytes from the file, the rest is cleared */
+      size_t align{};
+      bool writable{};
+      size_t offset{};
+      /* Into the file mapping; nullptr when fileSize is 0 */
+      std::shared_ptr<const std::byte> data{};
+      /* Read-only text in host byte order, see HostPage */
+      std::shared_ptr<const uint32_t[]> words{};
+    };
+    std::vector<Segment> segments{};
+
     bool isELF() const;
     bool isTarget(const uint8_t elf_class,
                   const uint8_t endianness,
                   const uint8_t machine) const;
+    void checkSections() const;
+    void loadSymbols();
+    void loadSegments();
+    std::shared_ptr<std::byte> mapPrivate(const Segment &segment) const;
 };
 
 #endif /* __ELF_FILE_H__ */
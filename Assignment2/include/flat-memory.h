@@ -0,0 +1,104 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    flat-memory.h - Guest memory in a reserved host address range.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __FLAT_MEMORY_H__
+#define __FLAT_MEMORY_H__
+
+#include "memory-interface.h"
+
+#include <memory>
+#include <vector>
+
+/* Holds all sections of a program in one reservation of host address
+ * space as large as the 32-bit guest address space, plus a guard page
+ * for accesses that run past its end. Guest address a lives at host
+ * address base + a, so an access is a single host load or store
+ * without any checks.
+ *
+ * The pages holding sections are readable, and writable when one of
+ * their sections is; all others are inaccessible. An access to an
+ * inaccessible page, or a store to a read-only page, raises SIGSEGV,
+ * which is turned into an IllegalAccess exception thrown from the
+ * faulting access. Protection works per page of the host, so an
+ * access to the bytes of a page that lie outside its sections is not
+ * caught; the memory bus only passes accesses to the sections.
+ *
+ * Not available on Windows.
+ */
+class FlatMemory : public MemoryInterface
+{
+  public:
+    FlatMemory();
+    ~FlatMemory() override;
+
+    FlatMemory(const FlatMemory &) = delete;
+    FlatMemory &operator=(const FlatMemory &) = delete;
+
+    /* Maps a section, copying size bytes from data or clearing the
+     * section when data is nullptr. A cleared section takes no host
+     * memory until it is touched.
+     */
+    void map(MemAddress base, size_t size, const std::byte *data,
+             bool writable);
+    /* Maps size bytes at offset in the file fd directly, copy-on-write
+     * when writable. Returns false when addr and offset lie at
+     * different places within a page, or a page is shared with a
+     * section mapped before; map() the section instead.
+     */
+    bool mapFile(MemAddress addr, size_t size, int fd, uint64_t offset,
+                 bool writable);
+
+    /* Hands out words, a copy of the section at addr in host byte
+     * order, with its pages (see HostPage). Ignored when a page of the
+     * section is writable, as the copy could become stale.
+     */
+    void setHostWords(MemAddress addr, size_t size,
+                      std::shared_ptr<const uint32_t[]> words);
+
+    /* MemoryInterface */
+    uint8_t readByte(MemAddress addr) override;
+    uint16_t readHalfWord(MemAddress addr) override;
+    uint32_t readWord(MemAddress addr) override;
+    uint64_t readDoubleWord(MemAddress addr) override;
+
+    void writeByte(MemAddress addr, uint8_t value) override;
+    void writeHalfWord(MemAddress addr, uint16_t value) override;
+    void writeWord(MemAddress addr, uint32_t value) override;
+    void writeDoubleWord(MemAddress addr, uint64_t value) override;
+
+    void readBlock(MemAddress addr, std::byte *data, size_t size) override;
+    void writeBlock(MemAddress addr, const std::byte *data,
+                    size_t size) override;
+
+    bool contains(MemAddress addr) const override;
+    bool isCacheable(MemAddress) const override { return true; }
+    std::vector<AddressRange> getRanges() const override;
+    HostPage getHostPage(MemAddress addr) override;
+
+  private:
+    std::byte *base{};
+    const size_t pageSize;          /* of the host */
+    std::vector<AddressRange> sections{};
+    std::vector<bool> writablePages{};
+
+    struct HostWords
+    {
+      AddressRange range{};
+      std::shared_ptr<const uint32_t[]> words{};
+    };
+    std::vector<HostWords> hostWords{};
+
+    /* Whether a section lies on the host page */
+    bool isMapped(uint64_t page) const;
+
+    template <typename T>
+    T readData(MemAddress addr);
+    template <typename T>
+    void writeData(MemAddress addr, T value);
+};
+
+#endif /* __FLAT_MEMORY_H__ */
@@ -38,7 +38,8 @@ class Framebuffer : public MemoryInterface
 {
   public:
     Framebuffer(const MemAddress control_base,
-                const MemAddress framebuffer_base);
+                const MemAddress framebuffer_base,
+                const uint64_t update_freq = 1000000);
     ~Framebuffer() override;
 
     /* MemoryInterface */
@@ -52,9 +53,16 @@ class Framebuffer : public MemoryInterface
     void writeWord(MemAddress addr, uint32_t value) override;
     void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
+    /* Blits within the framebuffer memory */
+    void readBlock(MemAddress addr, std::byte *data, size_t size) override;
+    void writeBlock(MemAddress addr, const std::byte *data,
+                    size_t size) override;
+
     bool contains(MemAddress addr) const override;
+    std::vector<AddressRange> getRanges() const override;
 
     void clockPulse() override;
+    void clockPulses(uint64_t count) override;
 
     void processEvents(const bool redraw);
 
@@ -63,6 +71,7 @@ class Framebuffer : public MemoryInterface
   private:
     FBzone getZone(const MemAddress addr, const uint8_t size,
                    uint32_t *offset) const;
+    bool inBuffer(MemAddress addr, size_t size) const;
 
     const MemAddress control_base;
     const MemAddress framebuffer_base;
@@ -70,7 +79,7 @@ class Framebuffer : public MemoryInterface
     bool  active_window = false;
     bool  finished = false;
 
-    uint64_t update_freq = 1000000;
+    uint64_t update_freq;
     uint64_t cycles_since_update{};
 
     ControlInterface control{};
@@ -0,0 +1,118 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    functional-unit.h - Multi-cycle functional units.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __FUNCTIONAL_UNIT_H__
+#define __FUNCTIONAL_UNIT_H__
+
+#include "arch.h"
+#include "control-signals.h"
+
+#include <deque>
+#include <ostream>
+#include <string>
+
+struct FunctionalUnitConfig
+{
+  unsigned int latency = 1;   /* cycles in EX */
+  bool pipelined = true;      /* accepts an operation every cycle */
+};
+
+/* A unit next to the ALU. A pipelined unit accepts a new operation
+ * every cycle, otherwise only once the previous one has finished.
+ */
+class FunctionalUnit
+{
+  public:
+    FunctionalUnit(const std::string &name, const FunctionalUnitConfig &config);
+
+    unsigned int getLatency() const { return config.latency; }
+    bool isMultiCycle() const { return config.latency > 1; }
+
+    /* Whether an operation can start in the given cycle. */
+    bool isFree(uint64_t cycle) const { return cycle >= nextIssue; }
+
+    /* Starts an operation; returns the cycle its result is available. */
+    uint64_t issue(uint64_t cycle);
+
+    /* An instruction waited a cycle because the unit was busy. */
+    void addStall(uint64_t cycles = 1) { nStallCycles += cycles; }
+
+    uint64_t getOperations() const { return nOperations; }
+    uint64_t getStallCycles() const { return nStallCycles; }
+
+    void dumpStatistics(std::ostream &os, uint64_t nCycles) const;
+
+  private:
+    std::string name;
+    FunctionalUnitConfig config;
+    uint64_t nextIssue{};
+
+    /* Statistics */
+    uint64_t nOperations{};
+    uint64_t nBusyCycles{};    /* cycles the input stage was occupied */
+    uint64_t nStallCycles{};
+};
+
+/* The multiplier and divider of the pipeline. In pipelined mode a
+ * multi-cycle operation is reserved when it leaves ID and leaves EX
+ * right away; its result is written back through the second write port
+ * of the register file once available, possibly after the results of
+ * younger instructions. Instructions that read or write a register
+ * with an outstanding result wait in ID.
+ */
+class FunctionalUnits
+{
+  public:
+    FunctionalUnits(const FunctionalUnitConfig &multiplier,
+                    const FunctionalUnitConfig &divider);
+
+    /* nullptr for the single-cycle ALU. */
+    FunctionalUnit *select(ExecutionUnit unit);
+
+    struct Result
+    {
+      uint64_t sequence{};
+      RegNumber rd{};
+      unsigned int latency{};
+      bool executed{};
+      uint64_t executeCycle{};
+      uint64_t cycle{};        /* first cycle it can be written back */
+      RegValue value{};
+    };
+
+    /* Called when the instruction leaves ID. */
+    void reserve(uint64_t sequence, const FunctionalUnit &unit, RegNumber rd);
+
+    /* Called from EX. The result can be written back after the unit
+     * latency and a cycle for MEM.
+     */
+    void complete(uint64_t sequence, RegValue value, uint64_t cycle);
+
+    bool isPending(RegNumber reg) const;
+
+    /* Oldest executed result that can be written back in the given
+     * cycle, or nullptr.
+     */
+    const Result *getCompleted(uint64_t cycle) const;
+    void retire(uint64_t sequence);
+
+    /* At a halt after lastCycle, drops the results of instructions that
+     * had not left EX and returns the cycles until the remaining ones
+     * are written back.
+     */
+    uint64_t drain(uint64_t lastCycle);
+
+    FunctionalUnit multiplier;
+    FunctionalUnit divider;
+
+    void dumpStatistics(std::ostream &os, uint64_t nCycles) const;
+
+  private:
+    std::deque<Result> results{};
+};
+
+#endif /* __FUNCTIONAL_UNIT_H__ */
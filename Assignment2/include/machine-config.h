@@ -0,0 +1,136 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    machine-config.h - Microarchitecture parameters.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __MACHINE_CONFIG_H__
+#define __MACHINE_CONFIG_H__
+
+#include "branch-predictor.h"
+#include "cache.h"
+#include "dram.h"
+#include "functional-unit.h"
+#include "memory-bus.h"
+#include "out-of-order.h"
+#include "prefetcher.h"
+#include "store-buffer.h"
+#include "stages.h"
+
+#include <string>
+#include <vector>
+
+/* Addresses of the memory-mapped devices. The framebuffer is only
+ * present when built with ENABLE_FRAMEBUFFER.
+ */
+struct PlatformConfig
+{
+  MemAddress serialBase = 0x200;
+  MemAddress sysStatusBase = 0x270;
+  MemAddress framebufferControl = 0x800;    /* control and palette */
+  MemAddress framebufferBase = 0x1000000;
+  uint64_t framebufferUpdate = 1000000;     /* bus cycles per redraw */
+};
+
+/* RAM next to the program, for a heap, a stack or scratch space. A
+ * region of size 0 is left out. The regions read as zero and the host
+ * only provides a page when the program first touches it, so they can
+ * be made large.
+ */
+struct RamConfig
+{
+  MemAddress heapBase = 0x20000000;
+  size_t heapSize = 0;
+  MemAddress scratchBase = 0x40000000;
+  size_t scratchSize = 0;
+  uint64_t stackTop = 0x80000000;           /* the stack ends here */
+  size_t stackSize = 0;
+
+  struct Region
+  {
+    std::string name{};
+    MemAddress base{};
+    size_t size{};
+  };
+
+  /* The regions that are present */
+  std::vector<Region> getRegions() const;
+};
+
+/* All tunable parameters of the simulated machine. The defaults model
+ * the plain 5-stage pipeline. Parameters can be changed from the command
+ * line as "section.name=value" pairs, e.g. "bpred.type=gshare".
+ */
+struct MachineConfig
+{
+  bool pipelining = false;
+
+  /* 2 selects the dual-issue pipeline; pipelined mode only. */
+  unsigned int issueWidth = 1;
+
+  /* Split stages of the in-order pipeline; 1-wide pipelined mode only. */
+  PipelineDepthConfig depth{};
+
+  /* Replaces the in-order stages; pipelined mode only. */
+  OutOfOrderConfig outOfOrder{};
+
+  /* Units next to the ALU in EX */
+  FunctionalUnitConfig multiplier{ 3, true };
+  FunctionalUnitConfig divider{ 32, false };
+
+  BranchPredictorConfig branchPredictor{};
+
+  CacheConfig instructionCache{};
+  CacheConfig dataCache{};
+  CacheConfig l2Cache{};           /* shared by L1I and L1D */
+  PrefetcherConfig instructionPrefetcher{};
+  PrefetcherConfig dataPrefetcher{};
+  StoreBufferConfig storeBuffer{};
+  DRAMConfig dram{};
+
+  /* Jump over the cycles in which the whole pipeline waits instead of
+   * simulating them one at a time; the results are the same.
+   */
+  bool skipStalls = true;
+
+  /* The memory bus runs at 1/busClockDivider of the processor clock. */
+  unsigned int busClockDivider = 5;
+  BusArbitrationConfig busArbitration{};
+
+  PlatformConfig platform{};
+  RamConfig ram{};
+
+  /* Place all sections in one reserved host range (see FlatMemory)
+   * instead of a memory per section.
+   */
+#ifdef _MSC_VER
+  bool flatMemory = false;
+#else
+  bool flatMemory = true;
+#endif
+
+  /* Throws std::invalid_argument for an unknown parameter and
+   * std::out_of_range for a value that cannot be used.
+   */
+  void set(std::string_view name, std::string_view value);
+
+  /* Parses "name=value". */
+  void set(std::string_view assignment);
+
+  /* Applies a machine description: an INI file (see ConfigFile) in
+   * which a property "name" of section "[section]" sets the parameter
+   * "section.name", and a property before the first section sets the
+   * parameter it names. Throws like set(), naming the file.
+   */
+  void load(std::string_view filename);
+
+  /* Checks the parameters that depend on each other or on the parts
+   * that are enabled, such as cache geometry and device placement, so
+   * that a bad machine is rejected before a program is loaded. Throws
+   * std::out_of_range.
+   */
+  void validate() const;
+};
+
+#endif /* __MACHINE_CONFIG_H__ */
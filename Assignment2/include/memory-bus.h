@@ -10,20 +10,68 @@
 
 #include "memory-interface.h"
 
+#include <array>
 #include <memory>
+#include <ostream>
 #include <vector>
 
+/* The two ports through which the pipeline reaches the bus: IF fetches
+ * instructions, MEM loads and stores data.
+ */
+enum class BusPort
+{
+  Fetch,
+  Data
+};
+
+struct BusArbitrationConfig
+{
+  bool unified = false;               /* IF and MEM share a single port */
+  BusPort priority = BusPort::Data;   /* wins when both ask in one cycle */
+  unsigned int turnaround = 0;        /* cycles to hand the port over */
+};
+
 class MemoryBus : public MemoryInterface
 {
   public:
     MemoryBus(std::vector<std::unique_ptr<MemoryInterface> > &&clients);
     ~MemoryBus() override;
 
+    MemoryBus(const MemoryBus &) = delete;
+    MemoryBus &operator=(const MemoryBus &) = delete;
+
     void addClient(std::unique_ptr<MemoryInterface> client);
 
     uint64_t getBytesRead() const;
     uint64_t getBytesWritten() const;
 
+    /* Counts accesses made to a host page instead of through the bus. */
+    void addBytesRead(uint64_t bytes) { bytesRead += bytes; }
+    void addBytesWritten(uint64_t bytes) { bytesWritten += bytes; }
+
+    /* With split ports IF and MEM never wait for each other. With a
+     * unified port, the bus tracks the cycles in which the port is
+     * occupied by reading the processor clock.
+     */
+    void setArbitration(const BusArbitrationConfig &config,
+                        const uint64_t &clock);
+    const BusArbitrationConfig &getArbitration() const { return arbitration; }
+
+    /* Occupies the port for a transfer of the given number of cycles
+     * that wants to start in the current cycle. Returns the cycles the
+     * transfer waits for the port.
+     *
+     * When the port with priority asks before a transfer of the other
+     * port has started, it takes the port first and that transfer is
+     * moved behind it; the next access then waits for it.
+     */
+    unsigned int acquirePort(BusPort port, unsigned int cycles);
+
+    uint64_t getConflicts() const { return nConflicts; }
+    uint64_t getContentionCycles(BusPort port) const;
+
+    void dumpArbitrationStatistics(std::ostream &os) const;
+
     /* MemoryInterface */
     uint8_t readByte(MemAddress addr) override;
     uint16_t readHalfWord(MemAddress addr) override;
@@ -35,18 +83,79 @@ class MemoryBus : public MemoryInterface
     void writeWord(MemAddress addr, uint32_t value) override;
     void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
+    /* Split at the boundaries of the clients. Only the parts that were
+     * transferred are counted, so a faulting block is not.
+     */
+    void readBlock(MemAddress addr, std::byte *data, size_t size) override;
+    void writeBlock(MemAddress addr, const std::byte *data,
+                    size_t size) override;
+
     bool contains(MemAddress addr) const override;
+    bool isCacheable(MemAddress addr) const override;
+
+    /* The part of the host page that belongs to the client of addr. */
+    HostPage getHostPage(MemAddress addr) override;
 
     void clockPulse() override;
+    void clockPulses(uint64_t count) override;
 
   private:
     std::vector<std::unique_ptr<MemoryInterface> > clients;
 
-    MemoryInterface *findClient(MemAddress addr) noexcept;
+    /* Address map, rebuilt by addClient(). The ranges of the clients
+     * are cut into disjoint intervals, sorted on address; where ranges
+     * overlap the client added first wins. A two-level page table at
+     * 4 KiB granularity holds for every page the interval covering it,
+     * so that a lookup takes two loads. Only a page shared by several
+     * intervals is searched.
+     */
+    struct Interval
+    {
+      MemAddress begin{};
+      uint64_t end{};
+      MemoryInterface *client{};
+      bool exact{};
+    };
+
+    static constexpr unsigned int PageBits = 12;
+    static constexpr unsigned int TableBits = 10;
+    static constexpr uint32_t NoInterval = ~uint32_t{ 0 };
+    static constexpr uint32_t SharedPage = NoInterval - 1;
+
+    using PageTable = std::array<uint32_t, 1 << TableBits>;
+
+    /* Covers 4 MiB: a table, or one entry for all pages */
+    struct Directory
+    {
+      uint32_t uniform{ NoInterval };
+      std::unique_ptr<PageTable> pages{};
+    };
+
+    std::vector<Interval> intervals{};
+    std::vector<Directory> directory{};
+    std::vector<MemoryInterface *> unmapped{};  /* clients without ranges */
+
+    void rebuildMap();
+    const Interval *findInterval(MemAddress addr) const noexcept;
+    MemoryInterface *findClient(MemAddress addr) const noexcept;
     MemoryInterface *getClient(MemAddress addr);
+    size_t getBlockSize(MemAddress addr, size_t size) const noexcept;
 
     uint64_t bytesRead = 0;     /* Bytes read from bus */
     uint64_t bytesWritten = 0;  /* Bytes written to bus */
+
+    /* Unified port */
+    BusArbitrationConfig arbitration{};
+    const uint64_t *clock{};    /* no ownership */
+    uint64_t busyUntil{};
+    BusPort holder{ BusPort::Fetch };   /* of the last transfer */
+    uint64_t grantCycle{ ~uint64_t{ 0 } };  /* it was requested */
+    uint64_t grantStart{};
+    unsigned int grantCycles{};
+
+    uint64_t nConflicts{};
+    uint64_t nBusyCycles{};
+    std::array<uint64_t, 2> contentionCycles{};
 };
 
 #endif /* __MEMORY_BUS_H__ */
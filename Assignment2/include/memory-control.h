@@ -9,49 +9,180 @@
 #define __MEMORY_CONTROL_H__
 
 #include "memory-bus.h"
+#include "cache.h"
+#include "prefetcher.h"
+#include "store-buffer.h"
 
+#include <array>
 
+
+/* Direct-mapped cache of the host pages of the bus, so that an access to
+ * plain memory is a tag compare and a load instead of a walk through
+ * the bus and its client. An entry also remembers that a page has no
+ * host memory, e.g. for devices, which are accessed through the bus.
+ * Entries are tagged per 4 KiB; the bounds of the host page decide
+ * which accesses an entry translates.
+ *
+ * Loads and stores through a translation may fault in a FlatMemory,
+ * whose SIGSEGV handler throws IllegalAccess, so the translation units
+ * making them must be built with -fnon-call-exceptions.
+ *
+ * The bus keeps its clients and the memory they hand out for its
+ * lifetime, and a client added later cannot claim memory that was
+ * handed out, so entries never become stale.
+ */
+class SoftwareTLB
+{
+  public:
+    explicit SoftwareTLB(MemoryBus &bus);
+
+    /* Host address of size bytes at addr, or nullptr when these are
+     * not (writable) plain memory within a single page.
+     */
+    std::byte *translate(MemAddress addr, uint8_t size, bool write)
+    {
+      const Entry &entry = lookup(addr);
+      if (addr < entry.begin || uint64_t{ addr } + size > entry.end ||
+          (write && ! entry.writable))
+        return nullptr;
+
+      return entry.data + (addr - entry.begin);
+    }
+
+    /* The instruction word at addr in host byte order, or nullptr when
+     * the memory keeps no such copy (see HostPage).
+     */
+    const uint32_t *translateWord(MemAddress addr)
+    {
+      const Entry &entry = lookup(addr);
+      if (! entry.words || addr < entry.begin ||
+          uint64_t{ addr } + 4 > entry.end || (addr - entry.begin) % 4 != 0)
+        return nullptr;
+
+      return entry.words + (addr - entry.begin) / 4;
+    }
+
+  private:
+    static constexpr unsigned int PageBits = 12;
+    static constexpr size_t Entries = 64;
+
+    struct Entry
+    {
+      uint32_t page{ ~uint32_t{ 0 } };
+      MemAddress begin{};
+      uint64_t end{};           /* begin when there is no host memory */
+      std::byte *data{};
+      bool writable{};
+      const uint32_t *words{};
+    };
+
+    MemoryBus &bus;
+    std::array<Entry, Entries> entries{};
+
+    Entry &lookup(MemAddress addr)
+    {
+      Entry &entry = entries[(addr >> PageBits) % Entries];
+      if (entry.page != addr >> PageBits)
+        refill(entry, addr);
+      return entry;
+    }
+
+    void refill(Entry &entry, MemAddress addr);
+};
+
+
+/* When a cache is attached, every access to cacheable memory is also
+ * looked up in the cache, which determines how many cycles the access
+ * takes. Memory-mapped devices bypass the cache and take a single cycle.
+ * With a prefetch unit, cache accesses are made through the prefetcher.
+ *
+ * An access that does not hit in the cache occupies the port of the bus
+ * for the cycles beyond the hit latency. The cycles it waited for the
+ * port are included in the latency.
+ */
 class InstructionMemory
 {
   public:
-    InstructionMemory(MemoryBus &bus);
+    InstructionMemory(MemoryBus &bus, Cache *cache = nullptr,
+                      PrefetchUnit *prefetcher = nullptr);
 
     void     setSize(uint8_t size);
     void     setAddress(MemAddress addr);
     RegValue getValue() const;
 
+    /* Cycles taken by the last access. */
+    unsigned int getLatency() const { return latency; }
+    /* Part of those spent waiting for the bus port. */
+    unsigned int getPortWait() const { return portWait; }
+
   private:
     MemoryBus &bus;
+    Cache *cache;                /* no ownership */
+    PrefetchUnit *prefetcher;    /* no ownership */
 
     uint8_t    size;
     MemAddress addr;
+    mutable unsigned int latency{ 1 };
+    mutable unsigned int portWait{};
+
+    mutable SoftwareTLB tlb;
 };
 
 
+/* With a store buffer, stores to cacheable memory go through the
+ * buffer and loads see the buffered data. A store to a memory-mapped
+ * device waits until the buffer has been written.
+ */
 class DataMemory
 {
   public:
-    DataMemory(MemoryBus &bus);
+    DataMemory(MemoryBus &bus, Cache *cache = nullptr,
+               PrefetchUnit *prefetcher = nullptr,
+               StoreBuffer *storeBuffer = nullptr);
 
+    /* Address of the instruction performing the access. */
+    void setPC(MemAddress pc);
     void setSize(uint8_t size);
     void setAddress(MemAddress addr);
-    void setDataIn(RegValue value);
+    void setDataIn(uint64_t value);
     void setReadEnable(bool setting);
     void setWriteEnable(bool setting);
 
+    /* Throws IllegalAccess for an access of 8 bytes, which does not
+     * fit a register; its value is read with getDoubleWordOut().
+     */
     RegValue getDataOut(bool signExtend) const;
+    uint64_t getDoubleWordOut() const;
 
     void clockPulse() const;
 
+    /* Cycles taken by the last read or write. */
+    unsigned int getLatency() const { return latency; }
+    /* Part of those spent waiting for the bus port. */
+    unsigned int getPortWait() const { return portWait; }
+
+    /* False for memory-mapped devices. */
+    bool isCacheable(MemAddress addr) const { return bus.isCacheable(addr); }
 
   private:
     MemoryBus &bus;
+    Cache *cache;                /* no ownership */
+    PrefetchUnit *prefetcher;    /* no ownership */
+    StoreBuffer *storeBuffer;    /* no ownership */
 
+    MemAddress pc{};
     uint8_t size{};
     MemAddress addr{};
-    RegValue dataIn{};
+    uint64_t dataIn{};
     bool readEnable{};
     bool writeEnable{};
+    mutable unsigned int latency{ 1 };
+    mutable unsigned int portWait{};
+
+    mutable SoftwareTLB tlb;
+
+    void accessCache(bool write) const;
+    uint64_t load(bool signExtend) const;
 };
 
 
@@ -15,7 +15,34 @@
 #include <sstream>
 #include <iomanip>
 
+#include <cstddef>
 #include <cstdint>
+#include <vector>
+
+/* Addresses [begin, end) claimed by a memory bus client. */
+struct AddressRange
+{
+  MemAddress begin{};
+  uint64_t end{};           /* up to and including 2^32 */
+  bool exact{ true };       /* else contains() decides within the range */
+};
+
+/* Host memory holding the guest bytes [begin, end), which lie within a
+ * single page of the client. Guest data is big endian.
+ */
+struct HostPage
+{
+  std::byte *data{};        /* at begin; nullptr when there is none */
+  MemAddress begin{};
+  uint64_t end{};
+  bool writable{};
+
+  /* A copy of read-only text in host byte order, so that instructions
+   * are fetched without swapping: words[i] holds the word at begin +
+   * 4 i. nullptr when the client keeps no such copy.
+   */
+  const uint32_t *words{};
+};
 
 class MemoryInterface
 {
@@ -32,8 +59,49 @@ class MemoryInterface
 
     virtual bool contains(MemAddress addr) const = 0;
 
+    /* Copy size bytes from or to addr, in the order of guest memory,
+     * like a byte access per byte does. Plain memory and the
+     * framebuffer copy them at once.
+     */
+    virtual void readBlock(MemAddress addr, std::byte *data, size_t size)
+    {
+      for (size_t i = 0; i < size; ++i)
+        data[i] = std::byte{ readByte(addr + i) };
+    }
+
+    virtual void writeBlock(MemAddress addr, const std::byte *data,
+                            size_t size)
+    {
+      for (size_t i = 0; i < size; ++i)
+        writeByte(addr + i, std::to_integer<uint8_t>(data[i]));
+    }
+
+    /* The addresses the client answers to. The memory bus decodes
+     * addresses with these ranges and only calls contains() within a
+     * range that is not exact. A client without ranges is asked with
+     * contains() for every address no other client claims.
+     */
+    virtual std::vector<AddressRange> getRanges() const { return {}; }
+
+    /* Plain memory hands out the host memory it holds within the page
+     * of addr, so that accesses can bypass the bus. Devices have none.
+     */
+    virtual HostPage getHostPage(MemAddress addr) { return {}; }
+
+    /* Whether accesses to addr may be cached. Memory-mapped devices
+     * are accessed uncached.
+     */
+    virtual bool isCacheable(MemAddress) const { return false; }
+
     virtual void clockPulse() { }
 
+    /* Equivalent to calling clockPulse() count times. */
+    virtual void clockPulses(uint64_t count)
+    {
+      for (; count > 0; --count)
+        clockPulse();
+    }
+
     virtual ~MemoryInterface() = default;
 };
 
@@ -22,10 +22,29 @@ class Memory : public MemoryInterface
            const MemAddress base,
            const size_t size,
            const size_t align);
+    /* Uses data that is owned elsewhere, e.g. a mapping of the
+     * program file, and keeps it alive.
+     */
+    Memory(const std::string &name,
+           std::shared_ptr<std::byte> data,
+           const MemAddress base,
+           const size_t size);
+    /* Shares read-only data, e.g. the text of a program that is
+     * simulated several times. Such a memory cannot be made writable.
+     */
+    Memory(const std::string &name,
+           std::shared_ptr<const std::byte> data,
+           const MemAddress base,
+           const size_t size);
     ~Memory() override;
 
     void setMayWrite(bool setting);
 
+    /* Hands out words, a copy of the contents in host byte order, with
+     * the pages of a read-only memory (see HostPage).
+     */
+    void setHostWords(std::shared_ptr<const uint32_t[]> words);
+
     /* MemoryInterface */
     uint8_t readByte(MemAddress addr) override;
     uint16_t readHalfWord(MemAddress addr) override;
@@ -37,8 +56,14 @@ class Memory : public MemoryInterface
     void writeWord(MemAddress addr, uint32_t value) override;
     void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
-    bool contains(MemAddress addr) const override;
+    void readBlock(MemAddress addr, std::byte *data, size_t size) override;
+    void writeBlock(MemAddress addr, const std::byte *data,
+                    size_t size) override;
 
+    bool contains(MemAddress addr) const override;
+    std::vector<AddressRange> getRanges() const override;
+    HostPage getHostPage(MemAddress addr) override;
+    bool isCacheable(MemAddress) const override { return true; }
 
     Memory(const Memory &) = delete;
     Memory &operator=(const Memory &) = delete;
@@ -60,6 +85,10 @@ class Memory : public MemoryInterface
      * bother using a unique_ptr in this case.
      */
     std::byte * const data;
+    /* Owns data unless it was passed in as a plain pointer */
+    const std::shared_ptr<const std::byte> owner{};
+    const bool readOnly = false;
+    std::shared_ptr<const uint32_t[]> words{};
 
     /* Private helper methods */
     bool canAccess(MemAddress addr, size_t accessSize, bool write) const;
@@ -70,4 +99,9 @@ class Memory : public MemoryInterface
     void writeData(MemAddress addr, T value);
 };
 
+/* Returns size bytes that read as zero, for a Memory. The host only
+ * provides a page when it is first touched.
+ */
+std::shared_ptr<std::byte> allocateZeroPages(size_t size);
+
 #endif /* __MEMORY_H__ */
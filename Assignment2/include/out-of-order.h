@@ -0,0 +1,283 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    out-of-order.h - Out-of-order core with register renaming.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __OUT_OF_ORDER_H__
+#define __OUT_OF_ORDER_H__
+
+#include "stages.h"
+
+#include <array>
+#include <deque>
+#include <ostream>
+#include <vector>
+
+struct OutOfOrderConfig
+{
+  bool enabled = false;
+  unsigned int width = 2;           /* fetch, dispatch, issue and commit */
+  size_t robSize = 32;
+  size_t issueQueueSize = 16;
+  size_t loadStoreQueueSize = 16;
+  size_t physicalRegisters = 64;
+};
+
+/* Tomasulo-style core. Instructions are fetched in order, renamed onto
+ * a physical register file and placed in the reorder buffer (ROB).
+ * Every cycle the oldest instructions whose operands are available
+ * issue, and the oldest completed instructions commit in order.
+ *
+ * SR[F] is renamed like a general-purpose register. The delay slot of
+ * a branch is always executed; a mispredicted branch squashes only the
+ * instructions after its delay slot. Stores write memory when they
+ * commit. A load issues once all older stores know their address; it
+ * receives the data of an older store to the same address and waits
+ * for other overlapping stores to commit. Loads from memory-mapped
+ * devices only issue at the head of the ROB.
+ */
+class OutOfOrderCore
+{
+  public:
+    /* r0-r31 followed by SR[F] */
+    static constexpr size_t NumLogicalRegs = NumRegs + 1;
+    static constexpr RegNumber FlagReg = NumRegs;
+    static constexpr int NoReg = -1;
+
+    enum class StallReason
+    {
+      FrontEnd,       /* no instruction available for dispatch */
+      ROBFull,
+      IssueQueueFull,
+      LoadStoreQueueFull,
+      NoFreeRegister,
+      LAST
+    };
+
+    struct Entry
+    {
+      uint64_t sequence{};
+      MemAddress PC{};             /* address + 4, as in the pipeline */
+      InstructionDecoder decoder{};
+      ControlSignals signals{};
+      ALUOp op{};
+      RegValue immediate{};
+      BranchKind branchKind{};
+      BranchPrediction prediction{};
+
+      /* Physical registers, NoReg for r0 or when unused */
+      int srcA{ NoReg };
+      int srcB{ NoReg };
+      int srcFlag{ NoReg };
+      RegNumber rd{};
+      int dest{ NoReg };
+      int oldDest{ NoReg };
+      int flagDest{ NoReg };
+      int oldFlagDest{ NoReg };
+
+      bool issued{};
+      uint64_t readyCycle{};
+      uint64_t latency{};
+      bool unitBusy{};             /* last issue attempt found it busy */
+
+      /* Memory operations */
+      bool load{};
+      bool store{};
+      MemAddress address{};
+      uint8_t size{};
+      RegValue storeData{};
+
+      /* Branches, used to train the predictor at commit */
+      bool taken{};
+      RegValue target{};
+      bool predictionCorrect{ true };
+
+      /* Raised when the instruction commits */
+      std::exception_ptr fault{};
+    };
+
+    struct FetchEntry
+    {
+      IF_IDRegisters instruction{};
+      uint64_t availableCycle{};
+    };
+
+    explicit OutOfOrderCore(const OutOfOrderConfig &config);
+
+    OutOfOrderCore(const OutOfOrderCore &) = delete;
+    OutOfOrderCore &operator=(const OutOfOrderCore &) = delete;
+
+    const OutOfOrderConfig config;
+    uint64_t cycle{};
+
+    /* Front end */
+    std::deque<FetchEntry> fetchQueue{};
+    bool redirect{};
+    MemAddress redirectTarget{};
+    uint64_t redirectSequence{};   /* of the mispredicted branch */
+
+    /* Why the ROB may run empty. Cleared once an instruction fetched
+     * after frontEndStallSequence is dispatched.
+     */
+    StallCause frontEndStall{};
+    uint64_t frontEndStallSequence{};
+    void setFrontEndStall(CycleCategory category, MemAddress address,
+                          uint64_t sequence);
+
+    /* Back end */
+    std::deque<Entry> rob{};
+    size_t issueQueueUsed{};
+    size_t loadStoreQueueUsed{};
+
+    bool initialized{};
+    std::array<int, NumLogicalRegs> renameMap{};
+    std::array<int, NumLogicalRegs> committedMap{};
+    std::vector<RegValue> values;
+    std::vector<uint64_t> readyCycle;
+    std::deque<int> freeList{};
+
+    bool isReady(int reg) const;
+    RegValue getValue(int reg) const;
+    int allocate();
+    void release(int reg);
+
+    /* Squashes everything after the delay slot of the branch. */
+    void recover(uint64_t branchSequence, MemAddress target);
+
+    /* Statistics */
+    std::array<uint64_t, static_cast<size_t>(StallReason::LAST)> stalls{};
+    std::vector<uint64_t> occupancy;   /* cycles per ROB fill level */
+    uint64_t nCommitted{};
+
+    void dumpStatistics(std::ostream &os) const;
+};
+
+
+/* The stages run in reverse order within a cycle, such that an
+ * instruction proceeds at most one stage per cycle.
+ */
+
+class OutOfOrderCommitStage : public Stage
+{
+  public:
+    OutOfOrderCommitStage(OutOfOrderCore &core,
+                          RegisterFile &regfile,
+                          DataMemory dataMemory,
+                          BranchPredictionUnit &branchPredictor,
+                          uint64_t &nInstrCompleted,
+                          CycleAccounting &accounting)
+      : Stage(true),
+      core(core), regfile(regfile), dataMemory(dataMemory),
+      branchPredictor(branchPredictor), nInstrCompleted(nInstrCompleted),
+      accounting(accounting)
+    { }
+
+    void propagate() override;
+    void clockPulse() override;
+
+  private:
+    OutOfOrderCore &core;
+    RegisterFile &regfile;
+    DataMemory dataMemory;
+    BranchPredictionUnit &branchPredictor;
+    uint64_t &nInstrCompleted;
+
+    CycleAccounting &accounting;
+    StallCause cycleCause{};
+
+    /* A committed store to a device that has not been counted yet */
+    bool pendingRetire = false;
+    MemAddress pendingRetirePC{};
+
+    void initialize();
+    void commit(const OutOfOrderCore::Entry &entry);
+    void retire(MemAddress PC);
+    StallCause getStallCause() const;
+};
+
+class OutOfOrderExecuteStage : public Stage
+{
+  public:
+    OutOfOrderExecuteStage(OutOfOrderCore &core,
+                           DataMemory dataMemory,
+                           FunctionalUnits &units)
+      : Stage(true),
+      core(core), dataMemory(dataMemory), units(units),
+      alus(core.config.width)
+    { }
+
+    void propagate() override;
+    void clockPulse() override;
+
+  private:
+    OutOfOrderCore &core;
+    DataMemory dataMemory;
+    FunctionalUnits &units;   /* results travel through the ROB */
+    std::vector<ALU> alus;
+
+    bool isReady(const OutOfOrderCore::Entry &entry) const;
+    bool execute(OutOfOrderCore::Entry &entry, ALU &alu);
+    bool executeLoad(OutOfOrderCore::Entry &entry,
+                     RegValue &value, uint64_t &latency);
+};
+
+class OutOfOrderDispatchStage : public Stage
+{
+  public:
+    OutOfOrderDispatchStage(OutOfOrderCore &core,
+                            uint64_t &nInstrIssued,
+                            const SymbolTable &symbols,
+                            bool debugMode)
+      : Stage(true),
+      core(core), nInstrIssued(nInstrIssued),
+      symbols(symbols), debugMode(debugMode)
+    { }
+
+    void propagate() override;
+    void clockPulse() override;
+
+  private:
+    OutOfOrderCore &core;
+    uint64_t &nInstrIssued;
+    const SymbolTable &symbols;
+    bool debugMode;
+
+    void decode(OutOfOrderCore::Entry &entry, const IF_IDRegisters &in);
+    bool dispatch(OutOfOrderCore::Entry &entry);
+};
+
+class OutOfOrderFetchStage : public Stage
+{
+  public:
+    OutOfOrderFetchStage(OutOfOrderCore &core,
+                         InstructionMemory instructionMemory,
+                         MemAddress &PC,
+                         BranchPredictionUnit &branchPredictor,
+                         uint64_t &nFetchStalls)
+      : Stage(true),
+      core(core), instructionMemory(instructionMemory), PC(PC),
+      branchPredictor(branchPredictor), nFetchStalls(nFetchStalls)
+    { }
+
+    void propagate() override;
+    void clockPulse() override;
+
+  private:
+    OutOfOrderCore &core;
+    InstructionMemory instructionMemory;
+    MemAddress &PC;   /* next address to fetch */
+    BranchPredictionUnit &branchPredictor;
+    uint64_t &nFetchStalls;
+
+    uint64_t fetchSequence{};
+    uint64_t busyUntil{};
+
+    bool redirectAfterDelaySlot{};
+    MemAddress predictedTarget{};
+
+    std::exception_ptr pendingException{};
+};
+
+#endif /* __OUT_OF_ORDER_H__ */
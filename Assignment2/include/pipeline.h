@@ -9,20 +9,25 @@
 #define __PIPELINE_H__
 
 #include "stages.h"
+#include "dual-issue.h"
+#include "out-of-order.h"
 
 #include "memory-control.h"
+#include "machine-config.h"
+#include "symbol-table.h"
 
 class Pipeline
 {
   public:
-    Pipeline(bool pipelining,
+    Pipeline(const MachineConfig &config,
              bool debugMode,
              MemAddress &PC,
              InstructionMemory &instructionMemory,
              InstructionDecoder &decoder,
              RegisterFile &regfile,
              bool &flag,
-             DataMemory &dataMemory);
+             DataMemory &dataMemory,
+             const SymbolTable &symbols);
 
     Pipeline(const Pipeline &) = delete;
     Pipeline &operator=(const Pipeline &) = delete;
@@ -30,6 +35,18 @@ class Pipeline
     void propagate();
     void clockPulse();
 
+    /* Number of upcoming cycles in which none of the stages can make
+     * progress, and advancing over them in one step. Skipping has the
+     * same effect as calling propagate() and clockPulse() as often.
+     */
+    uint64_t getStalledCycles() const { return waitCycles.getCycles(); }
+    void skipCycles(uint64_t cycles);
+
+    /* Completes outstanding multi-cycle operations at a halt; returns
+     * the number of cycles this takes.
+     */
+    uint64_t drain();
+
     bool getPipelining() const
     {
       return pipelining;
@@ -50,23 +67,111 @@ class Pipeline
       return nStalls;
     }
 
+    uint64_t getFetchStalls() const
+    {
+      return nFetchStalls;
+    }
+
+    uint64_t getMemoryStalls() const
+    {
+      return nMemoryStalls;
+    }
+
+    uint64_t getFlagStalls() const
+    {
+      return nFlagStalls;
+    }
+
+    const BranchPredictionUnit &getBranchPredictor() const
+    {
+      return branchPredictor;
+    }
+
+    const FunctionalUnits &getFunctionalUnits() const
+    {
+      return functionalUnits;
+    }
+
+    const PipelineDepthConfig &getDepth() const
+    {
+      return depth;
+    }
+
+    bool getDualIssue() const
+    {
+      return dualIssue;
+    }
+
+    const IssueStatistics &getIssueStatistics() const
+    {
+      return issueStatistics;
+    }
+
+    bool getOutOfOrder() const
+    {
+      return outOfOrderCore != nullptr;
+    }
+
+    const OutOfOrderCore &getOutOfOrderCore() const
+    {
+      return *outOfOrderCore;
+    }
+
+    const CycleAccounting &getCycleAccounting() const
+    {
+      return accounting;
+    }
+
   private:
     bool pipelining;
+    bool dualIssue;
+    PipelineDepthConfig depth;
     size_t currentStage{};
+    uint64_t cycle{};
 
     /* Statistics */
     uint64_t nInstrIssued{};
     uint64_t nInstrCompleted{};
     uint64_t nStalls{};
+    uint64_t nFetchStalls{};   /* bubbles sent by IF */
+    uint64_t nMemoryStalls{};  /* cycles the whole pipeline waited */
+    uint64_t nFlagStalls{};    /* branches in ID waiting for SR[F] */
+    IssueStatistics issueStatistics{};
+    CycleAccounting accounting;
+
+    /* Remaining cycles of a slow memory access, during which none of
+     * the stages proceeds.
+     */
+    PipelineWait waitCycles{};
+
+    void accountCycle(const IssueGroup<M_WBRegisters> &retiring);
 
     /* Stages */
     std::vector<std::unique_ptr<Stage>> stages{};
 
-    /* Pipeline registers */
+    /* Shared by the stages */
+    HazardDetector hazardDetector{};
+    BranchPredictionUnit branchPredictor;
+    FunctionalUnits functionalUnits;
+    RegisterFile &regfile;
+
+    /* Pipeline registers, see PipelineDepthConfig. if_if2, id_rr and
+     * m_m2 are in front of IF2, RR and MEM2 and are only used when
+     * these stages are present.
+     */
+    IF_IDRegisters if_if2{};
     IF_IDRegisters if_id{};
+    ID_EXRegisters id_rr{};
     ID_EXRegisters id_ex{};
     EX_MRegisters  ex_m{};
+    M_WBRegisters  m_m2{};
     M_WBRegisters  m_wb{};
+
+    /* Dual-issue mode */
+    DualIssueRegisters dualIssueRegisters{};
+
+    /* Out-of-order mode */
+    std::unique_ptr<OutOfOrderCore> outOfOrderCore{};
 };
 
 
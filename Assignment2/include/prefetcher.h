@@ -0,0 +1,195 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    prefetcher.h - Hardware prefetcher models.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __PREFETCHER_H__
+#define __PREFETCHER_H__
+
+#include "cache.h"
+#include "memory-bus.h"
+
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+enum class PrefetcherType
+{
+  None,
+  NextLine,          /* next N lines */
+  Stride,            /* per-instruction stride (reference prediction table) */
+  Stream,            /* sequential streams of line accesses */
+  DeltaCorrelating   /* per-instruction delta history (DCPT) */
+};
+
+struct PrefetcherConfig
+{
+  PrefetcherType type = PrefetcherType::None;
+  unsigned int degree = 1;      /* lines prefetched per trigger */
+  size_t tableSize = 16;        /* table entries or tracked streams */
+};
+
+/* A prefetch algorithm observes the demand accesses of a cache and
+ * proposes addresses to prefetch.
+ */
+class Prefetcher
+{
+  public:
+    virtual ~Prefetcher() = default;
+
+    /* Called for every demand access; pc is the address of the
+     * instruction that performs the access. Candidate addresses are
+     * appended to prefetches.
+     */
+    virtual void train(MemAddress pc, MemAddress addr, bool miss,
+                       std::vector<MemAddress> &prefetches) = 0;
+
+    virtual const char *getName() const = 0;
+};
+
+class NextLinePrefetcher : public Prefetcher
+{
+  public:
+    NextLinePrefetcher(size_t lineSize, unsigned int degree);
+
+    void train(MemAddress pc, MemAddress addr, bool miss,
+               std::vector<MemAddress> &prefetches) override;
+    const char *getName() const override { return "next-line"; }
+
+  private:
+    size_t lineSize;
+    unsigned int degree;
+};
+
+class StridePrefetcher : public Prefetcher
+{
+  public:
+    StridePrefetcher(size_t tableSize, unsigned int degree);
+
+    void train(MemAddress pc, MemAddress addr, bool miss,
+               std::vector<MemAddress> &prefetches) override;
+    const char *getName() const override { return "stride"; }
+
+  private:
+    struct Entry
+    {
+      MemAddress pc{};
+      MemAddress lastAddr{};
+      int64_t stride{};
+      unsigned int confidence{};  /* saturates at 3 */
+    };
+
+    std::vector<Entry> table;
+    unsigned int degree;
+};
+
+class StreamPrefetcher : public Prefetcher
+{
+  public:
+    StreamPrefetcher(size_t lineSize, size_t nStreams, unsigned int degree);
+
+    void train(MemAddress pc, MemAddress addr, bool miss,
+               std::vector<MemAddress> &prefetches) override;
+    const char *getName() const override { return "stream"; }
+
+  private:
+    /* Accesses within this many lines of a stream belong to it. */
+    static constexpr int64_t Window = 4;
+
+    struct Stream
+    {
+      bool valid{};
+      int64_t lastLine{};
+      int direction{};            /* +1, -1 or 0 when not yet known */
+      unsigned int confidence{};
+      uint64_t lastUse{};
+    };
+
+    size_t lineSize;
+    std::vector<Stream> streams;
+    unsigned int degree;
+    uint64_t useCounter{};
+};
+
+class DeltaCorrelatingPrefetcher : public Prefetcher
+{
+  public:
+    DeltaCorrelatingPrefetcher(size_t tableSize, unsigned int degree);
+
+    void train(MemAddress pc, MemAddress addr, bool miss,
+               std::vector<MemAddress> &prefetches) override;
+    const char *getName() const override { return "delta"; }
+
+  private:
+    static constexpr size_t HistoryLength = 8;
+
+    struct Entry
+    {
+      MemAddress pc{};
+      MemAddress lastAddr{};
+      std::vector<int64_t> deltas{};  /* oldest first */
+    };
+
+    std::vector<Entry> table;
+    unsigned int degree;
+};
+
+/* Returns nullptr for PrefetcherType::None. */
+std::unique_ptr<Prefetcher>
+makePrefetcher(const PrefetcherConfig &config, size_t lineSize);
+
+
+/* Attaches a prefetcher to a cache. Demand accesses of the pipeline go
+ * through access(), which trains the prefetcher and fills the proposed
+ * lines into the cache. Prefetched lines are read over the memory bus,
+ * such that their traffic shows up in MemoryBus::getBytesRead.
+ *
+ * A prefetch becomes available once its fill latency has passed. A
+ * demand access to a line that is still being filled waits for the
+ * remainder of the fill; such a prefetch is counted as late.
+ */
+class PrefetchUnit
+{
+  public:
+    PrefetchUnit(const PrefetcherConfig &config, Cache &cache,
+                 MemoryBus &bus, const uint64_t &clock);
+
+    PrefetchUnit(const PrefetchUnit &) = delete;
+    PrefetchUnit &operator=(const PrefetchUnit &) = delete;
+
+    /* Performs a demand access on the cache; returns its latency. */
+    unsigned int access(MemAddress pc, MemAddress addr, bool write);
+
+    uint64_t getIssued() const { return nIssued; }
+    uint64_t getUseful() const { return nUseful; }
+    uint64_t getLate() const { return nLate; }
+    uint64_t getDemandMisses() const { return nDemandMisses; }
+    uint64_t getExtraBytes() const { return extraBytes; }
+
+    void dumpStatistics(std::ostream &os) const;
+
+  private:
+    std::unique_ptr<Prefetcher> prefetcher;
+    Cache &cache;
+    MemoryBus &bus;
+    const uint64_t &clock;
+    size_t lineSize;
+
+    /* Prefetched lines not yet used, with the cycle they arrive. */
+    std::unordered_map<MemAddress, uint64_t> pending{};
+    std::vector<MemAddress> candidates{};
+
+    /* Statistics */
+    uint64_t nIssued{};
+    uint64_t nUseful{};       /* prefetched lines hit by a demand access */
+    uint64_t nLate{};         /* ... before the fill completed */
+    uint64_t nDemandMisses{}; /* misses that were not prefetched */
+    uint64_t extraBytes{};
+
+    void issue(MemAddress line);
+};
+
+#endif /* __PREFETCHER_H__ */
@@ -11,14 +11,33 @@
 #include "arch.h"
 
 #include "elf-file.h"
+#include "machine-config.h"
 #include "pipeline.h"
 #include "sys-status.h"
 
 
+/* The main results of a run, as compared by a sweep. */
+struct ProcessorSummary
+{
+  uint64_t cycles{};
+  uint64_t instructions{};         /* completed */
+  uint64_t stalls{};
+  uint64_t mispredictions{};
+  uint64_t instructionCacheMisses{};
+  uint64_t dataCacheMisses{};
+  uint64_t bytesRead{};
+  uint64_t bytesWritten{};
+};
+
 class Processor
 {
   public:
-    Processor(ELFFile &program, bool pipelining, bool debugMode=false);
+    /* The program and its symbols are only read, so that a program
+     * can be simulated by several processors at once. The simulated
+     * serial port and halt messages are written to console.
+     */
+    Processor(const ELFFile &program, const MachineConfig &config,
+              bool debugMode=false, std::ostream &console=std::cerr);
 
     Processor(const Processor &) = delete;
     Processor &operator=(const Processor &) = delete;
@@ -33,8 +52,18 @@ class Processor
     /* Debugging and statistics */
     void dumpRegisters() const;
     void dumpStatistics() const;
+    ProcessorSummary getSummary() const;
+    const CycleAccounting &getCycleAccounting() const
+    {
+      return pipeline.getCycleAccounting();
+    }
 
   private:
+    void skipCycles(uint64_t cycles);
+    uint64_t drain();
+
+    std::ostream &console;
+
     /* Statistics */
     uint64_t nCycles{};
 
@@ -43,7 +72,17 @@ class Processor
     bool flag{};
     InstructionDecoder decoder{};
 
+    const unsigned int busClockDivider;
+    const bool skipStalls;
+
     MemoryBus bus;
+    std::unique_ptr<DRAMController> dram;
+    std::unique_ptr<Cache> l2Cache;
+    std::unique_ptr<Cache> instructionCache;
+    std::unique_ptr<Cache> dataCache;
+    std::unique_ptr<PrefetchUnit> instructionPrefetcher;
+    std::unique_ptr<PrefetchUnit> dataPrefetcher;
+    std::unique_ptr<StoreBuffer> storeBuffer;
     InstructionMemory instructionMemory;
     DataMemory dataMemory;
 
@@ -51,6 +90,8 @@ class Processor
 
     Pipeline pipeline;
 
+    const SymbolTable &symbols;
+
     /* Memory bus clients */
     SysStatus *sysStatus{};  /* no ownership */
 };
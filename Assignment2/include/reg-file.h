@@ -36,6 +36,16 @@ class RegisterFile
     void setWriteData(const RegValue newData) { writeData = newData; }
     void setWriteEnable(bool newEnable) { writeEnable = newEnable; }
 
+    /* Second set of ports, used by the second slot in dual-issue mode.
+     * On a write to the same register, the second port wins.
+     */
+    void setRS3(const RegNumber newRS3) { RS3 = newRS3; };
+    void setRS4(const RegNumber newRS4) { RS4 = newRS4; };
+
+    void setRD2(const RegNumber newRD) { RD2 = newRD; };
+    void setWriteData2(const RegValue newData) { writeData2 = newData; }
+    void setWriteEnable2(bool newEnable) { writeEnable2 = newEnable; }
+
     /*
      * Output signals
      */
@@ -50,6 +60,16 @@ class RegisterFile
       return readRegister(RS2);
     }
 
+    RegValue getReadData3() const
+    {
+      return readRegister(RS3);
+    }
+
+    RegValue getReadData4() const
+    {
+      return readRegister(RS4);
+    }
+
     /*
      * Clock signal
      */
@@ -58,6 +78,8 @@ class RegisterFile
     {
       if (writeEnable)
         writeRegister(RD, writeData);
+      if (writeEnable2)
+        writeRegister(RD2, writeData2);
     }
 
 
@@ -71,6 +93,13 @@ class RegisterFile
     RegValue writeData{};
     bool writeEnable = false;
 
+    RegNumber RS3{};
+    RegNumber RS4{};
+
+    RegNumber RD2{};
+    RegValue writeData2{};
+    bool writeEnable2 = false;
+
     void checkRegNumber(const RegNumber regnum) const
     {
       if (regnum >= NumRegs)
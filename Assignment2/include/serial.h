@@ -10,10 +10,12 @@
 
 #include "memory-interface.h"
 
+#include <iostream>
+
 class Serial : public MemoryInterface
 {
   public:
-    Serial(const MemAddress base);
+    Serial(const MemAddress base, std::ostream &console = std::cerr);
     ~Serial() override = default;
 
     /* MemoryInterface */
@@ -28,9 +30,11 @@ class Serial : public MemoryInterface
     void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
     bool contains(MemAddress addr) const override;
+    std::vector<AddressRange> getRanges() const override;
 
   private:
     const MemAddress base;
+    std::ostream &console;
 };
 
 #endif /* __SERIAL_H__ */
@@ -13,6 +13,13 @@
 #include "inst-decoder.h"
 #include "memory-control.h"
 #include "control-signals.h"
+#include "symbol-table.h"
+#include "branch-predictor.h"
+#include "functional-unit.h"
+#include "cycle-accounting.h"
+
+#include <exception>
+#include <string>
 
 
 
@@ -28,8 +35,24 @@ struct IF_IDRegisters
 {
   MemAddress PC = 0;
 
+  /* Address the instruction was fetched from. In non-pipelined mode PC
+   * already points at the branch target after a delay slot.
+   */
+  MemAddress FETCH_PC{};
+
   /* TODO: add necessary fields */
-  RegValue INSTRUCTION_WORD{};
+  RegValue INSTRUCTION_WORD{ NopInstructionWord };
+
+  /* Made in IF, verified in EX */
+  BranchPrediction PREDICTION{};
+
+  /* Fetch order in pipelined mode, 0 for bubbles. Identifies the delay
+   * slot of a branch.
+   */
+  uint64_t SEQUENCE{};
+
+  /* Why a bubble was inserted, for the CPI stack */
+  StallCause BUBBLE_CAUSE{};
 };
 
 struct ID_EXRegisters
@@ -42,6 +65,26 @@ struct ID_EXRegisters
   RegNumber RD{};
   RegValue IMMEDIATE{};
   ControlSignals CONTROL_SIGNALS;
+
+  /* Operand sources selected by the hazard detection unit */
+  InputSelectorForward FORWARD_A{};
+  InputSelectorForward FORWARD_B{};
+
+  /* Source registers; dual-issue mode forwards by register number. */
+  RegNumber RA{};
+  RegNumber RB{};
+
+  BranchPrediction PREDICTION{};
+  BranchKind BRANCH_KIND{};
+  uint64_t SEQUENCE{};
+  StallCause BUBBLE_CAUSE{};
+
+  /* A direct branch resolved in ID redirects IF through these, like
+   * EX/M does for the branches resolved in EX.
+   */
+  RegValue BRANCH_PC{};
+  InputSelectorIFStage BRANCH_DECISION{};
+  bool BRANCH_RESOLVED{};
 };
 
 struct EX_MRegisters
@@ -56,9 +99,17 @@ struct EX_MRegisters
   RegValue RS2{};
   RegNumber RD{};
 
+  /* In pipelined mode, BRANCH_DECISION selects BRANCH_PC when the
+   * instruction fetched after the delay slot was mispredicted.
+   */
   RegValue BRANCH_PC{};
   InputSelectorIFStage BRANCH_DECISION{};
   bool BRANCH_DELAY_SLOT{};
+  uint64_t SEQUENCE{};
+  StallCause BUBBLE_CAUSE{};
+
+  /* SR[F] once the instruction has executed */
+  bool FLAG{};
 };
 
 struct M_WBRegisters
@@ -70,6 +121,143 @@ struct M_WBRegisters
   RegValue DATA_READ_FROM_MEMORY{};
   RegValue ALU_RESULT{};
   RegNumber RD{};
+  StallCause BUBBLE_CAUSE{};
+};
+
+
+/*
+ * Pipeline depth
+ */
+
+/* The in-order pipeline has the classic five stages unless IF or MEM
+ * is split in two, or registers are read in a stage of their own:
+ *
+ *   IF [IF2] ID [RR] EX MEM [MEM2] WB
+ *
+ * IF2 and MEM2 only pass their pipeline register on: an instruction
+ * enters ID one cycle later, a loaded value is available one cycle
+ * later. RR reads the register file instead of ID. The pipeline
+ * register in front of an added stage has the type of the register
+ * behind it.
+ *
+ * Branches are resolved in EX, unless earlyBranches moves l.bf, l.bnf,
+ * l.j and l.jal to ID. ID then computes the target with an adder of its
+ * own and reads SR[F] from EX/M, holding a conditional branch while a
+ * compare in front of EX has not executed yet. l.jr still resolves in
+ * EX.
+ */
+struct PipelineDepthConfig
+{
+  unsigned int fetchStages = 1;
+  bool registerRead = false;
+  unsigned int memoryStages = 1;
+  bool earlyBranches = false;
+
+  unsigned int getDepth() const
+  {
+    return fetchStages + registerRead + memoryStages + 3;
+  }
+
+  /* Wrong-path instructions fetched before a mispredicted branch
+   * is resolved, beyond its delay slot.
+   */
+  unsigned int getBranchPenalty() const
+  {
+    return earlyBranches ? fetchStages - 1 : fetchStages + registerRead;
+  }
+
+  /* Bubbles between a load and a direct user of the value. */
+  unsigned int getLoadUsePenalty() const
+  {
+    return memoryStages;
+  }
+
+  std::string getStageNames() const;
+};
+
+
+/*
+ * Hazard detection unit
+ */
+
+/* The hazard detection unit is shared by the stages. For every
+ * instruction in ID, the source registers are compared against the
+ * destination registers of the instructions in EX (ID/EX), MEM (EX/M)
+ * and WB (M/WB). Dependencies on EX and MEM are resolved by forwarding
+ * into EX, a dependency on WB by bypassing the register file in ID.
+ * Only when the instruction in EX is a load whose result is needed,
+ * IF and ID are stalled for a cycle and a bubble is inserted.
+ *
+ * In a deeper pipeline the registers in front of RR (ID/RR) and MEM2
+ * (M/M2) are compared as well. The forwarding source follows from how
+ * far ahead the producer will be once the instruction reaches EX; a
+ * producer that will have passed WB by then was read from the register
+ * file, or bypassed in RR.
+ */
+class HazardDetector
+{
+  public:
+    void detect(RegNumber rs1, RegNumber rs2,
+                const ID_EXRegisters &id_ex,
+                const EX_MRegisters &ex_m,
+                const M_WBRegisters &m_wb)
+    {
+      detect(rs1, rs2, nullptr, id_ex, ex_m, nullptr, m_wb);
+    }
+
+    /* id_rr and m_m2 are nullptr when RR and MEM2 are absent. */
+    void detect(RegNumber rs1, RegNumber rs2,
+                const ID_EXRegisters *id_rr,
+                const ID_EXRegisters &id_ex,
+                const EX_MRegisters &ex_m,
+                const M_WBRegisters *m_m2,
+                const M_WBRegisters &m_wb);
+    void reset();
+
+    /* Operand sources for the instruction when it arrives in EX. */
+    InputSelectorForward getForwardA() const { return forwardA; }
+    InputSelectorForward getForwardB() const { return forwardB; }
+
+    /* Operand sources for reading the register file in ID; either
+     * RegisterFile or M_WB.
+     */
+    InputSelectorForward getBypassA() const { return bypassA; }
+    InputSelectorForward getBypassB() const { return bypassB; }
+
+    /* Load-use hazard: IF and ID must hold, ID/EX receives a bubble. */
+    bool getStall() const { return stall; }
+
+    /* Holds IF and ID for a reason outside the forwarding network: an
+     * outstanding multi-cycle result or a busy functional unit.
+     */
+    void hold() { stall = true; }
+
+    /* The value an instruction in the given pipeline register will
+     * write to its destination register.
+     */
+    static RegValue getResult(const EX_MRegisters &ex_m);
+    static RegValue getResult(const M_WBRegisters &m_wb);
+
+  private:
+    InputSelectorForward forwardA{};
+    InputSelectorForward forwardB{};
+    InputSelectorForward bypassA{};
+    InputSelectorForward bypassB{};
+    bool stall{};
+
+    /* Destination of an instruction behind ID, youngest first */
+    struct Producer
+    {
+      RegNumber rd{};
+      const ControlSignals *signals{};
+      InputSelectorForward source{};   /* when forwarded from here */
+    };
+
+    void detect(RegNumber rs,
+                const Producer *producers, size_t count,
+                bool registerRead,
+                InputSelectorForward &forward,
+                InputSelectorForward &bypass);
 };
 
 
@@ -138,6 +326,21 @@ class TestEndMarkerEncountered : public std::exception
 };
 
 
+/* The branch that redirects fetch in this cycle, if any. At most one
+ * branch is resolved per cycle: the instruction in ID behind a branch
+ * in EX is its delay slot.
+ */
+struct BranchRedirect
+{
+  bool taken{};          /* fetch must be redirected */
+  MemAddress PC{};       /* of the branch, plus 4 */
+  MemAddress target{};
+  uint64_t sequence{};
+
+  static BranchRedirect get(const EX_MRegisters &ex_m,
+                            const ID_EXRegisters *id_ex);
+};
+
 class InstructionFetchStage : public Stage
 {
   public:
@@ -146,21 +349,35 @@ class InstructionFetchStage : public Stage
                           IF_IDRegisters &if_id,
                           InstructionMemory instructionMemory,
                           MemAddress &PC, 
-                          HazardDetector &HAZARD_DETECTOR)
+                          HazardDetector &HAZARD_DETECTOR,
+                          BranchPredictionUnit &branchPredictor,
+                          uint64_t &nFetchStalls,
+                          PipelineWait &waitCycles,
+                          unsigned int stagesAfterFetch = 4,
+                          const ID_EXRegisters *id_ex = nullptr)
       : Stage(pipelining),
       ex_m(ex_m),
+      id_ex(id_ex),
       if_id(if_id),
       instructionMemory(instructionMemory),
       PC(PC),
       instr(0),
-      HAZARD_DETECTOR(HAZARD_DETECTOR)
+      HAZARD_DETECTOR(HAZARD_DETECTOR),
+      branchPredictor(branchPredictor),
+      nFetchStalls(nFetchStalls),
+      waitCycles(waitCycles),
+      stagesAfterFetch(stagesAfterFetch)
     { }
 
+    InstructionFetchStage(const InstructionFetchStage &) = delete;
+    InstructionFetchStage &operator=(const InstructionFetchStage &) = delete;
+
     void propagate() override;
     void clockPulse() override;
 
   private:
     const EX_MRegisters &ex_m;
+    const ID_EXRegisters *id_ex;    /* when ID resolves branches */
     IF_IDRegisters &if_id;
 
     InstructionMemory instructionMemory;
@@ -168,43 +385,142 @@ class InstructionFetchStage : public Stage
 
     /* TODO: add other necessary fields/buffers. */
     RegValue instr;
-    HazardDetector HAZARD_DETECTOR;
+    HazardDetector &HAZARD_DETECTOR;
+    BranchPredictionUnit &branchPredictor;
+
+    uint64_t &nFetchStalls;
+    PipelineWait &waitCycles;
+
+    /* Address of the instruction being fetched */
+    MemAddress fetchPC{};
+
+    /* Pipelined mode */
+    bool holding{};
+
+    /* Cycles until a slow fetch (instruction cache miss) completes;
+     * meanwhile bubbles are sent to ID.
+     */
+    unsigned int fetchWait{};
+    unsigned int fetchPortWait{};     /* first part of fetchWait */
+    uint64_t fetchSequence{};
+
+    /* A branch predicted taken redirects fetch once its delay slot
+     * has been fetched.
+     */
+    BranchPrediction prediction{};
+    bool redirectAfterDelaySlot{};
+    MemAddress predictedTarget{};
+
+    /* In pipelined mode, a fetch failure or test end marker is only
+     * raised once the instructions ahead of it have drained from the
+     * pipeline. It is discarded when the fetch turns out to be on the
+     * wrong path of a branch.
+     */
+    std::exception_ptr pendingException{};
+    int drainCycles{};
+    unsigned int stagesAfterFetch;
+
+    void propagatePipelined();
+    void clockPulsePipelined();
+};
+
+/* Second half of a split fetch stage. The instruction is squashed when
+ * it turns out to be on the wrong path of a branch, and held while ID
+ * is stalled.
+ */
+class InstructionFetch2Stage : public Stage
+{
+  public:
+    InstructionFetch2Stage(bool pipelining,
+                           const IF_IDRegisters &if_if2,
+                           const EX_MRegisters &ex_m,
+                           IF_IDRegisters &if_id,
+                           const HazardDetector &HAZARD_DETECTOR,
+                           const ID_EXRegisters *id_ex = nullptr)
+      : Stage(pipelining),
+      if_if2(if_if2), ex_m(ex_m), id_ex(id_ex), if_id(if_id),
+      HAZARD_DETECTOR(HAZARD_DETECTOR)
+    { }
+
+    InstructionFetch2Stage(const InstructionFetch2Stage &) = delete;
+    InstructionFetch2Stage &operator=(const InstructionFetch2Stage &) = delete;
+
+    void propagate() override;
+    void clockPulse() override;
+
+  private:
+    const IF_IDRegisters &if_if2;
+    const EX_MRegisters &ex_m;
+    const ID_EXRegisters *id_ex;    /* when ID resolves branches */
+    IF_IDRegisters &if_id;
+
+    const HazardDetector &HAZARD_DETECTOR;
+    IF_IDRegisters REGS{};
 };
 
 /*
  * Instruction decode
  */
 
+/* rb is the register holding the jump target of l.jr. */
+BranchKind getBranchKind(InstructionMnemonic mnemonic, RegNumber rb);
+
+/* Comparisons set SR[F]. */
+bool setsFlag(ALUOp op);
+
 class InstructionDecodeStage : public Stage
 {
   public:
+    /* In a deeper pipeline id_ex is the ID/RR register, and rr_ex and
+     * m_m2 are the registers in front of EX and MEM2; otherwise these
+     * are nullptr. branchPredictor is only given when direct branches
+     * are resolved in ID.
+     */
     InstructionDecodeStage(bool pipelining,
                            const IF_IDRegisters &if_id,
+                           const EX_MRegisters &ex_m,
                            const M_WBRegisters &m_wb,
                            ID_EXRegisters &id_ex,
+                           const ID_EXRegisters *rr_ex,
+                           const M_WBRegisters *m_m2,
                            RegisterFile &regfile,
                            InstructionDecoder &decoder,
                            uint64_t &nInstrIssued,
                            uint64_t &nStalls, 
                            HazardDetector &HAZARD_DETECTOR,
+                           FunctionalUnits &units,
+                           const uint64_t &cycle,
+                           BranchPredictionUnit *branchPredictor,
+                           uint64_t &nFlagStalls,
+                           const SymbolTable &symbols,
                            bool debugMode = false)
       : Stage(pipelining),
-      if_id(if_id), m_wb(m_wb), id_ex(id_ex),
+      if_id(if_id), ex_m(ex_m), m_wb(m_wb), id_ex(id_ex),
+      rr_ex(rr_ex), m_m2(m_m2),
       regfile(regfile), decoder(decoder),
       nInstrIssued(nInstrIssued), nStalls(nStalls),
+      symbols(symbols),
       debugMode(debugMode),
       SIGN_EXTENDED_IMMEDIATE(0), // Assuming default initialization to 0
       CONTROL_SIGNALS(),
-      HAZARD_DETECTOR(HAZARD_DETECTOR)
+      HAZARD_DETECTOR(HAZARD_DETECTOR),
+      units(units), cycle(cycle),
+      branchPredictor(branchPredictor), nFlagStalls(nFlagStalls)
     { }
 
+    InstructionDecodeStage(const InstructionDecodeStage &) = delete;
+    InstructionDecodeStage &operator=(const InstructionDecodeStage &) = delete;
+
     void propagate() override;
     void clockPulse() override;
 
   private:
     const IF_IDRegisters &if_id;
+    const EX_MRegisters &ex_m;
     const M_WBRegisters &m_wb;
     ID_EXRegisters &id_ex;
+    const ID_EXRegisters *rr_ex;
+    const M_WBRegisters *m_m2;
 
     RegisterFile &regfile;
     InstructionDecoder &decoder;
@@ -212,6 +528,7 @@ class InstructionDecodeStage : public Stage
     uint64_t &nInstrIssued;
     uint64_t &nStalls;
 
+    const SymbolTable &symbols;
     bool debugMode;
 
     MemAddress PC{};
@@ -219,7 +536,78 @@ class InstructionDecodeStage : public Stage
     /* TODO: add other necessary fields/buffers. */
     RegValue SIGN_EXTENDED_IMMEDIATE;
     ControlSignals CONTROL_SIGNALS;
-    HazardDetector HAZARD_DETECTOR;
+    HazardDetector &HAZARD_DETECTOR;
+    BranchPrediction PREDICTION{};
+    BranchKind BRANCH_KIND{};
+    uint64_t SEQUENCE{};
+    RegNumber RA{};
+    RegNumber RB{};
+
+    /* Set when the instruction in ID is on the wrong path of a taken
+     * branch and must be squashed.
+     */
+    bool FLUSH{};
+
+    /* Multi-cycle unit used by the instruction, reserved when it
+     * leaves ID.
+     */
+    FunctionalUnits &units;
+    const uint64_t &cycle;
+    ExecutionUnit UNIT{ ExecutionUnit::ALU };
+    bool UNIT_BUSY{};
+    RegNumber RD{};
+
+    /* Passed on with a bubble */
+    StallCause BUBBLE_CAUSE{};
+
+    /* Early branch resolution */
+    BranchPredictionUnit *branchPredictor;   /* nullptr: resolved in EX */
+    uint64_t &nFlagStalls;
+    bool FLAG_PENDING{};
+    bool BRANCH_RESOLVED{};
+    bool BRANCH_TAKEN{};
+    bool PREDICTION_CORRECT{};
+    RegValue BRANCH_TARGET{};
+    RegValue BRANCH_PC{};
+    InputSelectorIFStage BRANCH_DECISION{};
+
+    bool isFlagPending() const;
+    void resolveBranch();
+};
+
+/* Register read stage of a deeper pipeline. The operands are read from
+ * the register file again, bypassing a result that is written back in
+ * the same cycle; values still in flight are forwarded into EX as
+ * decided by the hazard detection unit in ID.
+ */
+class RegisterReadStage : public Stage
+{
+  public:
+    RegisterReadStage(bool pipelining,
+                      const ID_EXRegisters &id_rr,
+                      const EX_MRegisters &ex_m,
+                      const M_WBRegisters &m_wb,
+                      ID_EXRegisters &id_ex,
+                      RegisterFile &regfile)
+      : Stage(pipelining),
+      id_rr(id_rr), ex_m(ex_m), m_wb(m_wb), id_ex(id_ex),
+      regfile(regfile)
+    { }
+
+    void propagate() override;
+    void clockPulse() override;
+
+  private:
+    const ID_EXRegisters &id_rr;
+    const EX_MRegisters &ex_m;
+    const M_WBRegisters &m_wb;
+    ID_EXRegisters &id_ex;
+
+    /* Read through the ports of the second issue slot */
+    RegisterFile &regfile;
+    ID_EXRegisters REGS{};
+
+    RegValue readOperand(RegNumber reg, RegValue value) const;
 };
 
 /*
@@ -231,13 +619,21 @@ class ExecuteStage : public Stage
   public:
     ExecuteStage(bool pipelining,
                  const ID_EXRegisters &id_ex,
+                 const M_WBRegisters &m_m2,
+                 const M_WBRegisters &m_wb,
                  EX_MRegisters &ex_m, 
-                HazardDetector &HAZARD_DETECTOR)
+                HazardDetector &HAZARD_DETECTOR,
+                BranchPredictionUnit &branchPredictor,
+                FunctionalUnits &units,
+                const uint64_t &cycle,
+                PipelineWait &waitCycles)
       : Stage(pipelining),
-      id_ex(id_ex), ex_m(ex_m),
+      id_ex(id_ex), m_m2(m_m2), m_wb(m_wb), ex_m(ex_m),
       alu(), // Default construction of ALU
       CONTROL_SIGNALS(), // Default construction of CONTROL_SIGNALS
-      HAZARD_DETECTOR(HAZARD_DETECTOR)
+      HAZARD_DETECTOR(HAZARD_DETECTOR),
+      branchPredictor(branchPredictor),
+      units(units), cycle(cycle), waitCycles(waitCycles)
     { }
 
     void propagate() override;
@@ -245,6 +641,8 @@ class ExecuteStage : public Stage
 
   private:
     const ID_EXRegisters &id_ex;
+    const M_WBRegisters &m_m2;   /* m_wb without MEM2 */
+    const M_WBRegisters &m_wb;
     EX_MRegisters &ex_m;
 
     MemAddress PC{};
@@ -254,7 +652,17 @@ class ExecuteStage : public Stage
     RegNumber RD{};
     InputSelectorIFStage BRANCH_DECISION{};
     ControlSignals CONTROL_SIGNALS;
-    HazardDetector HAZARD_DETECTOR;
+    HazardDetector &HAZARD_DETECTOR;
+    BranchPredictionUnit &branchPredictor;
+
+    /* Branch resolution, pipelined mode */
+    RegValue BRANCH_PC{};
+    BranchKind BRANCH_KIND{};
+    uint64_t SEQUENCE{};
+    bool BRANCH_TAKEN{};
+    bool PREDICTION_CORRECT{};
+
+    void propagateBranch();
 
     // bool FLAG;     uninitializedFlag is not initialized here, so it has an 
     //                indeterminate value
@@ -265,6 +673,15 @@ class ExecuteStage : public Stage
     bool CARRY_FLAG{};
     bool OVERFLOW_FLAG{};
     bool BRANCH_DELAY_SLOT{};
+
+    /* Multi-cycle operations. In pipelined mode the result leaves
+     * through FunctionalUnits, otherwise EX holds the processor.
+     */
+    FunctionalUnits &units;
+    const uint64_t &cycle;
+    PipelineWait &waitCycles;
+
+    StallCause BUBBLE_CAUSE{};
 };
 
 /*
@@ -278,11 +695,13 @@ class MemoryStage : public Stage
                 const EX_MRegisters &ex_m,
                 M_WBRegisters &m_wb,
                 DataMemory dataMemory, 
-                HazardDetector &HAZARD_DETECTOR)
+                HazardDetector &HAZARD_DETECTOR,
+                PipelineWait &waitCycles)
       : Stage(pipelining),
       ex_m(ex_m), m_wb(m_wb), dataMemory(dataMemory),
       CONTROL_SIGNALS(), // Default construction of CONTROL_SIGNALS
-      HAZARD_DETECTOR(HAZARD_DETECTOR)
+      HAZARD_DETECTOR(HAZARD_DETECTOR),
+      waitCycles(waitCycles)
     { }
 
     void propagate() override;
@@ -297,10 +716,38 @@ class MemoryStage : public Stage
     MemAddress PC{};
     /* TODO: add other necessary fields/buffers */
     ControlSignals CONTROL_SIGNALS;
-    HazardDetector HAZARD_DETECTOR;
+    HazardDetector &HAZARD_DETECTOR;
     RegNumber RD{};
     RegValue ALU_RESULT{};
     RegValue DATA_READ_FROM_MEMORY{};
+
+    /* A slow data access holds the entire pipeline. */
+    PipelineWait &waitCycles;
+
+    StallCause BUBBLE_CAUSE{};
+};
+
+/* Second half of a split memory stage; the access itself is made in
+ * MEM, its result leaves MEM2.
+ */
+class Memory2Stage : public Stage
+{
+  public:
+    Memory2Stage(bool pipelining,
+                 const M_WBRegisters &m_m2,
+                 M_WBRegisters &m_wb)
+      : Stage(pipelining),
+      m_m2(m_m2), m_wb(m_wb)
+    { }
+
+    void propagate() override { REGS = m_m2; }
+    void clockPulse() override { m_wb = REGS; }
+
+  private:
+    const M_WBRegisters &m_m2;
+    M_WBRegisters &m_wb;
+
+    M_WBRegisters REGS{};
 };
 
 /*
@@ -315,12 +762,15 @@ class WriteBackStage : public Stage
                    RegisterFile &regfile,
                    bool &flag,
                    uint64_t &nInstrCompleted, 
-                   HazardDetector &HAZARD_DETECTOR)
+                   HazardDetector &HAZARD_DETECTOR,
+                   FunctionalUnits &units,
+                   const uint64_t &cycle)
       : Stage(pipelining),
       m_wb(m_wb), regfile(regfile), flag(flag),
       nInstrCompleted(nInstrCompleted),
       CONTROL_SIGNALS(), // Default construction of CONTROL_SIGNALS
-      HAZARD_DETECTOR(HAZARD_DETECTOR)
+      HAZARD_DETECTOR(HAZARD_DETECTOR),
+      units(units), cycle(cycle)
     { }
 
     void propagate() override;
@@ -334,16 +784,15 @@ class WriteBackStage : public Stage
 
     MemAddress PC{};
     ControlSignals CONTROL_SIGNALS;
-    HazardDetector HAZARD_DETECTOR;
+    HazardDetector &HAZARD_DETECTOR;
     bool &flag;
     uint64_t &nInstrCompleted;
-};
 
-class HazardDetector {
-  public:
-
-  private:
-    
+    /* Results of multi-cycle operations use the second write port. */
+    FunctionalUnits &units;
+    const uint64_t &cycle;
+    bool COMPLETED{};
+    uint64_t COMPLETED_SEQUENCE{};
 };
 
 #endif /* __STAGES_H__ */
@@ -0,0 +1,105 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    store-buffer.h - Write-combining store buffer.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __STORE_BUFFER_H__
+#define __STORE_BUFFER_H__
+
+#include "cache.h"
+#include "memory-bus.h"
+#include "prefetcher.h"
+
+#include <array>
+#include <deque>
+#include <ostream>
+
+struct StoreBufferConfig
+{
+  size_t entries = 0;               /* 0 disables the store buffer */
+  unsigned int combineCycles = 4;   /* cycles an entry accepts stores */
+};
+
+/* Sits between MEM and the data cache. A store to cacheable memory
+ * retires into the buffer in a single cycle, unless the buffer is full.
+ * Every entry covers an aligned word; a store to a word that is still
+ * buffered is merged into its entry.
+ *
+ * The oldest entry is written to memory once it has been open for
+ * combineCycles cycles and the previous write has completed. A complete
+ * word takes a single bus write, otherwise the valid bytes are written
+ * as aligned half words and bytes. The write accesses the data cache,
+ * whose latency keeps the buffer busy.
+ *
+ * Loads take the bytes they find in the buffer; a load found entirely
+ * in the buffer does not access the cache.
+ */
+class StoreBuffer
+{
+  public:
+    StoreBuffer(const StoreBufferConfig &config, MemoryBus &bus,
+                Cache *cache, PrefetchUnit *prefetcher,
+                const uint64_t &clock);
+
+    StoreBuffer(const StoreBuffer &) = delete;
+    StoreBuffer &operator=(const StoreBuffer &) = delete;
+
+    /* Buffers a store made by the instruction at pc; returns the
+     * cycles it takes.
+     */
+    unsigned int store(MemAddress pc, MemAddress addr, uint8_t size,
+                       uint64_t value);
+
+    /* Replaces the bytes of a value loaded from memory that are still
+     * buffered. covered tells whether all of them were.
+     */
+    uint64_t forward(MemAddress addr, uint8_t size, uint64_t value,
+                     bool &covered);
+
+    /* Writes all entries; returns the cycles until the last write
+     * completes.
+     */
+    uint64_t flush();
+
+    size_t getOccupancy() const { return entries.size(); }
+    uint64_t getStores() const { return nStores; }
+    uint64_t getCombined() const { return nCombined; }
+    uint64_t getBusWrites() const { return nBusWrites; }
+    uint64_t getForwarded() const { return nForwarded; }
+
+    void dumpStatistics(std::ostream &os) const;
+
+  private:
+    struct Entry
+    {
+      MemAddress word{};
+      MemAddress pc{};              /* of the last store merged */
+      std::array<uint8_t, 4> data{};
+      uint8_t mask{};               /* valid bytes */
+      uint64_t opened{};
+    };
+
+    const StoreBufferConfig config;
+    MemoryBus &bus;
+    Cache *cache;                   /* no ownership */
+    PrefetchUnit *prefetcher;       /* no ownership */
+    const uint64_t &clock;
+
+    std::deque<Entry> entries{};
+    uint64_t busyUntil{};
+
+    /* Statistics */
+    uint64_t nStores{};
+    uint64_t nCombined{};           /* stores merged into open entries */
+    uint64_t nBusWrites{};
+    uint64_t nForwarded{};          /* loads found entirely */
+    uint64_t nFullCycles{};         /* stores waiting for a free entry */
+
+    Entry *find(MemAddress word);
+    void update();
+    void writeOldest(uint64_t start);
+};
+
+#endif /* __STORE_BUFFER_H__ */
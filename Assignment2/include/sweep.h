@@ -0,0 +1,77 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    sweep.h - Design-space sweep over machine configurations.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#ifndef __SWEEP_H__
+#define __SWEEP_H__
+
+#include "elf-file.h"
+#include "machine-config.h"
+#include "processor.h"
+#include "testing.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct SweepPoint
+{
+  std::string label{};             /* the settings as written */
+  MachineConfig config{};
+};
+
+/* Parses a line of "name=value" settings separated by white space on
+ * top of base. Returns false for a line without settings; '#' starts a
+ * comment. Throws like MachineConfig::set().
+ */
+bool parseSweepPoint(std::string_view line, const MachineConfig &base,
+                     SweepPoint &point);
+
+/* Simulates one program under many configurations. The program is
+ * loaded once: all processors share its symbol table and the mapping of
+ * its read-only segments. The simulations run on a
+ * pool of threads, each taking the next configuration that has not
+ * been started, and the results are printed as a single table in the
+ * order of the configurations.
+ */
+class Sweep
+{
+  public:
+    Sweep(const ELFFile &program, std::vector<SweepPoint> points,
+          const std::vector<RegisterInit> &initializers);
+
+    Sweep(const Sweep &) = delete;
+    Sweep &operator=(const Sweep &) = delete;
+
+    /* Reads one configuration per line from filename. */
+    static std::vector<SweepPoint> readFile(const std::string &filename,
+                                            const MachineConfig &base);
+
+    /* 0 threads uses all cores. Returns whether every simulation
+     * completed.
+     */
+    bool run(unsigned int threads = 0);
+
+    void dumpResults(std::ostream &os) const;
+
+  private:
+    struct Result
+    {
+      bool completed{};
+      std::string error{};
+      ProcessorSummary summary{};
+    };
+
+    const ELFFile &program;
+    const std::vector<SweepPoint> points;
+    const std::vector<RegisterInit> initializers;
+
+    std::vector<Result> results{};
+
+    Result simulate(const SweepPoint &point) const;
+};
+
+#endif /* __SWEEP_H__ */
@@ -0,0 +1,65 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    symbol-table.h - Address to symbol lookup.
+ *
+ * Copyright (C) 2016  Leiden University, The Netherlands.
+ */
+
+#ifndef __SYMBOL_TABLE_H__
+#define __SYMBOL_TABLE_H__
+
+#include "arch.h"
+
+#include <string>
+#include <vector>
+
+struct Symbol
+{
+  MemAddress address{};
+  size_t size{};
+  std::string name{};
+};
+
+/* The SymbolTable is filled once when a program is loaded and is then
+ * only queried. Symbols are kept in an array sorted by address, so that
+ * a lookup is a binary search. Consecutive lookups tend to hit the same
+ * function, therefore a caller can pass its previous result as a hint
+ * that is checked first. The table itself does not change after
+ * finalize(), so that the simulations of a sweep can share it.
+ */
+class SymbolTable
+{
+  public:
+    SymbolTable() = default;
+
+    void clear();
+    void addSymbol(MemAddress address, size_t size, std::string_view name);
+
+    /* Must be called once all symbols have been added and before the
+     * first lookup.
+     */
+    void finalize();
+
+    bool empty() const { return symbols.empty(); }
+    size_t size() const { return symbols.size(); }
+
+    /* Returns the symbol containing addr, or nullptr if there is none.
+     * Symbols without size (e.g. assembly labels) extend up to the next
+     * symbol. hint is nullptr or a result of an earlier lookup since
+     * finalize().
+     */
+    const Symbol *lookup(MemAddress addr,
+                         const Symbol *hint = nullptr) const;
+
+    /* Formats addr as "function+offset", returns an empty string if
+     * addr cannot be symbolized.
+     */
+    std::string format(MemAddress addr) const;
+
+  private:
+    std::vector<Symbol> symbols{};
+
+    bool contains(const Symbol &symbol, MemAddress addr) const;
+};
+
+#endif /* __SYMBOL_TABLE_H__ */
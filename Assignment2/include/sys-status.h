@@ -16,10 +16,12 @@
 
 #include "memory-interface.h"
 
+#include <iostream>
+
 class SysStatus : public MemoryInterface
 {
   public:
-    SysStatus(const MemAddress base);
+    SysStatus(const MemAddress base, std::ostream &console = std::cerr);
     ~SysStatus() override = default;
 
     bool shouldHalt() const { return shouldHaltFlag; }
@@ -36,9 +38,11 @@ class SysStatus : public MemoryInterface
     void writeDoubleWord(MemAddress addr, uint64_t value) override;
 
     bool contains(MemAddress addr) const override;
+    std::vector<AddressRange> getRanges() const override;
 
   private:
     const MemAddress base;
+    std::ostream &console;
 
     bool shouldHaltFlag = false;
 };
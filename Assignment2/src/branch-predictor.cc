@@ -0,0 +1,345 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    branch-predictor.cc - Branch prediction in the fetch stage.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "branch-predictor.h"
+#include "inst-decoder.h"
+
+#include <iomanip>
+#include <stdexcept>
+
+/* 2-bit saturating counters: 0, 1 predict not taken; 2, 3 taken. */
+static constexpr uint8_t CounterMax = 3;
+static constexpr uint8_t CounterWeaklyTaken = 2;
+
+static inline bool
+counterTaken(uint8_t counter)
+{
+  return counter >= CounterWeaklyTaken;
+}
+
+static inline void
+counterUpdate(uint8_t &counter, bool taken)
+{
+  if (taken && counter < CounterMax)
+    ++counter;
+  else if (!taken && counter > 0)
+    --counter;
+}
+
+
+/*
+ * Direction predictors
+ */
+
+bool
+StaticNotTakenPredictor::predict(MemAddress pc, MemAddress target) const
+{
+  return false;
+}
+
+void
+StaticNotTakenPredictor::update(MemAddress pc, MemAddress target, bool taken)
+{
+}
+
+
+bool
+StaticBackwardTakenPredictor::predict(MemAddress pc, MemAddress target) const
+{
+  return target < pc;
+}
+
+void
+StaticBackwardTakenPredictor::update(MemAddress pc, MemAddress target,
+                                     bool taken)
+{
+}
+
+
+BimodalPredictor::BimodalPredictor(unsigned int tableBits)
+  : counters(size_t(1) << tableBits, CounterWeaklyTaken)
+{
+}
+
+bool
+BimodalPredictor::predict(MemAddress pc, MemAddress target) const
+{
+  return counterTaken(counters[index(pc)]);
+}
+
+void
+BimodalPredictor::update(MemAddress pc, MemAddress target, bool taken)
+{
+  counterUpdate(counters[index(pc)], taken);
+}
+
+size_t
+BimodalPredictor::index(MemAddress pc) const
+{
+  return (pc / INSTRUCTION_SIZE) & (counters.size() - 1);
+}
+
+
+GSharePredictor::GSharePredictor(unsigned int tableBits,
+                                 unsigned int historyBits)
+  : counters(size_t(1) << tableBits, CounterWeaklyTaken),
+    historyMask((uint32_t(1) << historyBits) - 1)
+{
+}
+
+bool
+GSharePredictor::predict(MemAddress pc, MemAddress target) const
+{
+  return counterTaken(counters[index(pc)]);
+}
+
+void
+GSharePredictor::update(MemAddress pc, MemAddress target, bool taken)
+{
+  counterUpdate(counters[index(pc)], taken);
+  history = ((history << 1) | (taken ? 1 : 0)) & historyMask;
+}
+
+size_t
+GSharePredictor::index(MemAddress pc) const
+{
+  return ((pc / INSTRUCTION_SIZE) ^ history) & (counters.size() - 1);
+}
+
+
+TournamentPredictor::TournamentPredictor(unsigned int tableBits,
+                                         unsigned int historyBits)
+  : bimodal(tableBits), gshare(tableBits, historyBits),
+    chooser(size_t(1) << tableBits, CounterWeaklyTaken)
+{
+}
+
+/* A chooser counter in the "taken" half selects gshare. */
+bool
+TournamentPredictor::predict(MemAddress pc, MemAddress target) const
+{
+  if (counterTaken(chooser[index(pc)]))
+    return gshare.predict(pc, target);
+  return bimodal.predict(pc, target);
+}
+
+void
+TournamentPredictor::update(MemAddress pc, MemAddress target, bool taken)
+{
+  bool bimodalCorrect = bimodal.predict(pc, target) == taken;
+  bool gshareCorrect = gshare.predict(pc, target) == taken;
+
+  if (bimodalCorrect != gshareCorrect)
+    counterUpdate(chooser[index(pc)], gshareCorrect);
+
+  bimodal.update(pc, target, taken);
+  gshare.update(pc, target, taken);
+}
+
+size_t
+TournamentPredictor::index(MemAddress pc) const
+{
+  return (pc / INSTRUCTION_SIZE) & (chooser.size() - 1);
+}
+
+
+std::unique_ptr<BranchPredictor>
+makeBranchPredictor(const BranchPredictorConfig &config)
+{
+  switch (config.type)
+    {
+      case BranchPredictorType::NotTaken:
+        return std::make_unique<StaticNotTakenPredictor>();
+
+      case BranchPredictorType::BackwardTaken:
+        return std::make_unique<StaticBackwardTakenPredictor>();
+
+      case BranchPredictorType::Bimodal:
+        return std::make_unique<BimodalPredictor>(config.tableBits);
+
+      case BranchPredictorType::GShare:
+        return std::make_unique<GSharePredictor>(config.tableBits,
+                                                 config.historyBits);
+
+      case BranchPredictorType::Tournament:
+        return std::make_unique<TournamentPredictor>(config.tableBits,
+                                                     config.historyBits);
+    }
+
+  throw std::invalid_argument("Unknown branch predictor type.");
+}
+
+
+/*
+ * Branch target buffer
+ */
+
+BranchTargetBuffer::BranchTargetBuffer(size_t nEntries)
+  : entries(nEntries)
+{
+  if (nEntries == 0 || (nEntries & (nEntries - 1)) != 0)
+    throw std::out_of_range("BTB size must be a power of 2.");
+}
+
+bool
+BranchTargetBuffer::lookup(MemAddress pc, MemAddress &target,
+                           BranchKind &kind) const
+{
+  const Entry &entry = entries[(pc / INSTRUCTION_SIZE) & (entries.size() - 1)];
+  if (!entry.valid || entry.pc != pc)
+    return false;
+
+  target = entry.target;
+  kind = entry.kind;
+  return true;
+}
+
+void
+BranchTargetBuffer::update(MemAddress pc, MemAddress target, BranchKind kind)
+{
+  Entry &entry = entries[(pc / INSTRUCTION_SIZE) & (entries.size() - 1)];
+  entry.valid = true;
+  entry.pc = pc;
+  entry.target = target;
+  entry.kind = kind;
+}
+
+
+/*
+ * Return address stack
+ */
+
+ReturnAddressStack::ReturnAddressStack(size_t depth)
+  : stack(depth)
+{
+}
+
+void
+ReturnAddressStack::push(MemAddress addr)
+{
+  if (stack.empty())
+    return;
+
+  top = (top + 1) % stack.size();
+  stack[top] = addr;
+  if (count < stack.size())
+    ++count;
+}
+
+bool
+ReturnAddressStack::pop(MemAddress &addr)
+{
+  if (count == 0)
+    return false;
+
+  addr = stack[top];
+  top = (top + stack.size() - 1) % stack.size();
+  --count;
+  return true;
+}
+
+
+/*
+ * Branch prediction unit
+ */
+
+BranchPredictionUnit::BranchPredictionUnit(const BranchPredictorConfig &config)
+  : sequential{ config.type == BranchPredictorType::NotTaken },
+    direction{ makeBranchPredictor(config) },
+    btb{ config.btbEntries },
+    ras{ config.rasDepth }
+{
+}
+
+/* The return address stack is updated speculatively in IF and is not
+ * repaired after a misprediction.
+ */
+BranchPrediction
+BranchPredictionUnit::predict(MemAddress pc, MemAddress linkAddress)
+{
+  BranchPrediction prediction;
+  BranchKind kind{};
+
+  if (sequential || !btb.lookup(pc, prediction.target, kind))
+    return prediction;
+
+  switch (kind)
+    {
+      case BranchKind::Conditional:
+        prediction.taken = direction->predict(pc, prediction.target);
+        break;
+
+      case BranchKind::Call:
+        ras.push(linkAddress);
+        prediction.taken = true;
+        break;
+
+      case BranchKind::Return:
+        /* Fall back on the last target recorded in the BTB. */
+        ras.pop(prediction.target);
+        prediction.taken = true;
+        break;
+
+      case BranchKind::Jump:
+      case BranchKind::Indirect:
+        prediction.taken = true;
+        break;
+
+      case BranchKind::None:
+        break;
+    }
+
+  return prediction;
+}
+
+void
+BranchPredictionUnit::resolve(MemAddress pc, BranchKind kind, bool taken,
+                              MemAddress target, bool correct)
+{
+  if (kind == BranchKind::Conditional)
+    direction->update(pc, target, taken);
+  if (taken)
+    btb.update(pc, target, kind);
+
+  auto &stats = branches[pc];
+  ++stats.executed;
+  ++nBranches;
+  if (taken)
+    {
+      ++stats.taken;
+      ++nTaken;
+    }
+  if (correct)
+    ++stats.correct;
+  else
+    ++nMispredictions;
+}
+
+void
+BranchPredictionUnit::dumpStatistics(std::ostream &os,
+                                     const SymbolTable &symbols) const
+{
+  auto storeFlags(os.flags());
+
+  os << nBranches << " branches, " << nMispredictions
+     << " mispredicted, " << getCyclesSaved()
+     << " cycles saved by branch prediction." << std::endl;
+
+  for (const auto & [pc, stats] : branches)
+    {
+      os << "  " << std::hex << std::showbase << pc << std::dec;
+      std::string symbol = symbols.format(pc);
+      if (!symbol.empty())
+        os << " <" << symbol << ">";
+      os << ": " << stats.executed << " executed, "
+         << stats.taken << " taken, "
+         << std::fixed << std::setprecision(1)
+         << (100.0 * stats.correct / stats.executed) << "% correct"
+         << std::endl;
+      os.flags(storeFlags);
+    }
+}
@@ -0,0 +1,255 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    cache.cc - Set-associative cache timing model.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "cache.h"
+
+#include <iomanip>
+#include <stdexcept>
+
+static bool
+isPowerOfTwo(size_t value)
+{
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+static unsigned int
+log2(size_t value)
+{
+  unsigned int result = 0;
+  while (value >>= 1)
+    ++result;
+  return result;
+}
+
+
+Cache::Cache(std::string_view name, const CacheConfig &config,
+             MemoryLevel *next)
+  : name{ name }, config{ config }, next{ next },
+    nSets{}, offsetBits{}, indexBits{}
+{
+  if (!isPowerOfTwo(config.size) || !isPowerOfTwo(config.lineSize) ||
+      !isPowerOfTwo(config.associativity))
+    throw std::out_of_range(this->name +
+                            ": size, line size and associativity must be "
+                            "powers of 2");
+
+  if (config.lineSize * config.associativity > config.size)
+    throw std::out_of_range(this->name + ": size too small");
+
+  /* The PLRU tree of a set must fit in a single word. */
+  if (config.associativity > 64)
+    throw std::out_of_range(this->name + ": associativity too large");
+
+  nSets = config.size / (config.lineSize * config.associativity);
+  offsetBits = log2(config.lineSize);
+  indexBits = log2(nSets);
+
+  lines.resize(nSets * config.associativity);
+  plru.resize(nSets);
+}
+
+unsigned int
+Cache::access(MemAddress addr, bool write)
+{
+  size_t set = getSet(addr);
+  MemAddress tag = getTag(addr);
+  unsigned int latency = config.hitLatency;
+
+  /* Write-through: every write also goes to memory. */
+  if (write && !config.writeBack)
+    latency += accessNext(addr, true);
+
+  Line *line = find(set, tag);
+  if (line)
+    {
+      ++nHits;
+      touch(set, line - &lines[set * config.associativity]);
+      if (write && config.writeBack)
+        line->dirty = true;
+      return latency;
+    }
+
+  ++nMisses;
+  if (write && !config.writeAllocate)
+    {
+      if (config.writeBack)
+        latency += accessNext(addr, true);
+      return latency;
+    }
+
+  return latency + fill(set, tag, write && config.writeBack);
+}
+
+unsigned int
+Cache::prefetch(MemAddress addr)
+{
+  size_t set = getSet(addr);
+  MemAddress tag = getTag(addr);
+
+  if (find(set, tag))
+    return 0;
+
+  return fill(set, tag, false);
+}
+
+bool
+Cache::contains(MemAddress addr) const
+{
+  return find(getSet(addr), getTag(addr)) != nullptr;
+}
+
+void
+Cache::dumpStatistics(std::ostream &os) const
+{
+  auto storeFlags(os.flags());
+
+  os << name << ": " << getAccesses() << " accesses, "
+     << nHits << " hits, " << nMisses << " misses";
+  if (getAccesses() > 0)
+    os << " (" << std::fixed << std::setprecision(2)
+       << (100.0 * nMisses / getAccesses()) << "% miss rate)";
+  os.flags(storeFlags);
+  os << ", " << nEvictions << " evictions";
+  if (config.writeBack)
+    os << ", " << nWriteBacks << " write-backs";
+  os << "." << std::endl;
+}
+
+/*
+ * Private methods
+ */
+
+size_t
+Cache::getSet(MemAddress addr) const
+{
+  return (addr >> offsetBits) & (nSets - 1);
+}
+
+MemAddress
+Cache::getTag(MemAddress addr) const
+{
+  return addr >> (offsetBits + indexBits);
+}
+
+MemAddress
+Cache::getLineAddress(size_t set, MemAddress tag) const
+{
+  return (tag << (offsetBits + indexBits)) | (set << offsetBits);
+}
+
+Cache::Line *
+Cache::find(size_t set, MemAddress tag)
+{
+  for (size_t way = 0; way < config.associativity; ++way)
+    {
+      Line &line = lines[set * config.associativity + way];
+      if (line.valid && line.tag == tag)
+        return &line;
+    }
+
+  return nullptr;
+}
+
+const Cache::Line *
+Cache::find(size_t set, MemAddress tag) const
+{
+  return const_cast<Cache *>(this)->find(set, tag);
+}
+
+size_t
+Cache::findVictim(size_t set)
+{
+  const size_t base = set * config.associativity;
+
+  for (size_t way = 0; way < config.associativity; ++way)
+    if (!lines[base + way].valid)
+      return way;
+
+  switch (config.replacement)
+    {
+      case ReplacementPolicy::LRU:
+        {
+          size_t victim = 0;
+          for (size_t way = 1; way < config.associativity; ++way)
+            if (lines[base + way].lastUse < lines[base + victim].lastUse)
+              victim = way;
+          return victim;
+        }
+
+      case ReplacementPolicy::PLRU:
+        {
+          /* Follow the tree bits, which point away from recent uses. */
+          size_t node = 0;
+          size_t way = 0;
+          for (unsigned int level = 0; level < log2(config.associativity); ++level)
+            {
+              size_t bit = (plru[set] >> node) & 1;
+              way = (way << 1) | bit;
+              node = 2 * node + 1 + bit;
+            }
+          return way;
+        }
+
+      case ReplacementPolicy::Random:
+        return random() % config.associativity;
+    }
+
+  return 0;
+}
+
+/* Replaces a line of set by tag, writing back a dirty victim. */
+unsigned int
+Cache::fill(size_t set, MemAddress tag, bool dirty)
+{
+  unsigned int latency = 0;
+
+  size_t way = findVictim(set);
+  Line &victim = lines[set * config.associativity + way];
+  if (victim.valid)
+    {
+      ++nEvictions;
+      if (victim.dirty)
+        {
+          ++nWriteBacks;
+          latency += accessNext(getLineAddress(set, victim.tag), true);
+        }
+    }
+
+  victim.valid = true;
+  victim.dirty = dirty;
+  victim.tag = tag;
+  touch(set, way);
+
+  return latency + accessNext(getLineAddress(set, tag), false);
+}
+
+void
+Cache::touch(size_t set, size_t way)
+{
+  lines[set * config.associativity + way].lastUse = ++useCounter;
+
+  const unsigned int levels = log2(config.associativity);
+  size_t node = 0;
+  for (unsigned int level = 0; level < levels; ++level)
+    {
+      size_t bit = (way >> (levels - 1 - level)) & 1;
+      if (bit)
+        plru[set] &= ~(uint64_t(1) << node);
+      else
+        plru[set] |= uint64_t(1) << node;
+      node = 2 * node + 1 + bit;
+    }
+}
+
+unsigned int
+Cache::accessNext(MemAddress addr, bool write)
+{
+  if (next)
+    return next->access(addr, write);
+
+  return config.missPenalty;
+}
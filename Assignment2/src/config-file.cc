@@ -14,7 +14,11 @@
 #include <algorithm>
 #include <regex>
 
-/* All key-value pairs not designated to a section are placed in a
+/* Lines are section headers "[name]", key-value pairs "key = value" or
+ * empty. Everything from a '#' or ';' that follows white space, or
+ * starts the line, is a comment.
+ *
+ * All key-value pairs not designated to a section are placed in a
  * section __GLOBAL. Since this name is not accepted by sectionRegex,
  * there cannot be a collision.
  */
@@ -43,9 +47,9 @@ ConfigFile::load(std::string_view filename)
   sections.push_back(currentSection);
 
   /* Regexes to use while parsing */
-  std::regex sectionRegex{ R"(\[([a-zA-Z0-9]+)\]\s*)" };
-  std::regex keyValueRegex{ R"(([a-zA-Z]\S*)\s*=\s*(\S+))" };
-  std::regex emptyLineRegex{ "^\\s*$" };
+  std::regex sectionRegex{ R"(\s*\[([a-zA-Z0-9]+)\]\s*([#;].*)?)" };
+  std::regex keyValueRegex{ R"(\s*([a-zA-Z]\S*)\s*=\s*(\S+)\s*([#;].*)?)" };
+  std::regex emptyLineRegex{ R"(\s*([#;].*)?)" };
   std::smatch match;
 
   /* Open and parse the file */
@@ -2,8 +2,11 @@
 #include <iostream>
 
 
+/* Default control signals are those of l.nop, so that a default
+ * constructed pipeline register is a bubble.
+ */
 ControlSignals::ControlSignals()
-  : opCode(), functionCode() 
+  : opCode(NopInstructionWord >> 26), functionCode(InstructionMnemonic::L_NOP)
 {
 }
 
@@ -105,9 +108,13 @@ ALUOp ControlSignals::AluOp() const
       return ALUOp::SUB;
       break;
     case InstructionMnemonic::L_MACI:
+    case InstructionMnemonic::L_MUL:
+    case InstructionMnemonic::L_MULI:
+    case InstructionMnemonic::L_MULU:
       // Perform ALU operation MUL
       return ALUOp::MUL;
       break;
+    case InstructionMnemonic::L_DIVU:
       // Perform ALU operation DIV
       return ALUOp::DIV;
       break;
@@ -195,6 +202,13 @@ bool ControlSignals::regWriteInput() const
     case InstructionMnemonic::L_MOVHI:
       return true;
 
+    // Multiply and divide
+    case InstructionMnemonic::L_MUL:
+    case InstructionMnemonic::L_MULI:
+    case InstructionMnemonic::L_MULU:
+    case InstructionMnemonic::L_DIVU:
+      return true;
+
 
     // Jump and Link Instructions
     case InstructionMnemonic::L_JAL:
@@ -339,3 +353,18 @@ bool ControlSignals::signExtendedRead() const
       return false;
   }
 }
+
+ExecutionUnit ControlSignals::getExecutionUnit() const
+{
+  switch (this->functionCode) {
+    case InstructionMnemonic::L_MACI:
+    case InstructionMnemonic::L_MUL:
+    case InstructionMnemonic::L_MULI:
+    case InstructionMnemonic::L_MULU:
+      return ExecutionUnit::Multiplier;
+    case InstructionMnemonic::L_DIVU:
+      return ExecutionUnit::Divider;
+    default:
+      return ExecutionUnit::ALU;
+  }
+}
@@ -0,0 +1,202 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    cycle-accounting.cc - Attribution of cycles to stall reasons.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "cycle-accounting.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <vector>
+
+const char *
+getCategoryName(CycleCategory category)
+{
+  switch (category)
+    {
+      case CycleCategory::Base:
+        return "base";
+      case CycleCategory::BranchMispredict:
+        return "branch misprediction";
+      case CycleCategory::DataHazard:
+        return "data hazard";
+      case CycleCategory::LoadUse:
+        return "load-use";
+      case CycleCategory::ICacheMiss:
+        return "I-cache miss";
+      case CycleCategory::DCacheMiss:
+        return "D-cache miss";
+      case CycleCategory::Structural:
+        return "structural";
+      case CycleCategory::Drain:
+        return "drain at halt";
+      default:
+        return "?";
+    }
+}
+
+
+void
+PipelineWait::add(uint64_t cycles, CycleCategory category, MemAddress address)
+{
+  if (cycles == 0)
+    return;
+
+  waits.emplace_back(StallCause{ category, address }, cycles);
+  total += cycles;
+}
+
+uint64_t
+PipelineWait::advance(uint64_t cycles, StallCause &cause)
+{
+  if (waits.empty())
+    return 0;
+
+  auto &[front, remaining] = waits.front();
+  cycles = std::min(cycles, remaining);
+  cause = front;
+
+  remaining -= cycles;
+  total -= cycles;
+  if (remaining == 0)
+    waits.pop_front();
+
+  return cycles;
+}
+
+
+uint64_t
+CycleAccounting::Counts::getCycles() const
+{
+  return std::accumulate(cycles.begin(), cycles.end(), uint64_t{ 0 });
+}
+
+CycleAccounting::CycleAccounting(const SymbolTable &symbols)
+  : symbols{ symbols }
+{
+}
+
+CycleAccounting::Counts &
+CycleAccounting::getCounts(MemAddress address)
+{
+  /* nullptr collects the addresses without symbol. */
+  const Symbol *symbol = symbols.lookup(address, lastSymbol);
+  if (symbol)
+    lastSymbol = symbol;
+
+  return perSymbol[symbol];
+}
+
+void
+CycleAccounting::account(const StallCause &cause, uint64_t cycles)
+{
+  const size_t index = static_cast<size_t>(cause.category);
+
+  total.cycles[index] += cycles;
+  getCounts(cause.address).cycles[index] += cycles;
+}
+
+void
+CycleAccounting::retire(MemAddress address)
+{
+  ++total.instructions;
+  ++getCounts(address).instructions;
+}
+
+uint64_t
+CycleAccounting::getCycles() const
+{
+  return total.getCycles();
+}
+
+/* Prints the categories that have cycles, as CPI when instructions
+ * completed and as cycles otherwise.
+ */
+void
+CycleAccounting::dumpStack(std::ostream &os, const Counts &counts)
+{
+  bool first = true;
+
+  for (size_t i = 0; i < counts.cycles.size(); ++i)
+    {
+      if (counts.cycles[i] == 0)
+        continue;
+
+      os << (first ? "" : ", ")
+         << getCategoryName(static_cast<CycleCategory>(i)) << " ";
+      if (counts.instructions > 0)
+        os << std::fixed << std::setprecision(2)
+           << double(counts.cycles[i]) / counts.instructions;
+      else
+        os << counts.cycles[i];
+      first = false;
+    }
+}
+
+void
+CycleAccounting::dumpStatistics(std::ostream &os) const
+{
+  auto storeFlags(os.flags());
+  auto storeFill(os.fill(' '));
+  const uint64_t cycles = getCycles();
+
+  os << "CPI stack: " << total.instructions << " instructions in "
+     << cycles << " cycles";
+  if (total.instructions > 0)
+    os << ", CPI " << std::fixed << std::setprecision(2)
+       << double(cycles) / total.instructions;
+  os << "." << std::endl;
+  os.flags(storeFlags);
+
+  for (size_t i = 0; i < total.cycles.size(); ++i)
+    {
+      os << "  " << std::left << std::setw(22)
+         << getCategoryName(static_cast<CycleCategory>(i)) << std::right
+         << std::setw(10) << total.cycles[i] << " cycles";
+      if (total.instructions > 0)
+        os << "  " << std::fixed << std::setprecision(3)
+           << double(total.cycles[i]) / total.instructions << " CPI";
+      if (cycles > 0)
+        os << "  " << std::fixed << std::setprecision(1) << std::setw(5)
+           << 100.0 * total.cycles[i] / cycles << "%";
+      os << std::endl;
+      os.flags(storeFlags);
+    }
+
+  /* Functions taking most cycles first */
+  std::vector<std::pair<const Symbol *, const Counts *>> functions;
+  for (const auto &[symbol, counts] : perSymbol)
+    if (counts.getCycles() > 0 || counts.instructions > 0)
+      functions.emplace_back(symbol, &counts);
+
+  std::sort(functions.begin(), functions.end(),
+            [](const auto &a, const auto &b)
+              {
+                uint64_t cyclesA = a.second->getCycles();
+                uint64_t cyclesB = b.second->getCycles();
+                if (cyclesA != cyclesB)
+                  return cyclesA > cyclesB;
+                if (! a.first || ! b.first)
+                  return b.first == nullptr && a.first != nullptr;
+                return a.first->address < b.first->address;
+              });
+
+  for (const auto &[symbol, counts] : functions)
+    {
+      os << "  <" << (symbol ? symbol->name : "unknown") << ">: "
+         << counts->instructions << " instructions, "
+         << counts->getCycles() << " cycles";
+      if (counts->instructions > 0)
+        os << ", CPI " << std::fixed << std::setprecision(2)
+           << double(counts->getCycles()) / counts->instructions;
+      os << " (";
+      dumpStack(os, *counts);
+      os << ")" << std::endl;
+      os.flags(storeFlags);
+    }
+
+  os.fill(storeFill);
+}
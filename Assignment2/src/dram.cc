@@ -0,0 +1,65 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    dram.cc - DRAM controller timing model.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "dram.h"
+
+#include <stdexcept>
+
+static bool
+isPowerOfTwo(size_t value)
+{
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+
+DRAMController::DRAMController(const DRAMConfig &config,
+                               unsigned int busClockDivider)
+  : config{ config }, busClockDivider{ busClockDivider },
+    openRow(config.banks, NoRow)
+{
+  if (!isPowerOfTwo(config.banks) || !isPowerOfTwo(config.rowSize))
+    throw std::out_of_range("DRAM: number of banks and row size must be "
+                            "powers of 2");
+}
+
+/* Returns the latency in processor cycles. */
+unsigned int
+DRAMController::access(MemAddress addr, bool write)
+{
+  size_t bank = (addr / config.rowSize) & (config.banks - 1);
+  MemAddress row = addr / (config.rowSize * config.banks);
+
+  unsigned int busCycles = config.tCAS + config.tBurst;
+  if (openRow[bank] == row)
+    ++nRowHits;
+  else if (openRow[bank] == NoRow)
+    {
+      ++nRowEmpty;
+      busCycles += config.tRCD;
+    }
+  else
+    {
+      ++nRowConflicts;
+      busCycles += config.tRP + config.tRCD;
+    }
+
+  openRow[bank] = row;
+  if (write)
+    ++nWrites;
+  else
+    ++nReads;
+
+  return busCycles * busClockDivider;
+}
+
+void
+DRAMController::dumpStatistics(std::ostream &os) const
+{
+  os << "DRAM: " << nReads << " reads, " << nWrites << " writes, "
+     << nRowHits << " row hits, " << nRowEmpty << " row activations, "
+     << nRowConflicts << " row conflicts." << std::endl;
+}
@@ -0,0 +1,637 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    dual-issue.cc - Stages of the 2-wide in-order pipeline.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "dual-issue.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+void
+IssueStatistics::dump(std::ostream &os) const
+{
+  auto storeFlags(os.flags());
+  uint64_t total = nSingleIssue + nDualIssue;
+
+  os << nDualIssue << " of " << total << " issue cycles dual-issued";
+  if (total > 0)
+    os << " (" << std::fixed << std::setprecision(2)
+       << (100.0 * nDualIssue / total) << "%)";
+  os.flags(storeFlags);
+  os << "." << std::endl;
+
+  auto failure = [this](PairingFailure f)
+    {
+      return failures[static_cast<size_t>(f)];
+    };
+  os << "Not paired: "
+     << failure(PairingFailure::NoInstruction) << " no second instruction, "
+     << failure(PairingFailure::Dependency) << " dependency, "
+     << failure(PairingFailure::LoadUse) << " load-use, "
+     << failure(PairingFailure::MemoryPort) << " memory port, "
+     << failure(PairingFailure::Branch) << " branch in slot 1."
+     << std::endl;
+}
+
+bool
+isSquashed(const IssueGroup<EX_MRegisters> &ex_m, uint64_t sequence)
+{
+  return ex_m[0].BRANCH_DECISION == InputSelectorIFStage::InputTwo &&
+      sequence > ex_m[0].SEQUENCE + 1;
+}
+
+static bool
+writesRegister(const ControlSignals &signals, RegNumber rd, RegNumber reg)
+{
+  return reg != 0 && rd == reg && signals.regWriteInput();
+}
+
+static bool
+accessesMemory(const ControlSignals &signals)
+{
+  return signals.isReadOpBool() || signals.isWriteOpBool();
+}
+
+
+/*
+ * Instruction fetch
+ */
+
+void
+DualFetchStage::propagate()
+{
+  const EX_MRegisters &branch = regs.ex_m[0];
+  bool redirect = branch.BRANCH_DECISION == InputSelectorIFStage::InputTwo;
+
+  /* The delay slot has not been fetched yet: redirect after it. */
+  if (redirect && fetchSequence <= branch.SEQUENCE)
+    {
+      redirectAfterDelaySlot = true;
+      predictedTarget = branch.BRANCH_PC;
+      redirect = false;
+    }
+
+  squash = redirect;
+  if (redirect)
+    {
+      lastKept = branch.SEQUENCE + 1;
+      branchAddress = branch.PC - 4;
+      redirectAfterDelaySlot = false;
+      pendingException = nullptr;
+
+      group.erase(std::remove_if(group.begin(), group.end(),
+                                 [this](const IF_IDRegisters &entry)
+                                   {
+                                     return entry.SEQUENCE > lastKept;
+                                   }),
+                  group.end());
+      if (group.empty())
+        fetchWait = 0;
+
+      PC = branch.BRANCH_PC;
+    }
+
+  if (pendingException)
+    {
+      if (group.empty() && regs.fetchQueue.empty() && drainCycles == 0)
+        std::rethrow_exception(pendingException);
+      return;
+    }
+
+  if (group.empty() &&
+      regs.fetchQueue.size() + IssueWidth <= DualIssueRegisters::FetchQueueSize)
+    fetchGroup();
+}
+
+/* Fetches up to IssueWidth sequential instructions. A fetch group ends
+ * after the delay slot of a branch predicted taken.
+ */
+void
+DualFetchStage::fetchGroup()
+{
+  unsigned int latency = 1;
+
+  for (size_t i = 0; i < IssueWidth; ++i)
+    {
+      IF_IDRegisters entry{};
+
+      try
+        {
+          instructionMemory.setAddress(PC);
+          instructionMemory.setSize(4);
+          entry.INSTRUCTION_WORD = instructionMemory.getValue();
+          latency = std::max(latency, instructionMemory.getLatency());
+
+          if (entry.INSTRUCTION_WORD == TestEndMarker)
+            throw TestEndMarkerEncountered(PC);
+        }
+      catch (TestEndMarkerEncountered &e)
+        {
+          pendingException = std::current_exception();
+        }
+      catch (std::exception &e)
+        {
+          pendingException =
+              std::make_exception_ptr(InstructionFetchFailure(PC));
+        }
+
+      if (pendingException)
+        {
+          /* ID, EX, MEM and WB */
+          drainCycles = 4;
+          break;
+        }
+
+      entry.PC = PC + 4;
+      entry.SEQUENCE = ++fetchSequence;
+      if (! redirectAfterDelaySlot)
+        entry.PREDICTION = branchPredictor.predict(PC, PC + 4);
+      group.push_back(entry);
+
+      PC += 4;
+      if (redirectAfterDelaySlot)
+        {
+          PC = predictedTarget;
+          redirectAfterDelaySlot = false;
+          break;
+        }
+      else if (entry.PREDICTION.taken)
+        {
+          redirectAfterDelaySlot = true;
+          predictedTarget = entry.PREDICTION.target;
+        }
+    }
+
+  fetchWait = latency - 1;
+}
+
+void
+DualFetchStage::clockPulse()
+{
+  auto &queue = regs.fetchQueue;
+
+  if (squash)
+    queue.erase(std::remove_if(queue.begin(), queue.end(),
+                               [this](const IF_IDRegisters &entry)
+                                 {
+                                   return entry.SEQUENCE > lastKept;
+                                 }),
+                queue.end());
+
+  if (squash)
+    regs.fetchStall = { CycleCategory::BranchMispredict, branchAddress };
+
+  if (fetchWait > 0)
+    {
+      --fetchWait;
+      ++nFetchStalls;
+      regs.fetchStall = { CycleCategory::ICacheMiss,
+                          group.empty() ? PC : group.front().PC - 4 };
+      return;
+    }
+
+  if (! group.empty() &&
+      queue.size() + group.size() <= DualIssueRegisters::FetchQueueSize)
+    {
+      queue.insert(queue.end(), group.begin(), group.end());
+      group.clear();
+      regs.fetchStall = StallCause{};
+    }
+  else if (pendingException && group.empty() && queue.empty() &&
+           drainCycles > 0)
+    {
+      --drainCycles;
+      regs.fetchStall = { CycleCategory::Drain, PC };
+    }
+}
+
+
+/*
+ * Instruction decode
+ */
+
+void
+DualDecodeStage::propagate()
+{
+  nIssue = 0;
+  stall = false;
+  failure = PairingFailure::NoInstruction;
+  bubbleCause = regs.fetchStall;
+
+  for (size_t slot = 0; slot < IssueWidth; ++slot)
+    {
+      if (slot >= regs.fetchQueue.size())
+        break;
+
+      /* Wrong-path instructions of the branch in EX or MEM */
+      if (isSquashed(regs.ex_m, regs.fetchQueue[slot].SEQUENCE))
+        {
+          bubbleCause = { CycleCategory::BranchMispredict,
+                          regs.ex_m[0].PC - 4 };
+          break;
+        }
+      if (! decode(slot))
+        {
+          bubbleCause = { CycleCategory::BranchMispredict,
+                          regs.id_ex[0].PC - 4 };
+          break;
+        }
+
+      if (isLoadUse(slot))
+        {
+          stall = slot == 0;
+          failure = PairingFailure::LoadUse;
+          bubbleCause = { CycleCategory::LoadUse, decoded[slot].PC - 4 };
+          break;
+        }
+
+      if (slot == 1)
+        {
+          const ID_EXRegisters &first = decoded[0];
+          const ID_EXRegisters &second = decoded[1];
+
+          if (second.BRANCH_KIND != BranchKind::None)
+            {
+              failure = PairingFailure::Branch;
+              break;
+            }
+          if (writesRegister(first.CONTROL_SIGNALS, first.RD, second.RA) ||
+              writesRegister(first.CONTROL_SIGNALS, first.RD, second.RB))
+            {
+              failure = PairingFailure::Dependency;
+              break;
+            }
+          if (accessesMemory(first.CONTROL_SIGNALS) &&
+              accessesMemory(second.CONTROL_SIGNALS))
+            {
+              failure = PairingFailure::MemoryPort;
+              break;
+            }
+        }
+
+      ++nIssue;
+    }
+}
+
+/* Returns false when the instruction cannot be decoded, but may still
+ * turn out to be on the wrong path of the branch in EX.
+ */
+bool
+DualDecodeStage::decode(size_t slot)
+{
+  const IF_IDRegisters &entry = regs.fetchQueue[slot];
+  InstructionDecoder &decoder = decoders[slot];
+  ID_EXRegisters &out = decoded[slot];
+
+  out = ID_EXRegisters{};
+  out.PC = entry.PC;
+  out.PREDICTION = entry.PREDICTION;
+  out.SEQUENCE = entry.SEQUENCE;
+
+  decoder.setInstructionWord(entry.INSTRUCTION_WORD);
+  try
+    {
+      out.CONTROL_SIGNALS.setOpcode(decoder.getOpcode());
+      out.CONTROL_SIGNALS.setFunctionCode(decoder.getFunctionCode());
+    }
+  catch (IllegalInstruction &e)
+    {
+      const ID_EXRegisters &branch = regs.id_ex[0];
+      if (slot == 0 && (branch.BRANCH_KIND == BranchKind::None ||
+                        entry.SEQUENCE <= branch.SEQUENCE + 1))
+        throw;
+      return false;
+    }
+
+  try {
+    out.RA = decoder.getA();
+  } catch (IllegalInstruction &e) {
+    out.RA = (RegNumber)MaxRegs;
+  }
+  try {
+    out.RB = decoder.getB();
+  } catch (IllegalInstruction &e) {
+    out.RB = (RegNumber)MaxRegs;
+  }
+  try {
+    out.RD = out.CONTROL_SIGNALS.setLinkRegister() ? 9 : decoder.getD();
+  } catch (IllegalInstruction &e) {
+    out.RD = (RegNumber)MaxRegs;
+  }
+  try {
+    out.IMMEDIATE = decoder.getImmediate();
+  } catch (IllegalInstruction &e) {
+    out.IMMEDIATE = 0;
+  }
+
+  out.BRANCH_KIND = getBranchKind(decoder.getFunctionCode(), out.RB);
+
+  if (slot == 0)
+    {
+      regfile.setRS1(out.RA);
+      regfile.setRS2(out.RB);
+      out.RS1 = readOperand(out.RA, regfile.getReadData1());
+      out.RS2 = readOperand(out.RB, regfile.getReadData2());
+    }
+  else
+    {
+      regfile.setRS3(out.RA);
+      regfile.setRS4(out.RB);
+      out.RS1 = readOperand(out.RA, regfile.getReadData3());
+      out.RS2 = readOperand(out.RB, regfile.getReadData4());
+    }
+
+  return true;
+}
+
+/* A load in EX delivers its value too late for an instruction in ID. */
+bool
+DualDecodeStage::isLoadUse(size_t slot) const
+{
+  const ID_EXRegisters &instr = decoded[slot];
+
+  for (const auto &ex : regs.id_ex)
+    if (ex.CONTROL_SIGNALS.isReadOpBool() &&
+        (writesRegister(ex.CONTROL_SIGNALS, ex.RD, instr.RA) ||
+         writesRegister(ex.CONTROL_SIGNALS, ex.RD, instr.RB)))
+      return true;
+
+  return false;
+}
+
+/* Bypasses the register file for registers written back in this very
+ * cycle; slot 1 is younger and wins.
+ */
+RegValue
+DualDecodeStage::readOperand(RegNumber reg, RegValue value) const
+{
+  for (const auto &wb : regs.m_wb)
+    if (writesRegister(wb.CONTROL_SIGNALS, wb.RD, reg))
+      value = HazardDetector::getResult(wb);
+
+  return value;
+}
+
+void
+DualDecodeStage::clockPulse()
+{
+  if (stall)
+    ++nStalls;
+
+  if (nIssue == IssueWidth)
+    ++statistics.nDualIssue;
+  else if (nIssue > 0)
+    {
+      ++statistics.nSingleIssue;
+      ++statistics.failures[static_cast<size_t>(failure)];
+    }
+
+  for (size_t slot = 0; slot < IssueWidth; ++slot)
+    {
+      if (slot >= nIssue)
+        {
+          regs.id_ex[slot] = ID_EXRegisters{};
+          regs.id_ex[slot].BUBBLE_CAUSE = bubbleCause;
+          continue;
+        }
+
+      regs.id_ex[slot] = decoded[slot];
+
+      if (debugMode)
+        {
+          MemAddress PC = decoded[slot].PC;
+          auto storeFlags(std::cerr.flags());
+
+          std::cerr << std::hex << std::showbase << PC << "\t";
+          std::cerr.setf(storeFlags);
+
+          std::string symbol = symbols.format(PC);
+          if (!symbol.empty())
+            std::cerr << "<" << symbol << ">\t";
+
+          std::cerr << decoders[slot] << std::endl;
+        }
+    }
+
+  regs.fetchQueue.erase(regs.fetchQueue.begin(),
+                        regs.fetchQueue.begin() + nIssue);
+  nInstrIssued += nIssue;
+}
+
+
+/*
+ * Execute
+ */
+
+void
+DualExecuteStage::propagate()
+{
+  BRANCH_KIND = BranchKind::None;
+
+  for (size_t slot = 0; slot < IssueWidth; ++slot)
+    {
+      results[slot] = EX_MRegisters{};
+
+      const ID_EXRegisters &in = regs.id_ex[slot];
+      if (in.PC == 0)
+        results[slot].BUBBLE_CAUSE = in.BUBBLE_CAUSE;
+      else if (isSquashed(regs.ex_m, in.SEQUENCE))
+        results[slot].BUBBLE_CAUSE = { CycleCategory::BranchMispredict,
+                                       regs.ex_m[0].PC - 4 };
+      else
+        execute(slot);
+    }
+}
+
+/* Results of older instructions in MEM and WB; the youngest producer
+ * of a register wins.
+ */
+RegValue
+DualExecuteStage::forward(RegNumber reg, RegValue value) const
+{
+  for (const auto &wb : regs.m_wb)
+    if (writesRegister(wb.CONTROL_SIGNALS, wb.RD, reg))
+      value = HazardDetector::getResult(wb);
+
+  for (const auto &m : regs.ex_m)
+    if (writesRegister(m.CONTROL_SIGNALS, m.RD, reg))
+      value = HazardDetector::getResult(m);
+
+  return value;
+}
+
+void
+DualExecuteStage::execute(size_t slot)
+{
+  const ID_EXRegisters &in = regs.id_ex[slot];
+  const ControlSignals &signals = in.CONTROL_SIGNALS;
+  EX_MRegisters &out = results[slot];
+  ALU &alu = alus[slot];
+
+  RegValue A = forward(in.RA, in.RS1);
+  RegValue B = forward(in.RB, in.RS2);
+
+  Mux<RegValue, InputSelectorEXStage> mux1;
+  mux1.setInput(InputSelectorEXStage::InputOne, in.PC);
+  mux1.setInput(InputSelectorEXStage::InputTwo, A);
+  mux1.setSelector(signals.AInput());
+
+  Mux<RegValue, InputSelectorEXStage> mux2;
+  mux2.setInput(InputSelectorEXStage::InputOne, B);
+  mux2.setInput(InputSelectorEXStage::InputTwo, in.IMMEDIATE);
+  mux2.setSelector(signals.BInput());
+
+  const ALUOp op = signals.AluOp();
+  alu.setA(mux1.getOutput());
+  alu.setB(mux2.getOutput());
+  alu.setOp(op);
+
+  /* A branch tests the flag as set by older instructions. */
+  const bool flag = FLAG;
+  RegValue result = alu.getResult();
+  if (setsFlag(op))
+    FLAG = alu.getFlag();
+
+  out.PC = in.PC;
+  out.CONTROL_SIGNALS = signals;
+  out.ALU_OUTPUT = result;
+  out.RS2 = B;
+  out.RD = in.RD;
+  out.SEQUENCE = in.SEQUENCE;
+
+  /* Branches only issue in slot 0, see ExecuteStage::propagateBranch. */
+  if (slot != 0)
+    return;
+
+  BRANCH_KIND = in.BRANCH_KIND;
+  BRANCH_TAKEN = signals.jump(flag);
+
+  RegValue actual = BRANCH_TAKEN ? result : in.PC + 4;
+  RegValue predicted = in.PREDICTION.taken ? in.PREDICTION.target
+                                           : in.PC + 4;
+  PREDICTION_CORRECT = actual == predicted;
+
+  out.BRANCH_PC = actual;
+  out.BRANCH_DECISION = PREDICTION_CORRECT ? InputSelectorIFStage::InputOne
+                                           : InputSelectorIFStage::InputTwo;
+}
+
+void
+DualExecuteStage::clockPulse()
+{
+  regs.ex_m = results;
+
+  for (const auto &result : results)
+    {
+      FunctionalUnit *unit =
+          units.select(result.CONTROL_SIGNALS.getExecutionUnit());
+      if (unit && unit->isMultiCycle() && result.PC != 0)
+        {
+          unit->issue(cycle);
+          unit->addStall(unit->getLatency() - 1);
+          waitCycles.add(unit->getLatency() - 1,
+                         CycleCategory::Structural, result.PC - 4);
+        }
+    }
+
+  if (BRANCH_KIND != BranchKind::None)
+    branchPredictor.resolve(results[0].PC - 4, BRANCH_KIND, BRANCH_TAKEN,
+                            results[0].ALU_OUTPUT, PREDICTION_CORRECT);
+}
+
+
+/*
+ * Memory
+ */
+
+void
+DualMemoryStage::propagate()
+{
+  accessed = false;
+  dataMemory.setReadEnable(false);
+  dataMemory.setWriteEnable(false);
+
+  for (size_t slot = 0; slot < IssueWidth; ++slot)
+    {
+      const EX_MRegisters &in = regs.ex_m[slot];
+      const ControlSignals &signals = in.CONTROL_SIGNALS;
+      M_WBRegisters &out = results[slot];
+
+      out = M_WBRegisters{};
+      out.PC = in.PC;
+      out.CONTROL_SIGNALS = signals;
+      out.ALU_RESULT = in.ALU_OUTPUT;
+      out.RD = in.RD;
+      out.BUBBLE_CAUSE = in.BUBBLE_CAUSE;
+
+      /* At most one slot accesses memory. */
+      if (! accessesMemory(signals))
+        continue;
+
+      accessed = true;
+      accessAddress = in.PC - 4;
+      dataMemory.setPC(in.PC);
+      dataMemory.setDataIn(in.RS2);
+      dataMemory.setAddress(in.ALU_OUTPUT);
+      dataMemory.setSize(signals.getDataSize());
+
+      if (signals.isReadOpBool())
+        {
+          dataMemory.setReadEnable(true);
+          out.DATA_READ_FROM_MEMORY =
+              dataMemory.getDataOut(signals.signExtendedRead());
+          dataMemory.setReadEnable(false);
+        }
+      dataMemory.setWriteEnable(signals.isWriteOpBool());
+    }
+}
+
+void
+DualMemoryStage::clockPulse()
+{
+  regs.m_wb = results;
+
+  dataMemory.clockPulse();
+
+  if (accessed)
+    {
+      const unsigned int portWait = dataMemory.getPortWait();
+      waitCycles.add(portWait, CycleCategory::Structural, accessAddress);
+      waitCycles.add(dataMemory.getLatency() - 1 - portWait,
+                     CycleCategory::DCacheMiss, accessAddress);
+    }
+}
+
+
+/*
+ * Write back
+ */
+
+void
+DualWriteBackStage::propagate()
+{
+  const M_WBRegisters &first = regs.m_wb[0];
+  const M_WBRegisters &second = regs.m_wb[1];
+
+  for (const auto &wb : regs.m_wb)
+    if (wb.PC != 0)
+      ++nInstrCompleted;
+
+  regfile.setWriteEnable(first.CONTROL_SIGNALS.regWriteInput());
+  regfile.setRD(first.RD);
+  regfile.setWriteData(HazardDetector::getResult(first));
+
+  regfile.setWriteEnable2(second.CONTROL_SIGNALS.regWriteInput());
+  regfile.setRD2(second.RD);
+  regfile.setWriteData2(HazardDetector::getResult(second));
+}
+
+void
+DualWriteBackStage::clockPulse()
+{
+  regfile.clockPulse();
+}
@@ -13,10 +13,12 @@
  */
 
 #include "elf-file.h"
+#include "flat-memory.h"
 #include "memory.h"
 
 #include "elf.h"
 
+#include <cstring>
 #include <stdexcept>
 #include <functional>
 
@@ -61,6 +63,13 @@ ELFFile::load(std::string_view filename)
     throw std::runtime_error("Could not open file.");
   }
 
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(fd, &fileSize)) {
+    CloseHandle(fd);
+    throw std::runtime_error("Could not retrieve file attributes.");
+  }
+  programSize = fileSize.QuadPart;
+
   mapping = CreateFileMappingA(fd, nullptr, 
     PAGE_READONLY, 0, 0, nullptr);
 
@@ -76,6 +85,9 @@ ELFFile::load(std::string_view filename)
     throw std::runtime_error("Failed to setup memory map.");
   }
 
+  image.reset(static_cast<const std::byte *>(mapAddr),
+              [](const std::byte *p) { UnmapViewOfFile(p); });
+
 #else
   fd = open(filename.data(), O_RDONLY);
   if (fd < 0)
@@ -102,6 +114,13 @@ ELFFile::load(std::string_view filename)
       close(fd);
       throw std::runtime_error("Failed to setup memory map.");
     }
+
+  /* Memories created from the file may outlive this object. */
+  image.reset(static_cast<const std::byte *>(mapAddr),
+              [size = programSize](const std::byte *p)
+                {
+                  munmap(const_cast<std::byte *>(p), size);
+                });
 #endif
 
   /* For now, we hardcode the OpenRISC target */
@@ -111,6 +130,18 @@ ELFFile::load(std::string_view filename)
       throw std::invalid_argument("File is not an OpenRISC ELF file.");
     }
 
+  try
+    {
+      checkSections();
+      loadSymbols();
+      loadSegments();
+    }
+  catch (...)
+    {
+      unload();
+      throw;
+    }
+
   isBad = false;
 }
 
@@ -118,17 +149,18 @@ void
 ELFFile::unload()
 {
 #ifdef _MSC_VER
-  UnmapViewOfFile(mapAddr);
   CloseHandle(mapping);
   CloseHandle(fd);
 
   mapping = nullptr;
 #else
-  munmap(mapAddr, programSize);
   close(fd);
 #endif
 
   mapAddr = nullptr;
+  image.reset();
+  symbols.clear();
+  segments.clear();
 
   /* Select correct default on all platforms */
   fd = decltype(fd){};
@@ -139,6 +171,9 @@ ELFFile::isELF() const
 {
   const auto *elf = static_cast<const Elf64_Ehdr *>(mapAddr);
 
+  if (programSize < sizeof(Elf32_Ehdr))
+    return false;
+
   if (!(elf->e_ident[EI_MAG0] == 0x7f
         && elf->e_ident[EI_MAG1] == 'E'
         && elf->e_ident[EI_MAG2] == 'L'
@@ -176,13 +211,49 @@ ELFFile::isTarget(const uint8_t elf_class,
 }
 
 
+/* The section header table and the contents of the sections must lie
+ * within the file, so that the sections can be read without further
+ * checks.
+ */
+void
+ELFFile::checkSections() const
+{
+  const auto *elf = static_cast<Elf32_Ehdr *>(mapAddr);
+  const Elf32_Off e_shoff = __builtin_bswap32(elf->e_shoff);
+  const uint16_t e_shnum = __builtin_bswap16(elf->e_shnum);
+
+  if (e_shnum == 0)
+    return;
+
+  if (__builtin_bswap16(elf->e_shentsize) != sizeof(Elf32_Shdr) ||
+      uint64_t{ e_shoff } + uint64_t{ e_shnum } * sizeof(Elf32_Shdr) >
+      programSize)
+    throw std::runtime_error("Section headers extend past the end of "
+                             "the file.");
+
+  const auto *base = reinterpret_cast<const std::byte *>(elf);
+  const auto *sheaders = reinterpret_cast<const Elf32_Shdr *>(base + e_shoff);
+
+  for (int i = 0; i < e_shnum; ++i)
+    {
+      const Elf32_Shdr &header = sheaders[i];
+      if (__builtin_bswap32(header.sh_type) == SHT_NOBITS)
+        continue;
+
+      if (uint64_t{ __builtin_bswap32(header.sh_offset) } +
+          __builtin_bswap32(header.sh_size) > programSize)
+        throw std::runtime_error("Section extends past the end of the "
+                                 "file.");
+    }
+}
+
 /* We don't want to expose the elf.h types in the elf-file.h header,
  * so we keep this function internal and outside of the class definition.
  */
-using ForeachSegmentFunction = std::function<void(const Elf32_Ehdr *elf, const Elf32_Shdr &header)>;
+using ForeachSectionFunction = std::function<void(const Elf32_Ehdr *elf, const Elf32_Shdr &header)>;
 
 static void
-foreachSegment(void *mapAddr, ForeachSegmentFunction func)
+foreachSection(void *mapAddr, ForeachSectionFunction func)
 {
   const auto *elf = static_cast<Elf32_Ehdr *>(mapAddr);
 
@@ -198,57 +269,217 @@ foreachSegment(void *mapAddr, ForeachSegmentFunction func)
 }
 
 
-std::vector<std::unique_ptr<MemoryInterface>>
-ELFFile::createMemories() const
+#ifdef _MSC_VER
+static std::byte *
+allocateSegment(size_t size, size_t align)
 {
-  std::vector<std::unique_ptr<MemoryInterface>> memories;
+  auto *segment =
+      new (std::align_val_t{ align }, std::nothrow) std::byte[size];
+  if (!segment)
+    throw std::runtime_error("Could not allocate aligned memory.");
+
+  if (reinterpret_cast<uintptr_t>(segment) & ((align - 1) != 0))
+    throw std::runtime_error("Allocated pointer for segment is not aligned.");
+
+  return segment;
+}
+#endif
+
+/* Returns the words of text in host byte order. */
+static std::shared_ptr<const uint32_t[]>
+swapWords(const std::byte *text, size_t size)
+{
+  const size_t count = size / 4;
+  std::shared_ptr<uint32_t[]> words(new uint32_t[count]);
 
-  foreachSegment(mapAddr, [&memories](const Elf32_Ehdr *elf, const Elf32_Shdr &header) -> void
+  for (size_t i = 0; i < count; ++i)
     {
-      Elf32_Word sh_flags = __builtin_bswap32(header.sh_flags);
-      Elf32_Word sh_size = __builtin_bswap32(header.sh_size);
-      Elf32_Word sh_type = __builtin_bswap32(header.sh_type);
-      Elf32_Off sh_offset = __builtin_bswap32(header.sh_offset);
-      Elf32_Addr sh_addr = __builtin_bswap32(header.sh_addr);
+      uint32_t word;
+      std::memcpy(&word, text + i * 4, sizeof(word));
+      words[i] = __builtin_bswap32(word);
+    }
+
+  return words;
+}
 
-      size_t align = __builtin_bswap32(header.sh_addralign);
+/* Load the PT_LOAD program headers. The linker already placed the
+ * sections with the same permissions together in these, so .data and
+ * .bss, for instance, end up in a single memory.
+ */
+void
+ELFFile::loadSegments()
+{
+  segments.clear();
 
-      auto *segment =
-          new (std::align_val_t{ align }, std::nothrow) std::byte[sh_size];
-      if (!segment)
-        throw std::runtime_error("Could not allocate aligned memory.");
+  const auto *elf = static_cast<Elf32_Ehdr *>(mapAddr);
+  const Elf32_Off e_phoff = __builtin_bswap32(elf->e_phoff);
+  const uint16_t e_phnum = __builtin_bswap16(elf->e_phnum);
 
-      if (reinterpret_cast<uintptr_t>(segment) & ((align - 1) != 0))
-        throw std::runtime_error("Allocated pointer for segment is not aligned.");
+  if (uint64_t{ e_phoff } + uint64_t{ e_phnum } * sizeof(Elf32_Phdr) >
+      programSize)
+    throw std::runtime_error("Program headers extend past the end of "
+                             "the file.");
 
-      /* Transfer section data or clear the section. */
-      if (sh_type == SHT_PROGBITS)
-        {
-          const auto *segdata =
-              reinterpret_cast<const std::byte *>(elf) + sh_offset;
-          std::copy_n(segdata, sh_size, segment);
-        }
-      else
-        std::fill_n(segment, sh_size, std::byte{ 0 });
+  const auto *pheaders = reinterpret_cast<const Elf32_Phdr *>(image.get() + e_phoff);
+
+  for (int i = 0; i < e_phnum; ++i)
+    {
+      const Elf32_Phdr &header = pheaders[i];
+      if (__builtin_bswap32(header.p_type) != PT_LOAD)
+        continue;
+
+      Elf32_Off p_offset = __builtin_bswap32(header.p_offset);
+      Elf32_Addr p_vaddr = __builtin_bswap32(header.p_vaddr);
+      Elf32_Word p_filesz = __builtin_bswap32(header.p_filesz);
+      Elf32_Word p_memsz = __builtin_bswap32(header.p_memsz);
+      Elf32_Word p_flags = __builtin_bswap32(header.p_flags);
+
+      size_t align = __builtin_bswap32(header.p_align);
+
+      if (p_filesz > p_memsz)
+        throw std::runtime_error("Segment is larger in the file than "
+                                 "in memory.");
+      if (uint64_t{ p_offset } + p_filesz > programSize)
+        throw std::runtime_error("Segment extends past the end of the "
+                                 "file.");
+
+      /* Point into the file; the bytes past p_filesz are cleared. */
+      std::shared_ptr<const std::byte> data{};
+      if (p_filesz > 0)
+        data = std::shared_ptr<const std::byte>(image,
+                                                image.get() + p_offset);
 
-      /* FIXME: determine correct name for segment. */
       std::string name{ "data" };
-      if ((sh_flags & SHF_EXECINSTR) == SHF_EXECINSTR)
+      if ((p_flags & PF_X) == PF_X)
         name = "text";
 
-      auto memory = std::make_unique<Memory>(name, segment,
-                                             sh_addr,
-                                             sh_size,
-                                             align);
-      if ((sh_flags & SHF_WRITE) == SHF_WRITE)
-        memory->setMayWrite(true);
+      /* Text that cannot change is fetched from a host-order copy */
+      std::shared_ptr<const uint32_t[]> words{};
+      if ((p_flags & (PF_X | PF_W)) == PF_X && p_filesz == p_memsz &&
+          p_vaddr % 4 == 0)
+        words = swapWords(data.get(), p_filesz);
 
-      memories.push_back(std::move(memory));
+      segments.push_back(Segment{ name, p_vaddr, p_memsz, p_filesz, align,
+                                  (p_flags & PF_W) == PF_W,
+                                  p_offset, std::move(data),
+                                  std::move(words) });
+    }
+}
+
+/* Returns a private, writable copy of a segment. */
+std::shared_ptr<std::byte>
+ELFFile::mapPrivate(const Segment &segment) const
+{
+#ifdef _MSC_VER
+  const size_t align = std::max<size_t>(segment.align, 1);
+  auto *copy = allocateSegment(segment.size, align);
+  std::copy_n(segment.data.get(), segment.fileSize, copy);
+  std::fill_n(copy + segment.fileSize, segment.size - segment.fileSize,
+              std::byte{ 0 });
+
+  return std::shared_ptr<std::byte>(copy, [align](std::byte *p)
+    {
+      operator delete[](p, std::align_val_t{ align }, std::nothrow);
     });
+#else
+  /* Anonymous zero pages, with the bytes from the file mapped
+   * copy-on-write over the front; nothing is copied before it is
+   * written.
+   */
+  const size_t pageSize = sysconf(_SC_PAGESIZE);
+  const size_t skew = segment.data ? segment.offset % pageSize : 0;
+  const size_t length = std::max<size_t>(skew + segment.size, 1);
+
+  void *pages = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (pages == MAP_FAILED)
+    throw std::runtime_error("Could not map segment " + segment.name + ".");
+
+  auto *start = static_cast<std::byte *>(pages);
+  if (segment.data)
+    {
+      const size_t fileLength = skew + segment.fileSize;
+      if (mmap(start, fileLength, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_FIXED, fd,
+               segment.offset - skew) == MAP_FAILED)
+        {
+          munmap(start, length);
+          throw std::runtime_error("Could not map segment " +
+                                   segment.name + ".");
+        }
+
+      /* The file also fills the rest of its last page. */
+      const size_t pageEnd = (fileLength + pageSize - 1) / pageSize * pageSize;
+      std::fill(start + fileLength, start + std::min(pageEnd, length),
+                std::byte{ 0 });
+    }
+
+  return std::shared_ptr<std::byte>(start + skew, [start, length](std::byte *)
+    {
+      munmap(start, length);
+    });
+#endif
+}
+
+std::vector<std::unique_ptr<MemoryInterface>>
+ELFFile::createMemories() const
+{
+  std::vector<std::unique_ptr<MemoryInterface>> memories;
+
+  for (const Segment &segment : segments)
+    {
+      if (! segment.writable && segment.data &&
+          segment.fileSize == segment.size)
+        {
+          auto memory = std::make_unique<Memory>(segment.name,
+                                                 segment.data,
+                                                 segment.base,
+                                                 segment.size);
+          if (segment.words)
+            memory->setHostWords(segment.words);
+          memories.push_back(std::move(memory));
+          continue;
+        }
+
+      auto memory = std::make_unique<Memory>(segment.name,
+                                             mapPrivate(segment),
+                                             segment.base,
+                                             segment.size);
+      memory->setMayWrite(segment.writable);
+      memories.push_back(std::move(memory));
+    }
 
   return memories;
 }
 
+#ifndef _MSC_VER
+std::unique_ptr<FlatMemory>
+ELFFile::createFlatMemory() const
+{
+  auto memory = std::make_unique<FlatMemory>();
+
+  for (const Segment &segment : segments)
+    {
+      if (! segment.data ||
+          ! memory->mapFile(segment.base, segment.fileSize, fd,
+                            segment.offset, segment.writable))
+        memory->map(segment.base, segment.fileSize, segment.data.get(),
+                    segment.writable);
+
+      memory->map(segment.base + segment.fileSize,
+                  segment.size - segment.fileSize, nullptr,
+                  segment.writable);
+    }
+
+  /* After all segments, as a page may be shared with writable data */
+  for (const Segment &segment : segments)
+    if (segment.words)
+      memory->setHostWords(segment.base, segment.size, segment.words);
+
+  return memory;
+}
+#endif
+
 bool
 ELFFile::getTextSegment(std::vector<std::byte> &segmentData,
                         MemAddress &segmentBase,
@@ -257,14 +488,15 @@ ELFFile::getTextSegment(std::vector<std::byte> &segmentData,
   bool found = false;
   segmentData.clear();
 
-  foreachSegment(mapAddr, [&segmentData, &segmentBase, &segmentSize, &found](const Elf32_Ehdr *elf, const Elf32_Shdr &header) -> void
+  foreachSection(mapAddr, [&segmentData, &segmentBase, &segmentSize, &found](const Elf32_Ehdr *elf, const Elf32_Shdr &header) -> void
     {
       Elf32_Word sh_flags = __builtin_bswap32(header.sh_flags);
       Elf32_Word sh_size = __builtin_bswap32(header.sh_size);
       Elf32_Off sh_offset = __builtin_bswap32(header.sh_offset);
       Elf32_Addr sh_addr = __builtin_bswap32(header.sh_addr);
 
-      if ((sh_flags & SHF_EXECINSTR) != SHF_EXECINSTR)
+      if ((sh_flags & SHF_EXECINSTR) != SHF_EXECINSTR ||
+          __builtin_bswap32(header.sh_type) == SHT_NOBITS)
         return;
 
        segmentData.resize(sh_size);
@@ -287,3 +519,67 @@ ELFFile::getEntrypoint() const
 {
   return __builtin_bswap32(static_cast<Elf64_Ehdr *>(mapAddr)->e_entry);
 }
+
+const SymbolTable &
+ELFFile::getSymbolTable() const
+{
+  return symbols;
+}
+
+/* Index function, object and label symbols of the .symtab section(s).
+ * Section and file symbols are of no use for symbolizing addresses and
+ * are skipped, as are undefined and absolute symbols.
+ */
+void
+ELFFile::loadSymbols()
+{
+  symbols.clear();
+
+  const auto *elf = static_cast<Elf32_Ehdr *>(mapAddr);
+  const auto *base = reinterpret_cast<const std::byte *>(elf);
+  const auto *sheaders = reinterpret_cast<const Elf32_Shdr *>(base + __builtin_bswap32(elf->e_shoff));
+  const int shnum = __builtin_bswap16(elf->e_shnum);
+
+  for (int i = 0; i < shnum; ++i)
+    {
+      const Elf32_Shdr &header = sheaders[i];
+      if (__builtin_bswap32(header.sh_type) != SHT_SYMTAB)
+        continue;
+
+      Elf32_Word sh_link = __builtin_bswap32(header.sh_link);
+      if (sh_link >= static_cast<Elf32_Word>(shnum) ||
+          __builtin_bswap32(sheaders[sh_link].sh_type) != SHT_STRTAB)
+        continue;
+
+      const auto *strtab = reinterpret_cast<const char *>(base + __builtin_bswap32(sheaders[sh_link].sh_offset));
+      const Elf32_Word strtabSize = __builtin_bswap32(sheaders[sh_link].sh_size);
+
+      const auto *syms = reinterpret_cast<const Elf32_Sym *>(base + __builtin_bswap32(header.sh_offset));
+      const size_t nSyms = __builtin_bswap32(header.sh_size) / sizeof(Elf32_Sym);
+
+      for (size_t j = 0; j < nSyms; ++j)
+        {
+          const Elf32_Sym &sym = syms[j];
+          const uint8_t type = sym.st_info & 0xf;
+          const Elf32_Half shndx = __builtin_bswap16(sym.st_shndx);
+          const Elf32_Word nameIndex = __builtin_bswap32(sym.st_name);
+
+          if (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE)
+            continue;
+          if (shndx == SHN_UNDEF || shndx == SHN_ABS)
+            continue;
+          if (nameIndex == 0 || nameIndex >= strtabSize)
+            continue;
+
+          /* The name ends within the string table */
+          const char *name = strtab + nameIndex;
+          symbols.addSymbol(__builtin_bswap32(sym.st_value),
+                            __builtin_bswap32(sym.st_size),
+                            std::string_view{ name,
+                                              strnlen(name, strtabSize -
+                                                      nameIndex) });
+        }
+    }
+
+  symbols.finalize();
+}
@@ -0,0 +1,362 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    flat-memory.cc - Guest memory in a reserved host address range.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ *
+ * This file is compiled with -fnon-call-exceptions, so that the
+ * IllegalAccess thrown by the SIGSEGV handler unwinds through the
+ * faulting load or store.
+ */
+
+#ifndef _MSC_VER
+#include "flat-memory.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* The guest address space and a guard behind it, at least a host page */
+static constexpr uint64_t GuestSpaceSize = uint64_t{ 1 } << 32;
+static constexpr uint64_t GuardSize = 64 * 1024;
+
+/* Reservations of all FlatMemory objects, so that the SIGSEGV handler
+ * can tell a guest access from a bug in the simulator. The handler may
+ * not lock, hence a fixed table of atomic slots.
+ */
+static std::array<std::atomic<std::byte *>, 256> reservations{};
+static struct sigaction previousAction{};
+
+static void
+segvHandler(int signal, siginfo_t *info, void *context)
+{
+  auto *fault = static_cast<std::byte *>(info->si_addr);
+
+  for (auto &slot : reservations)
+    {
+      std::byte *base = slot.load(std::memory_order_acquire);
+      if (base && base <= fault && fault < base + GuestSpaceSize + GuardSize)
+        throw IllegalAccess(static_cast<MemAddress>(fault - base));
+    }
+
+  /* Not ours: let the previous handler crash the program. */
+  sigaction(SIGSEGV, &previousAction, nullptr);
+}
+
+static void
+installHandler()
+{
+  static std::once_flag installed;
+
+  std::call_once(installed, []()
+    {
+      struct sigaction action{};
+      action.sa_sigaction = segvHandler;
+      /* The handler does not return, so SIGSEGV must not stay blocked */
+      action.sa_flags = SA_SIGINFO | SA_NODEFER;
+      sigemptyset(&action.sa_mask);
+
+      if (sigaction(SIGSEGV, &action, &previousAction) < 0)
+        throw std::runtime_error("Could not install SIGSEGV handler.");
+    });
+}
+
+
+FlatMemory::FlatMemory()
+  : pageSize(sysconf(_SC_PAGESIZE))
+{
+  installHandler();
+
+  void *reservation = mmap(nullptr, GuestSpaceSize + GuardSize, PROT_NONE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                           -1, 0);
+  if (reservation == MAP_FAILED)
+    throw std::runtime_error("Could not reserve the guest address space.");
+  base = static_cast<std::byte *>(reservation);
+
+  auto slot = std::find_if(reservations.begin(), reservations.end(),
+                           [this](std::atomic<std::byte *> &slot)
+                             {
+                               std::byte *empty = nullptr;
+                               return slot.compare_exchange_strong(empty,
+                                                                   base);
+                             });
+  if (slot == reservations.end())
+    {
+      munmap(base, GuestSpaceSize + GuardSize);
+      throw std::runtime_error("Too many guest address spaces.");
+    }
+
+  writablePages.resize(GuestSpaceSize / pageSize);
+}
+
+FlatMemory::~FlatMemory()
+{
+  for (auto &slot : reservations)
+    {
+      std::byte *expected = base;
+      if (slot.compare_exchange_strong(expected, nullptr))
+        break;
+    }
+
+  munmap(base, GuestSpaceSize + GuardSize);
+}
+
+void
+FlatMemory::map(MemAddress addr, size_t size, const std::byte *data,
+                bool writable)
+{
+  if (size == 0)
+    return;
+  if (addr + uint64_t{ size } > GuestSpaceSize)
+    throw std::runtime_error("Section does not fit the guest address space.");
+
+  const uint64_t first = addr / pageSize;
+  const uint64_t last = (addr + size - 1) / pageSize;
+
+  /* Make the pages writable to fill them; only the sections on a page
+   * that is already writable may keep it that way.
+   */
+  if (mprotect(base + first * pageSize, (last - first + 1) * pageSize,
+               PROT_READ | PROT_WRITE) < 0)
+    throw std::runtime_error("Could not map section.");
+
+  /* Pages of the reservation read as zero until they are touched, so
+   * only the pages shared with a section mapped before are cleared.
+   */
+  if (data)
+    std::memcpy(base + addr, data, size);
+  else
+    for (uint64_t page : { first, last })
+      if (isMapped(page))
+        {
+          const uint64_t begin = std::max<uint64_t>(addr, page * pageSize);
+          const uint64_t end = std::min<uint64_t>(addr + uint64_t{ size },
+                                                  (page + 1) * pageSize);
+          std::memset(base + begin, 0, end - begin);
+        }
+
+  for (uint64_t page = first; page <= last; ++page)
+    {
+      writablePages[page] = writablePages[page] || writable;
+      if (! writablePages[page])
+        mprotect(base + page * pageSize, pageSize, PROT_READ);
+    }
+
+  sections.push_back(AddressRange{ addr, addr + uint64_t{ size } });
+}
+
+bool
+FlatMemory::mapFile(MemAddress addr, size_t size, int fd, uint64_t offset,
+                    bool writable)
+{
+  if (size == 0 || addr % pageSize != offset % pageSize)
+    return false;
+  if (addr + uint64_t{ size } > GuestSpaceSize)
+    throw std::runtime_error("Section does not fit the guest address space.");
+
+  const uint64_t first = addr / pageSize;
+  const uint64_t last = (addr + size - 1) / pageSize;
+
+  /* The file replaces whole pages. Sections mapped afterwards copy
+   * themselves over the file pages they share.
+   */
+  for (const AddressRange &section : sections)
+    if (section.begin / pageSize <= last &&
+        (section.end - 1) / pageSize >= first)
+      return false;
+
+  void *pages = mmap(base + first * pageSize, (last - first + 1) * pageSize,
+                     writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                     MAP_PRIVATE | MAP_FIXED, fd,
+                     offset - (addr - first * pageSize));
+  if (pages == MAP_FAILED)
+    throw std::runtime_error("Could not map section.");
+
+  for (uint64_t page = first; page <= last; ++page)
+    writablePages[page] = writable;
+
+  sections.push_back(AddressRange{ addr, addr + uint64_t{ size } });
+  return true;
+}
+
+void
+FlatMemory::setHostWords(MemAddress addr, size_t size,
+                         std::shared_ptr<const uint32_t[]> words)
+{
+  if (size == 0 || addr % 4 != 0)
+    return;
+
+  for (uint64_t page = addr / pageSize; page <= (addr + size - 1) / pageSize;
+       ++page)
+    if (writablePages[page])
+      return;
+
+  hostWords.push_back(HostWords{ { addr, addr + uint64_t{ size } },
+                                 std::move(words) });
+}
+
+bool
+FlatMemory::isMapped(uint64_t page) const
+{
+  return std::any_of(sections.begin(), sections.end(),
+                     [this, page](const AddressRange &section)
+                       {
+                         return section.begin / pageSize <= page &&
+                             (section.end - 1) / pageSize >= page;
+                       });
+}
+
+/*
+ * MemoryInterface
+ */
+
+template <typename T>
+T
+FlatMemory::readData(MemAddress addr)
+{
+  T value;
+  std::memcpy(&value, base + addr, sizeof(T));
+  return value;
+}
+
+template <typename T>
+void
+FlatMemory::writeData(MemAddress addr, T value)
+{
+  std::memcpy(base + addr, &value, sizeof(T));
+}
+
+uint8_t
+FlatMemory::readByte(MemAddress addr)
+{
+  return readData<uint8_t>(addr);
+}
+
+uint16_t
+FlatMemory::readHalfWord(MemAddress addr)
+{
+  return __builtin_bswap16(readData<uint16_t>(addr));
+}
+
+uint32_t
+FlatMemory::readWord(MemAddress addr)
+{
+  return __builtin_bswap32(readData<uint32_t>(addr));
+}
+
+uint64_t
+FlatMemory::readDoubleWord(MemAddress addr)
+{
+  return __builtin_bswap64(readData<uint64_t>(addr));
+}
+
+void
+FlatMemory::writeByte(MemAddress addr, uint8_t value)
+{
+  writeData(addr, value);
+}
+
+void
+FlatMemory::writeHalfWord(MemAddress addr, uint16_t value)
+{
+  writeData(addr, __builtin_bswap16(value));
+}
+
+void
+FlatMemory::writeWord(MemAddress addr, uint32_t value)
+{
+  writeData(addr, __builtin_bswap32(value));
+}
+
+void
+FlatMemory::writeDoubleWord(MemAddress addr, uint64_t value)
+{
+  writeData(addr, __builtin_bswap64(value));
+}
+
+/* Block accesses check the pages up front rather than fault within
+ * memcpy().
+ */
+void
+FlatMemory::readBlock(MemAddress addr, std::byte *data, size_t size)
+{
+  if (size == 0)
+    return;
+  if (addr + uint64_t{ size } > GuestSpaceSize)
+    throw IllegalAccess(addr, size);
+
+  for (uint64_t page = addr / pageSize; page <= (addr + size - 1) / pageSize;
+       ++page)
+    if (! isMapped(page))
+      throw IllegalAccess(addr, size);
+
+  std::memcpy(data, base + addr, size);
+}
+
+void
+FlatMemory::writeBlock(MemAddress addr, const std::byte *data, size_t size)
+{
+  if (size == 0)
+    return;
+  if (addr + uint64_t{ size } > GuestSpaceSize)
+    throw IllegalAccess(addr, size);
+
+  for (uint64_t page = addr / pageSize; page <= (addr + size - 1) / pageSize;
+       ++page)
+    if (! writablePages[page])
+      throw IllegalAccess(addr, size);
+
+  std::memcpy(base + addr, data, size);
+}
+
+bool
+FlatMemory::contains(MemAddress addr) const
+{
+  return std::any_of(sections.begin(), sections.end(),
+                     [addr](const AddressRange &section)
+                       {
+                         return section.begin <= addr && addr < section.end;
+                       });
+}
+
+std::vector<AddressRange>
+FlatMemory::getRanges() const
+{
+  return sections;
+}
+
+HostPage
+FlatMemory::getHostPage(MemAddress addr)
+{
+  if (! contains(addr))
+    return {};
+
+  /* The page of the host, whose protection decides whether it is
+   * writable. The bus limits the page to the section.
+   */
+  const MemAddress begin = addr - addr % pageSize;
+  HostPage page{ base + begin, begin, uint64_t{ begin } + pageSize,
+                 writablePages[addr / pageSize] };
+
+  for (const HostWords &text : hostWords)
+    if (text.range.begin <= addr && addr < text.range.end)
+      {
+        page.begin = std::max(begin, text.range.begin);
+        page.end = std::min(page.end, text.range.end);
+        page.data = base + page.begin;
+        page.words = &text.words[(page.begin - text.range.begin) / 4];
+      }
+
+  return page;
+}
+
+#endif /* _MSC_VER */
@@ -51,7 +51,9 @@
 #include <SDL_events.h>
 
 /* PRIu64 on MSVC */
+#include <algorithm>
 #include <cinttypes>
+#include <cstring>
 
 enum FBmode
 {
@@ -209,9 +211,10 @@ void RenderContext::redrawScreen()
  */
 
 Framebuffer::Framebuffer(const MemAddress control_base,
-                         const MemAddress framebuffer_base)
+                         const MemAddress framebuffer_base,
+                         const uint64_t update_freq)
   : control_base{ control_base }, framebuffer_base{ framebuffer_base },
-    context{}
+    update_freq{ update_freq }, context{}
 {
   if (SDL_Init(SDL_INIT_VIDEO) < 0)
     {
@@ -353,6 +356,18 @@ Framebuffer::contains(MemAddress addr) const
   return getZone(addr, 0, NULL) != FBzone::INVALID;
 }
 
+/* The size of the framebuffer memory depends on the resolution the
+ * program selects, so the bus asks contains() beyond the control
+ * interface and palette.
+ */
+std::vector<AddressRange>
+Framebuffer::getRanges() const
+{
+  return { { control_base,
+             control_base + sizeof(ControlInterface) + sizeof(palette) },
+           { framebuffer_base, uint64_t{ 1 } << 32, false } };
+}
+
 uint8_t
 Framebuffer::readByte(MemAddress addr)
 {
@@ -494,6 +509,32 @@ Framebuffer::writeDoubleWord(MemAddress addr, uint64_t value)
   context->changed = true;
 }
 
+bool
+Framebuffer::inBuffer(MemAddress addr, size_t size) const
+{
+  return active_window && addr >= framebuffer_base &&
+      uint64_t{ addr } + size <= uint64_t{ framebuffer_base } + context->memsize;
+}
+
+void
+Framebuffer::readBlock(MemAddress addr, std::byte *data, size_t size)
+{
+  if (! inBuffer(addr, size))
+    return MemoryInterface::readBlock(addr, data, size);
+
+  std::memcpy(data, &context->mem[addr - framebuffer_base], size);
+}
+
+void
+Framebuffer::writeBlock(MemAddress addr, const std::byte *data, size_t size)
+{
+  if (! inBuffer(addr, size))
+    return MemoryInterface::writeBlock(addr, data, size);
+
+  std::memcpy(&context->mem[addr - framebuffer_base], data, size);
+  context->changed = true;
+}
+
 void
 Framebuffer::clockPulse()
 {
@@ -505,4 +546,22 @@ Framebuffer::clockPulse()
   ++cycles_since_update;
 }
 
+void
+Framebuffer::clockPulses(uint64_t count)
+{
+  while (count > 0)
+    {
+      if (cycles_since_update > update_freq)
+        {
+          processEvents(true);
+          cycles_since_update = 0;
+        }
+
+      /* Pulses until the next update */
+      uint64_t step = std::min(count, update_freq + 1 - cycles_since_update);
+      cycles_since_update += step;
+      count -= step;
+    }
+}
+
 #endif
@@ -0,0 +1,146 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    functional-unit.cc - Multi-cycle functional units.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "functional-unit.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+FunctionalUnit::FunctionalUnit(const std::string &name,
+                               const FunctionalUnitConfig &config)
+  : name{ name }, config{ config }
+{
+  if (config.latency == 0)
+    throw std::out_of_range(name + ": latency must be at least 1");
+}
+
+uint64_t
+FunctionalUnit::issue(uint64_t cycle)
+{
+  const unsigned int occupancy = config.pipelined ? 1 : config.latency;
+
+  nextIssue = cycle + occupancy;
+  ++nOperations;
+  nBusyCycles += occupancy;
+  return cycle + config.latency;
+}
+
+void
+FunctionalUnit::dumpStatistics(std::ostream &os, uint64_t nCycles) const
+{
+  if (nOperations == 0)
+    return;
+
+  auto storeFlags(os.flags());
+  os << name << ": " << nOperations << " operations, "
+     << std::fixed << std::setprecision(2)
+     << (nCycles > 0 ? 100.0 * nBusyCycles / nCycles : 0.0)
+     << "% utilization, " << nStallCycles << " structural stall cycles."
+     << std::endl;
+  os.flags(storeFlags);
+}
+
+
+FunctionalUnits::FunctionalUnits(const FunctionalUnitConfig &multiplier,
+                                 const FunctionalUnitConfig &divider)
+  : multiplier{ "Multiplier", multiplier },
+    divider{ "Divider", divider }
+{
+}
+
+FunctionalUnit *
+FunctionalUnits::select(ExecutionUnit unit)
+{
+  switch (unit)
+    {
+      case ExecutionUnit::Multiplier:
+        return &multiplier;
+      case ExecutionUnit::Divider:
+        return &divider;
+      default:
+        return nullptr;
+    }
+}
+
+void
+FunctionalUnits::reserve(uint64_t sequence, const FunctionalUnit &unit,
+                         RegNumber rd)
+{
+  Result result{};
+  result.sequence = sequence;
+  result.rd = rd;
+  result.latency = unit.getLatency();
+  results.push_back(result);
+}
+
+void
+FunctionalUnits::complete(uint64_t sequence, RegValue value, uint64_t cycle)
+{
+  for (auto &result : results)
+    if (result.sequence == sequence)
+      {
+        result.executed = true;
+        result.executeCycle = cycle;
+        result.cycle = cycle + result.latency + 1;
+        result.value = value;
+      }
+}
+
+bool
+FunctionalUnits::isPending(RegNumber reg) const
+{
+  return reg != 0 &&
+      std::any_of(results.begin(), results.end(),
+                  [reg](const Result &result) { return result.rd == reg; });
+}
+
+const FunctionalUnits::Result *
+FunctionalUnits::getCompleted(uint64_t cycle) const
+{
+  for (const auto &result : results)
+    if (result.executed && result.cycle <= cycle)
+      return &result;
+
+  return nullptr;
+}
+
+void
+FunctionalUnits::retire(uint64_t sequence)
+{
+  results.erase(std::remove_if(results.begin(), results.end(),
+                               [sequence](const Result &result)
+                                 {
+                                   return result.sequence == sequence;
+                                 }),
+                results.end());
+}
+
+uint64_t
+FunctionalUnits::drain(uint64_t lastCycle)
+{
+  results.erase(std::remove_if(results.begin(), results.end(),
+                               [lastCycle](const Result &result)
+                                 {
+                                   return ! result.executed ||
+                                       result.executeCycle >= lastCycle;
+                                 }),
+                results.end());
+
+  uint64_t last = lastCycle;
+  for (const auto &result : results)
+    last = std::max(last, result.cycle);
+
+  return last - lastCycle;
+}
+
+void
+FunctionalUnits::dumpStatistics(std::ostream &os, uint64_t nCycles) const
+{
+  multiplier.dumpStatistics(os, nCycles);
+  divider.dumpStatistics(os, nCycles);
+}
@@ -0,0 +1,552 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    machine-config.cc - Microarchitecture parameters.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "machine-config.h"
+#include "config-file.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+static size_t
+parseSize(std::string_view name, std::string_view value)
+{
+  try
+    {
+      size_t pos = 0;
+      std::string str{ value };
+      size_t result = std::stoull(str, &pos, 0);
+      if (pos == str.length())
+        return result;
+    }
+  catch (std::exception &)
+    {
+    }
+
+  throw std::out_of_range("Invalid value '" + std::string{ value } +
+                          "' for " + std::string{ name });
+}
+
+/* A MemAddress is 32 bits wide */
+static MemAddress
+parseAddress(std::string_view name, std::string_view value)
+{
+  size_t address = parseSize(name, value);
+  if (address > std::numeric_limits<MemAddress>::max())
+    throw std::out_of_range(std::string{ name } +
+                            " must be an address below 4 GiB");
+  return address;
+}
+
+static unsigned int
+parseBits(std::string_view name, std::string_view value)
+{
+  size_t bits = parseSize(name, value);
+  if (bits < 1 || bits > 24)
+    throw std::out_of_range(std::string{ name } +
+                            " must be between 1 and 24");
+  return bits;
+}
+
+static bool
+isPowerOfTwo(size_t value)
+{
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+static bool
+parseBool(std::string_view name, std::string_view value)
+{
+  if (value == "1" || value == "true" || value == "yes")
+    return true;
+  else if (value == "0" || value == "false" || value == "no")
+    return false;
+
+  throw std::out_of_range("Invalid value '" + std::string{ value } +
+                          "' for " + std::string{ name });
+}
+
+static unsigned int
+parseLatency(std::string_view name, std::string_view value)
+{
+  size_t latency = parseSize(name, value);
+  if (latency < 1)
+    throw std::out_of_range(std::string{ name } + " must be at least 1");
+  return latency;
+}
+
+/* A stage that can be split in two */
+static unsigned int
+parseStageCount(std::string_view name, std::string_view value)
+{
+  size_t stages = parseSize(name, value);
+  if (stages != 1 && stages != 2)
+    throw std::out_of_range(std::string{ name } + " must be 1 or 2");
+  return stages;
+}
+
+/* Deeper variants of the 5-stage pipeline, split from the front: 6
+ * splits IF, 7 also MEM, 8 adds a register read stage. Where branches
+ * are resolved is kept.
+ */
+static PipelineDepthConfig
+parsePipelineDepth(std::string_view name, std::string_view value,
+                   PipelineDepthConfig config)
+{
+  size_t depth = parseSize(name, value);
+  if (depth < 5 || depth > 8)
+    throw std::out_of_range(std::string{ name } +
+                            " must be between 5 and 8");
+
+  config.fetchStages = depth >= 6 ? 2 : 1;
+  config.memoryStages = depth >= 7 ? 2 : 1;
+  config.registerRead = depth >= 8;
+  return config;
+}
+
+static bool
+parseBusPorts(std::string_view value)
+{
+  if (value == "split")
+    return false;
+  else if (value == "unified")
+    return true;
+
+  throw std::out_of_range("Unknown bus port organization '" +
+                          std::string{ value } + "'");
+}
+
+static BusPort
+parseBusPort(std::string_view value)
+{
+  if (value == "fetch")
+    return BusPort::Fetch;
+  else if (value == "data")
+    return BusPort::Data;
+
+  throw std::out_of_range("Unknown bus port '" + std::string{ value } + "'");
+}
+
+/* Stage resolving l.bf, l.bnf, l.j and l.jal; true for ID */
+static bool
+parseBranchStage(std::string_view value)
+{
+  if (value == "ex")
+    return false;
+  else if (value == "id")
+    return true;
+
+  throw std::out_of_range("Unknown branch resolution stage '" +
+                          std::string{ value } + "'");
+}
+
+static BranchPredictorType
+parseBranchPredictorType(std::string_view value)
+{
+  if (value == "not-taken")
+    return BranchPredictorType::NotTaken;
+  else if (value == "backward-taken")
+    return BranchPredictorType::BackwardTaken;
+  else if (value == "bimodal")
+    return BranchPredictorType::Bimodal;
+  else if (value == "gshare")
+    return BranchPredictorType::GShare;
+  else if (value == "tournament")
+    return BranchPredictorType::Tournament;
+
+  throw std::out_of_range("Unknown branch predictor '" +
+                          std::string{ value } + "'");
+}
+
+static ReplacementPolicy
+parseReplacementPolicy(std::string_view value)
+{
+  if (value == "lru")
+    return ReplacementPolicy::LRU;
+  else if (value == "plru")
+    return ReplacementPolicy::PLRU;
+  else if (value == "random")
+    return ReplacementPolicy::Random;
+
+  throw std::out_of_range("Unknown replacement policy '" +
+                          std::string{ value } + "'");
+}
+
+static bool
+parseWritePolicy(std::string_view value)
+{
+  if (value == "write-back")
+    return true;
+  else if (value == "write-through")
+    return false;
+
+  throw std::out_of_range("Unknown write policy '" +
+                          std::string{ value } + "'");
+}
+
+static PrefetcherType
+parsePrefetcherType(std::string_view value)
+{
+  if (value == "none")
+    return PrefetcherType::None;
+  else if (value == "next-line")
+    return PrefetcherType::NextLine;
+  else if (value == "stride")
+    return PrefetcherType::Stride;
+  else if (value == "stream")
+    return PrefetcherType::Stream;
+  else if (value == "delta")
+    return PrefetcherType::DeltaCorrelating;
+
+  throw std::out_of_range("Unknown prefetcher '" +
+                          std::string{ value } + "'");
+}
+
+/* Prefetcher attached to an L1 cache, e.g. "l1d.prefetcher". */
+static bool
+setPrefetcherParameter(PrefetcherConfig &prefetcher, std::string_view name,
+                       std::string_view value)
+{
+  std::string_view parameter = name.substr(name.find('.') + 1);
+
+  if (parameter == "prefetcher")
+    prefetcher.type = parsePrefetcherType(value);
+  else if (parameter == "prefetch_degree")
+    prefetcher.degree = parseSize(name, value);
+  else if (parameter == "prefetch_table")
+    prefetcher.tableSize = parseSize(name, value);
+  else
+    return false;
+
+  return true;
+}
+
+/* Parameters shared by all caches, e.g. "l1d.size". */
+static bool
+setCacheParameter(CacheConfig &cache, std::string_view name,
+                  std::string_view value)
+{
+  std::string_view parameter = name.substr(name.find('.') + 1);
+
+  if (parameter == "size")
+    cache.size = parseSize(name, value);
+  else if (parameter == "line_size")
+    cache.lineSize = parseSize(name, value);
+  else if (parameter == "assoc")
+    cache.associativity = parseSize(name, value);
+  else if (parameter == "replacement")
+    cache.replacement = parseReplacementPolicy(value);
+  else if (parameter == "write_policy")
+    cache.writeBack = parseWritePolicy(value);
+  else if (parameter == "write_allocate")
+    cache.writeAllocate = parseBool(name, value);
+  else if (parameter == "hit_latency")
+    cache.hitLatency = parseLatency(name, value);
+  else if (parameter == "miss_penalty")
+    cache.missPenalty = parseSize(name, value);
+  else
+    return false;
+
+  return true;
+}
+
+
+void
+MachineConfig::set(std::string_view name, std::string_view value)
+{
+  std::string_view section = name.substr(0, name.find('.'));
+
+  if (section == "l1i" &&
+      (setCacheParameter(instructionCache, name, value) ||
+       setPrefetcherParameter(instructionPrefetcher, name, value)))
+    return;
+  if (section == "l1d" &&
+      (setCacheParameter(dataCache, name, value) ||
+       setPrefetcherParameter(dataPrefetcher, name, value)))
+    return;
+  if (section == "l2" && setCacheParameter(l2Cache, name, value))
+    return;
+
+  if (name == "pipeline.enabled")
+    pipelining = parseBool(name, value);
+  else if (name == "pipeline.issue_width")
+    {
+      issueWidth = parseSize(name, value);
+      if (issueWidth != 1 && issueWidth != 2)
+        throw std::out_of_range("pipeline.issue_width must be 1 or 2");
+    }
+  else if (name == "pipeline.depth")
+    depth = parsePipelineDepth(name, value, depth);
+  else if (name == "pipeline.fetch_stages")
+    depth.fetchStages = parseStageCount(name, value);
+  else if (name == "pipeline.register_read")
+    depth.registerRead = parseBool(name, value);
+  else if (name == "pipeline.memory_stages")
+    depth.memoryStages = parseStageCount(name, value);
+  else if (name == "pipeline.branch_stage")
+    depth.earlyBranches = parseBranchStage(value);
+  else if (name == "ooo.enabled")
+    outOfOrder.enabled = parseBool(name, value);
+  else if (name == "ooo.width")
+    outOfOrder.width = parseSize(name, value);
+  else if (name == "ooo.rob_size")
+    outOfOrder.robSize = parseSize(name, value);
+  else if (name == "ooo.iq_size")
+    outOfOrder.issueQueueSize = parseSize(name, value);
+  else if (name == "ooo.lsq_size")
+    outOfOrder.loadStoreQueueSize = parseSize(name, value);
+  else if (name == "ooo.phys_regs")
+    outOfOrder.physicalRegisters = parseSize(name, value);
+  else if (name == "mul.latency")
+    multiplier.latency = parseLatency(name, value);
+  else if (name == "mul.pipelined")
+    multiplier.pipelined = parseBool(name, value);
+  else if (name == "div.latency")
+    divider.latency = parseLatency(name, value);
+  else if (name == "div.pipelined")
+    divider.pipelined = parseBool(name, value);
+  else if (name == "bpred.type")
+    branchPredictor.type = parseBranchPredictorType(value);
+  else if (name == "bpred.table_bits")
+    branchPredictor.tableBits = parseBits(name, value);
+  else if (name == "bpred.history_bits")
+    branchPredictor.historyBits = parseBits(name, value);
+  else if (name == "bpred.btb_entries")
+    branchPredictor.btbEntries = parseSize(name, value);
+  else if (name == "bpred.ras_depth")
+    branchPredictor.rasDepth = parseSize(name, value);
+  else if (name == "sb.entries")
+    storeBuffer.entries = parseSize(name, value);
+  else if (name == "sb.combine_cycles")
+    storeBuffer.combineCycles = parseSize(name, value);
+  else if (name == "dram.enabled")
+    dram.enabled = parseBool(name, value);
+  else if (name == "dram.banks")
+    dram.banks = parseSize(name, value);
+  else if (name == "dram.row_size")
+    dram.rowSize = parseSize(name, value);
+  else if (name == "dram.tcas")
+    dram.tCAS = parseSize(name, value);
+  else if (name == "dram.trcd")
+    dram.tRCD = parseSize(name, value);
+  else if (name == "dram.trp")
+    dram.tRP = parseSize(name, value);
+  else if (name == "dram.burst")
+    dram.tBurst = parseSize(name, value);
+  else if (name == "sim.skip_stalls")
+    skipStalls = parseBool(name, value);
+  else if (name == "bus.clock_divider")
+    {
+      busClockDivider = parseSize(name, value);
+      if (busClockDivider == 0)
+        throw std::out_of_range("bus.clock_divider must be at least 1");
+    }
+  else if (name == "bus.ports")
+    busArbitration.unified = parseBusPorts(value);
+  else if (name == "bus.priority")
+    busArbitration.priority = parseBusPort(value);
+  else if (name == "bus.turnaround")
+    busArbitration.turnaround = parseSize(name, value);
+  else if (name == "memory.flat")
+    {
+      flatMemory = parseBool(name, value);
+#ifdef _MSC_VER
+      if (flatMemory)
+        throw std::out_of_range("memory.flat is not supported on Windows");
+#endif
+    }
+  else if (name == "memory.heap")
+    ram.heapSize = parseSize(name, value);
+  else if (name == "memory.heap_base")
+    ram.heapBase = parseAddress(name, value);
+  else if (name == "memory.scratch")
+    ram.scratchSize = parseSize(name, value);
+  else if (name == "memory.scratch_base")
+    ram.scratchBase = parseAddress(name, value);
+  else if (name == "memory.stack")
+    ram.stackSize = parseSize(name, value);
+  else if (name == "memory.stack_top")
+    {
+      /* The stack may end at the very top of the address space */
+      uint64_t top = parseSize(name, value);
+      if (top > uint64_t{ 1 } << 32)
+        throw std::out_of_range("memory.stack_top must be at most "
+                                "0x100000000");
+      ram.stackTop = top;
+    }
+  else if (name == "platform.serial")
+    platform.serialBase = parseAddress(name, value);
+  else if (name == "platform.sys_status")
+    platform.sysStatusBase = parseAddress(name, value);
+  else if (name == "platform.fb_control")
+    platform.framebufferControl = parseAddress(name, value);
+  else if (name == "platform.framebuffer")
+    platform.framebufferBase = parseAddress(name, value);
+  else if (name == "platform.fb_update")
+    platform.framebufferUpdate = parseLatency(name, value);
+  else
+    throw std::invalid_argument("Unknown machine parameter '" +
+                                std::string{ name } + "'");
+}
+
+void
+MachineConfig::set(std::string_view assignment)
+{
+  size_t pos = assignment.find('=');
+  if (pos == std::string_view::npos)
+    throw std::invalid_argument("Expected name=value, got '" +
+                                std::string{ assignment } + "'");
+
+  set(assignment.substr(0, pos), assignment.substr(pos + 1));
+}
+
+void
+MachineConfig::load(std::string_view filename)
+{
+  ConfigFile file(filename);
+
+  for (const auto &section : file.getSections())
+    for (const auto &[key, value] : file.getProperties(section))
+      {
+        /* The global section has a name that cannot be a prefix */
+        const std::string name = section == file.getSections().front()
+            ? key : section + "." + key;
+
+        try
+          {
+            set(name, value);
+          }
+        catch (std::invalid_argument &e)
+          {
+            throw std::invalid_argument(std::string{ filename } + ": " +
+                                        e.what());
+          }
+        catch (std::out_of_range &e)
+          {
+            throw std::out_of_range(std::string{ filename } + ": " +
+                                    e.what());
+          }
+      }
+}
+
+/* The checks of the Cache and PrefetchUnit constructors, naming the
+ * parameters instead of the cache, and the limits the stages rely on.
+ */
+static void
+validateCache(const std::string &name, const CacheConfig &cache,
+              const PrefetcherConfig *prefetcher = nullptr)
+{
+  if (cache.size == 0)
+    return;
+
+  if (!isPowerOfTwo(cache.size) || !isPowerOfTwo(cache.lineSize) ||
+      !isPowerOfTwo(cache.associativity))
+    throw std::out_of_range(name + ".size, " + name + ".line_size and " +
+                            name + ".assoc must be powers of 2");
+  if (cache.lineSize * cache.associativity > cache.size)
+    throw std::out_of_range(name + ".size must hold at least one set");
+  if (cache.associativity > 64)
+    throw std::out_of_range(name + ".assoc must be at most 64");
+  /* A line holds the largest access, a double word */
+  if (cache.lineSize < 8)
+    throw std::out_of_range(name + ".line_size must be at least 8");
+  if (cache.hitLatency < 1)
+    throw std::out_of_range(name + ".hit_latency must be at least 1");
+
+  if (!prefetcher || prefetcher->type == PrefetcherType::None)
+    return;
+  if (prefetcher->type != PrefetcherType::NextLine &&
+      prefetcher->tableSize == 0)
+    throw std::out_of_range(name + ".prefetch_table must be at least 1");
+}
+
+void
+MachineConfig::validate() const
+{
+  validateCache("l1i", instructionCache, &instructionPrefetcher);
+  validateCache("l1d", dataCache, &dataPrefetcher);
+  validateCache("l2", l2Cache);
+
+  if (!isPowerOfTwo(branchPredictor.btbEntries))
+    throw std::out_of_range("bpred.btb_entries must be a power of 2");
+
+  if (dram.enabled &&
+      (!isPowerOfTwo(dram.banks) || !isPowerOfTwo(dram.rowSize)))
+    throw std::out_of_range("dram.banks and dram.row_size must be "
+                            "powers of 2");
+
+  if (outOfOrder.enabled)
+    {
+      if (outOfOrder.width == 0)
+        throw std::out_of_range("ooo.width must be at least 1");
+      if (outOfOrder.robSize == 0 || outOfOrder.issueQueueSize == 0 ||
+          outOfOrder.loadStoreQueueSize == 0)
+        throw std::out_of_range("ooo queue sizes must be at least 1");
+      if (outOfOrder.physicalRegisters <= OutOfOrderCore::NumLogicalRegs)
+        throw std::out_of_range("ooo.phys_regs must be larger than " +
+                                std::to_string(OutOfOrderCore::NumLogicalRegs));
+    }
+
+  /* Byte ranges claimed by the devices and RAM. The framebuffer memory
+   * itself is only claimed once the program opens a window.
+   */
+  struct Range
+  {
+    std::string name;
+    uint64_t base;
+    uint64_t size;
+  };
+  std::vector<Range> devices{ { "platform.serial", platform.serialBase, 1 },
+                              { "platform.sys_status",
+                                platform.sysStatusBase, 0x10 } };
+#ifdef ENABLE_FRAMEBUFFER
+  devices.push_back({ "platform.fb_control", platform.framebufferControl,
+                      4 * 4 + 256 * 4 });
+#endif
+
+  if (ram.stackSize > ram.stackTop)
+    throw std::out_of_range("memory.stack does not fit below "
+                            "memory.stack_top");
+  for (const auto &region : ram.getRegions())
+    {
+      if (region.base + uint64_t{ region.size } > uint64_t{ 1 } << 32)
+        throw std::out_of_range("memory." + region.name + " does not fit "
+                                "the address space");
+      devices.push_back({ "memory." + region.name, region.base,
+                          region.size });
+    }
+
+  for (size_t i = 0; i < devices.size(); ++i)
+    for (size_t j = i + 1; j < devices.size(); ++j)
+      if (devices[i].base < devices[j].base + devices[j].size &&
+          devices[j].base < devices[i].base + devices[i].size)
+        throw std::out_of_range(devices[i].name + " overlaps " +
+                                devices[j].name);
+
+  if (pipelining && (depth.getDepth() != 5 || depth.earlyBranches) &&
+      (outOfOrder.enabled || issueWidth == 2))
+    throw std::out_of_range("pipeline depth and branch resolution can only "
+                            "be changed for the single-issue in-order "
+                            "pipeline");
+}
+
+std::vector<RamConfig::Region>
+RamConfig::getRegions() const
+{
+  std::vector<Region> regions;
+
+  if (heapSize > 0)
+    regions.push_back({ "heap", heapBase, heapSize });
+  if (scratchSize > 0)
+    regions.push_back({ "scratch", scratchBase, scratchSize });
+  if (stackSize > 0 && stackSize <= stackTop)
+    regions.push_back({ "stack",
+                        static_cast<MemAddress>(stackTop - stackSize),
+                        stackSize });
+
+  return regions;
+}
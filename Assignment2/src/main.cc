@@ -20,6 +20,7 @@
 
 #include "elf-file.h"
 #include "processor.h"
+#include "sweep.h"
 
 #ifdef _MSC_VER
 /* Defined *somewhere* */
@@ -68,7 +69,7 @@ validateRegisters(const Processor &p,
 static int
 launcher(const char *testFilename,
          const char *execFilename,
-         bool pipelining,
+         const MachineConfig &config,
          bool debugMode,
          std::vector<RegisterInit> initializers)
 {
@@ -107,7 +108,7 @@ launcher(const char *testFilename,
 
       /* Read the ELF file and start the emulator */
       ELFFile program(programFilename);
-      Processor p(program, pipelining, debugMode);
+      Processor p(program, config, debugMode);
 
       for (auto &initializer : initializers)
         p.initRegister(initializer.number, initializer.value);
@@ -140,6 +141,47 @@ launcher(const char *testFilename,
   return ExitCodes::Success;
 }
 
+/* Simulates the program for every configuration in the sweep file. */
+static int
+sweepLauncher(const char *sweepFilename,
+              const char *execFilename,
+              const MachineConfig &config,
+              unsigned int jobs,
+              const std::vector<RegisterInit> &initializers)
+{
+  std::vector<SweepPoint> points;
+
+  try
+    {
+      points = Sweep::readFile(sweepFilename, config);
+    }
+  catch (std::exception &e)
+    {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return ExitCodes::InvalidArgument;
+    }
+
+  try
+    {
+      ELFFile program(execFilename);
+      Sweep sweep(program, std::move(points), initializers);
+
+      bool completed = sweep.run(jobs);
+      sweep.dumpResults(std::cout);
+
+      if (! completed)
+        return ExitCodes::AbnormalTermination;
+    }
+  catch (std::runtime_error &e)
+    {
+      std::cerr << "Couldn't load program: " << e.what()
+                << std::endl;
+      return ExitCodes::InitializationError;
+    }
+
+  return ExitCodes::Success;
+}
+
 static void
 formatDisassembly(InstructionDecoder &decoder, MemAddress PC=0)
 {
@@ -171,10 +213,21 @@ disasmELFFile(const ELFFile &program)
   if (!program.getTextSegment(segment, segmentBase, segmentSize))
     return ExitCodes::InitializationError;
 
+  const SymbolTable &symbols = program.getSymbolTable();
+
   InstructionDecoder decoder;
   size_t i = 0;
   while (i < segmentSize)
     {
+      /* Label the start of every function, like objdump does. */
+      const Symbol *symbol = symbols.lookup(segmentBase + i);
+      if (symbol && symbol->address == segmentBase + i)
+        {
+          if (i > 0)
+            std::cout << std::endl;
+          std::cout << "<" << symbol->name << ">:" << std::endl;
+        }
+
       const RegValue *instr = reinterpret_cast<const RegValue*>(&segment[i]);
       decoder.setInstructionWord(__builtin_bswap32(*instr));
       formatDisassembly(decoder, segmentBase + i);
@@ -273,9 +326,11 @@ static void
 showHelp(const char *progName)
 {
   std::cerr << "Usage:" << std::endl;
-  std::cerr << progName << " [-d] [-p] [-r REGINIT] <programFilename>" << std::endl;
+  std::cerr << progName << " [-d] [-p] [-c MACHINE] [-o PARAM] [-r REGINIT] <programFilename>" << std::endl;
   std::cerr << "    or" << std::endl;
-  std::cerr << progName << " [-d] [-p] -t <testFilename>" << std::endl;
+  std::cerr << progName << " [-d] [-p] [-c MACHINE] [-o PARAM] -t <testFilename>" << std::endl;
+  std::cerr << "    or" << std::endl;
+  std::cerr << progName << " [-p] [-c MACHINE] [-o PARAM] [-r REGINIT] [-j JOBS] -s <sweepFilename> <programFilename>" << std::endl;
   std::cerr << "    or" << std::endl;
   std::cerr << progName << " -x <instruction>" << std::endl;
   std::cerr << "    or" << std::endl;
@@ -286,10 +341,19 @@ R"HERE(
         to the terminal.
     -p, enables pipelining. When omitted, the emulator runs in non-pipelined
         mode.
+    -c, reads machine parameters from the machine description file
+        MACHINE. Options are applied in order, so a later -o overrides.
+    -o, sets a machine parameter PARAM, in the form name=value, for
+        example bpred.type=gshare. See README.md for the parameters.
     -r, specifies a register initializer REGINIT, in the form
         rX=Y with X a register number and Y the initializer value.
     -t, enables unit test mode, with testFilename a unit test
         configuration file.
+    -s, runs the program once for every line of sweepFilename, which
+        lists PARAMs separated by spaces applied on top of -p and -o.
+        A table with the results of all runs is printed.
+    -j, runs at most JOBS simulations of a sweep at once. The default
+        is the number of cores.
     -x, disassembles (decodes) a single instruction specified as
         hexadecimal argument.
     -X, disassembles 'filename' which is either an ELF file (in which case
@@ -303,26 +367,68 @@ int
 main(int argc, char **argv)
 {
   char c;
-  bool pipelining = false;
+  MachineConfig config;
   bool debugMode = false;
   std::vector<RegisterInit> initializers;
   const char *testFilename = nullptr;
+  const char *sweepFilename = nullptr;
+  unsigned int jobs = 0;
   const char *disasmArg = nullptr;
   bool disasmAsFile = false;
 
   /* Command line option processing */
   const char *progName = argv[0];
 
-  while ((c = getopt(argc, argv, "dpr:t:x:X:h")) != -1)
+  while ((c = getopt(argc, argv, "c:dj:o:pr:s:t:x:X:h")) != -1)
     {
       switch (c)
         {
+          case 'c':
+            try
+              {
+                config.load(optarg);
+              }
+            catch (std::exception &e)
+              {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return ExitCodes::InvalidArgument;
+              }
+            break;
+
           case 'd':
             debugMode = true;
             break;
 
+          case 'j':
+            try
+              {
+                size_t pos = 0;
+                jobs = std::stoul(optarg, &pos);
+                if (optarg[pos] != '\0' || jobs == 0)
+                  throw std::out_of_range(optarg);
+              }
+            catch (std::exception &)
+              {
+                std::cerr << "Error: Invalid number of jobs " << optarg
+                          << std::endl;
+                return ExitCodes::InvalidArgument;
+              }
+            break;
+
+          case 'o':
+            try
+              {
+                config.set(std::string_view(optarg));
+              }
+            catch (std::exception &e)
+              {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return ExitCodes::InvalidArgument;
+              }
+            break;
+
           case 'p':
-            pipelining = true;
+            config.pipelining = true;
             break;
 
           case 'r':
@@ -346,6 +452,10 @@ main(int argc, char **argv)
               }
             break;
 
+          case 's':
+            sweepFilename = optarg;
+            break;
+
           case 't':
             if (testFilename != nullptr)
               {
@@ -400,6 +510,34 @@ main(int argc, char **argv)
       return disasmSingle(disasmArg);
     }
 
+  try
+    {
+      config.validate();
+    }
+  catch (std::out_of_range &e)
+    {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return ExitCodes::InvalidArgument;
+    }
+
+  if (sweepFilename != nullptr)
+    {
+      if (testFilename != nullptr or debugMode)
+        {
+          std::cerr << "Error: A sweep cannot be combined with -t or -d."
+                    << std::endl;
+          return ExitCodes::InvalidArgument;
+        }
+      if (argc < 1)
+        {
+          std::cerr << "Error: No executable specified." << std::endl;
+          return ExitCodes::InvalidArgument;
+        }
+
+      return sweepLauncher(sweepFilename, argv[0], config, jobs,
+                           initializers);
+    }
+
   if (!testFilename and argc < 1)
     {
       std::cerr << "Error: No executable specified." << std::endl << std::endl;
@@ -407,6 +545,6 @@ main(int argc, char **argv)
       return ExitCodes::InvalidArgument;
     }
 
-  return launcher(testFilename, argv[0], pipelining,
+  return launcher(testFilename, argv[0], config,
                   debugMode, initializers);
 }
@@ -7,9 +7,14 @@
 
 #include "memory-bus.h"
 
+#include <algorithm>
+#include <iomanip>
+
 MemoryBus::MemoryBus(std::vector<std::unique_ptr<MemoryInterface> > &&clients)
-  : clients{ std::move(clients) }
+  : clients{ std::move(clients) },
+    directory(size_t{ 1 } << (32 - PageBits - TableBits))
 {
+  rebuildMap();
 }
 
 MemoryBus::~MemoryBus() = default;
@@ -18,6 +23,7 @@ void
 MemoryBus::addClient(std::unique_ptr<MemoryInterface> client)
 {
   clients.emplace_back(std::move(client));
+  rebuildMap();
 }
 
 uint64_t
@@ -32,6 +38,97 @@ MemoryBus::getBytesWritten() const
   return bytesWritten;
 }
 
+void
+MemoryBus::setArbitration(const BusArbitrationConfig &config,
+                          const uint64_t &clock)
+{
+  arbitration = config;
+  this->clock = &clock;
+}
+
+unsigned int
+MemoryBus::acquirePort(BusPort port, unsigned int cycles)
+{
+  if (! arbitration.unified || ! clock || cycles == 0)
+    return 0;
+
+  const uint64_t now = *clock;
+
+  /* The instructions fetched together by a wide IF share a transfer. */
+  if (port == BusPort::Fetch && holder == port && grantCycle == now)
+    {
+      if (cycles > grantCycles)
+        {
+          busyUntil += cycles - grantCycles;
+          nBusyCycles += cycles - grantCycles;
+          grantCycles = cycles;
+        }
+      return grantStart - now;
+    }
+
+  /* Overtake a transfer of the other port that has not started yet.
+   * One that starts in this cycle already holds the port.
+   */
+  if (port == arbitration.priority && holder != port && grantStart > now &&
+      busyUntil > 0)
+    {
+      const unsigned int wait = grantStart - now;
+
+      busyUntil += cycles + arbitration.turnaround;
+      grantStart += cycles + arbitration.turnaround;
+      contentionCycles[static_cast<size_t>(port)] += wait;
+      nBusyCycles += cycles;
+      ++nConflicts;
+      return wait;
+    }
+
+  uint64_t free = busyUntil;
+  if (holder != port && busyUntil > 0)
+    free += arbitration.turnaround;
+
+  const uint64_t start = std::max(now, free);
+  if (start > now && holder != port)
+    ++nConflicts;
+
+  contentionCycles[static_cast<size_t>(port)] += start - now;
+  nBusyCycles += cycles;
+  busyUntil = start + cycles;
+  holder = port;
+  grantCycle = now;
+  grantStart = start;
+  grantCycles = cycles;
+
+  return start - now;
+}
+
+uint64_t
+MemoryBus::getContentionCycles(BusPort port) const
+{
+  return contentionCycles[static_cast<size_t>(port)];
+}
+
+void
+MemoryBus::dumpArbitrationStatistics(std::ostream &os) const
+{
+  if (! arbitration.unified || ! clock)
+    return;
+
+  auto storeFlags(os.flags());
+  /* Transfers may have been queued beyond the halt. */
+  const uint64_t busy = std::min(nBusyCycles, *clock);
+
+  os << "Unified bus port ("
+     << (arbitration.priority == BusPort::Data ? "data" : "fetch")
+     << " priority): " << nConflicts << " conflicts, "
+     << getContentionCycles(BusPort::Fetch) << " fetch and "
+     << getContentionCycles(BusPort::Data)
+     << " data cycles waiting for the port, busy " << std::fixed
+     << std::setprecision(2)
+     << (*clock > 0 ? 100.0 * busy / *clock : 0.0)
+     << "% of cycles." << std::endl;
+  os.flags(storeFlags);
+}
+
 
 uint8_t
 MemoryBus::readByte(MemAddress addr)
@@ -89,6 +186,34 @@ MemoryBus::writeDoubleWord(MemAddress addr, uint64_t value)
   return getClient(addr)->writeDoubleWord(addr, value);
 }
 
+void
+MemoryBus::readBlock(MemAddress addr, std::byte *data, size_t size)
+{
+  while (size > 0)
+    {
+      const size_t chunk = getBlockSize(addr, size);
+      getClient(addr)->readBlock(addr, data, chunk);
+      bytesRead += chunk;
+      addr += chunk;
+      data += chunk;
+      size -= chunk;
+    }
+}
+
+void
+MemoryBus::writeBlock(MemAddress addr, const std::byte *data, size_t size)
+{
+  while (size > 0)
+    {
+      const size_t chunk = getBlockSize(addr, size);
+      getClient(addr)->writeBlock(addr, data, chunk);
+      bytesWritten += chunk;
+      addr += chunk;
+      data += chunk;
+      size -= chunk;
+    }
+}
+
 bool
 MemoryBus::contains(MemAddress addr) const
 {
@@ -96,6 +221,38 @@ MemoryBus::contains(MemAddress addr) const
   return true;
 }
 
+bool
+MemoryBus::isCacheable(MemAddress addr) const
+{
+  auto *client = findClient(addr);
+  return client && client->isCacheable(addr);
+}
+
+HostPage
+MemoryBus::getHostPage(MemAddress addr)
+{
+  const Interval *interval = findInterval(addr);
+  if (! interval || ! interval->exact)
+    return {};
+
+  HostPage page = interval->client->getHostPage(addr);
+  if (! page.data)
+    return {};
+
+  /* Another client may own part of the page */
+  if (page.begin < interval->begin)
+    {
+      const MemAddress skip = interval->begin - page.begin;
+      page.data += skip;
+      page.words = skip % 4 == 0 && page.words ? page.words + skip / 4
+                                               : nullptr;
+      page.begin = interval->begin;
+    }
+  page.end = std::min(page.end, interval->end);
+
+  return page;
+}
+
 void
 MemoryBus::clockPulse()
 {
@@ -103,19 +260,169 @@ MemoryBus::clockPulse()
     client->clockPulse();
 }
 
+void
+MemoryBus::clockPulses(uint64_t count)
+{
+  for (auto &client : clients)
+    client->clockPulses(count);
+}
+
 /*
  * Private methods
  */
-MemoryInterface *
-MemoryBus::findClient(MemAddress addr) noexcept
+void
+MemoryBus::rebuildMap()
 {
+  intervals.clear();
+  unmapped.clear();
+
   for (auto &client : clients)
+    {
+      auto ranges = client->getRanges();
+      if (ranges.empty())
+        unmapped.push_back(client.get());
+
+      for (const auto &range : ranges)
+        {
+          /* Remove the parts claimed before */
+          std::vector<std::pair<uint64_t, uint64_t>> pieces{
+            { range.begin, range.end } };
+
+          for (const auto &interval : intervals)
+            {
+              std::vector<std::pair<uint64_t, uint64_t>> left;
+              for (const auto &[begin, end] : pieces)
+                {
+                  if (end <= interval.begin || interval.end <= begin)
+                    {
+                      left.emplace_back(begin, end);
+                      continue;
+                    }
+                  if (begin < interval.begin)
+                    left.emplace_back(begin, interval.begin);
+                  if (interval.end < end)
+                    left.emplace_back(interval.end, end);
+                }
+              pieces = std::move(left);
+            }
+
+          for (const auto &[begin, end] : pieces)
+            if (begin < end)
+              intervals.push_back(Interval{ static_cast<MemAddress>(begin),
+                                            end, client.get(),
+                                            range.exact });
+        }
+    }
+
+  std::sort(intervals.begin(), intervals.end(),
+            [](const Interval &a, const Interval &b)
+              {
+                return a.begin < b.begin;
+              });
+
+  for (auto &entry : directory)
+    entry = Directory{};
+
+  constexpr uint64_t PagesPerTable = uint64_t{ 1 } << TableBits;
+
+  for (uint32_t i = 0; i < intervals.size(); ++i)
+    {
+      const uint64_t first = intervals[i].begin >> PageBits;
+      const uint64_t last = (intervals[i].end - 1) >> PageBits;
+
+      for (uint64_t page = first; page <= last; )
+        {
+          Directory &entry = directory[page >> TableBits];
+          const uint64_t tableEnd = (page | (PagesPerTable - 1)) + 1;
+
+          /* Intervals are disjoint, so one covering all 4 MiB is alone. */
+          const bool whole = (page & (PagesPerTable - 1)) == 0 &&
+              (page << PageBits) >= intervals[i].begin &&
+              (tableEnd << PageBits) <= intervals[i].end;
+          if (whole)
+            {
+              entry.uniform = i;
+              page = tableEnd;
+              continue;
+            }
+
+          if (! entry.pages)
+            {
+              entry.pages = std::make_unique<PageTable>();
+              entry.pages->fill(NoInterval);
+            }
+
+          for (; page <= last && page < tableEnd; ++page)
+            {
+              uint32_t &slot = (*entry.pages)[page & (PagesPerTable - 1)];
+              slot = slot == NoInterval ? i : SharedPage;
+            }
+        }
+    }
+}
+
+/* The interval of addr, if a client claims it through its ranges. */
+const MemoryBus::Interval *
+MemoryBus::findInterval(MemAddress addr) const noexcept
+{
+  const Directory &entry = directory[addr >> (PageBits + TableBits)];
+  uint32_t index = entry.uniform;
+  if (entry.pages)
+    index = (*entry.pages)[(addr >> PageBits) & ((1 << TableBits) - 1)];
+
+  const Interval *interval = nullptr;
+  if (index < SharedPage)
+    interval = &intervals[index];
+  else if (index == SharedPage)
+    {
+      auto it = std::upper_bound(intervals.begin(), intervals.end(), addr,
+                                 [](MemAddress a, const Interval &i)
+                                   {
+                                     return a < i.begin;
+                                   });
+      if (it != intervals.begin())
+        interval = &*(it - 1);
+    }
+
+  if (interval && interval->begin <= addr && addr < interval->end &&
+      (interval->exact || interval->client->contains(addr)))
+    return interval;
+
+  return nullptr;
+}
+
+MemoryInterface *
+MemoryBus::findClient(MemAddress addr) const noexcept
+{
+  if (const Interval *interval = findInterval(addr))
+    return interval->client;
+
+  for (auto *client : unmapped)
     if (client->contains(addr))
-      return client.get();
+      return client;
 
   return nullptr;
 }
 
+/* The part of a block at addr that is handled by a single client */
+size_t
+MemoryBus::getBlockSize(MemAddress addr, size_t size) const noexcept
+{
+  if (const Interval *interval = findInterval(addr))
+    return std::min<uint64_t>(size, interval->end - addr);
+
+  /* Up to the next interval */
+  auto next = std::upper_bound(intervals.begin(), intervals.end(), addr,
+                               [](MemAddress a, const Interval &i)
+                                 {
+                                   return a < i.begin;
+                                 });
+  if (next == intervals.end())
+    return size;
+
+  return std::min<uint64_t>(size, next->begin - addr);
+}
+
 MemoryInterface *
 MemoryBus::getClient(MemAddress addr)
 {
@@ -3,12 +3,107 @@
  *    memory-control.cc - Memory Controller
  *
  * Copyright (C) 2016-2020  Leiden University, The Netherlands.
+ *
+ * This file is compiled with -fnon-call-exceptions, as accesses through
+ * the SoftwareTLB may raise IllegalAccess from a SIGSEGV handler.
  */
 
 #include "memory-control.h"
 
-InstructionMemory::InstructionMemory(MemoryBus &bus)
-  : bus(bus), size(0), addr(0)
+#include <algorithm>
+#include <cstring>
+
+#ifdef _MSC_VER
+#define __builtin_bswap64 _byteswap_uint64
+#define __builtin_bswap32 _byteswap_ulong
+#define __builtin_bswap16 _byteswap_ushort
+#endif
+
+SoftwareTLB::SoftwareTLB(MemoryBus &bus)
+  : bus{ bus }
+{
+}
+
+void
+SoftwareTLB::refill(Entry &entry, MemAddress addr)
+{
+  HostPage page = bus.getHostPage(addr);
+
+  entry.page = addr >> PageBits;
+  entry.data = page.data;
+  entry.begin = page.begin;
+  entry.end = page.data ? page.end : page.begin;
+  entry.writable = page.writable;
+  entry.words = page.words;
+}
+
+static uint8_t byteSwap(uint8_t value) { return value; }
+static uint16_t byteSwap(uint16_t value) { return __builtin_bswap16(value); }
+static uint32_t byteSwap(uint32_t value) { return __builtin_bswap32(value); }
+static uint64_t byteSwap(uint64_t value) { return __builtin_bswap64(value); }
+
+/* Reads plain memory directly, anything else through the bus. */
+template <typename T>
+static T
+readBigEndian(SoftwareTLB &tlb, MemoryBus &bus, MemAddress addr)
+{
+  if (const std::byte *host = tlb.translate(addr, sizeof(T), false))
+    {
+      T value;
+      std::memcpy(&value, host, sizeof(T));
+      bus.addBytesRead(sizeof(T));
+      return byteSwap(value);
+    }
+
+  if constexpr (sizeof(T) == 1)
+    return bus.readByte(addr);
+  else if constexpr (sizeof(T) == 2)
+    return bus.readHalfWord(addr);
+  else if constexpr (sizeof(T) == 4)
+    return bus.readWord(addr);
+  else
+    return bus.readDoubleWord(addr);
+}
+
+template <typename T>
+static void
+writeBigEndian(SoftwareTLB &tlb, MemoryBus &bus, MemAddress addr, T value)
+{
+  if (std::byte *host = tlb.translate(addr, sizeof(T), true))
+    {
+      value = byteSwap(value);
+      std::memcpy(host, &value, sizeof(T));
+      bus.addBytesWritten(sizeof(T));
+      return;
+    }
+
+  if constexpr (sizeof(T) == 1)
+    bus.writeByte(addr, value);
+  else if constexpr (sizeof(T) == 2)
+    bus.writeHalfWord(addr, value);
+  else if constexpr (sizeof(T) == 4)
+    bus.writeWord(addr, value);
+  else
+    bus.writeDoubleWord(addr, value);
+}
+
+/* Cycles an access of the given latency occupies the bus; a hit in the
+ * cache does not reach it.
+ */
+static unsigned int
+getBusCycles(const Cache *cache, bool cached, unsigned int latency)
+{
+  if (! cached)
+    return latency;
+
+  const unsigned int hitLatency = cache->getConfig().hitLatency;
+  return latency > hitLatency ? latency - hitLatency : 0;
+}
+
+InstructionMemory::InstructionMemory(MemoryBus &bus, Cache *cache,
+                                     PrefetchUnit *prefetcher)
+  : bus(bus), cache(cache), prefetcher(prefetcher), size(0), addr(0),
+    tlb(bus)
 {
 }
 
@@ -30,13 +125,31 @@ InstructionMemory::setAddress(const MemAddress addr)
 RegValue
 InstructionMemory::getValue() const
 {
+  const bool cached = cache && bus.isCacheable(addr);
+  if (cached)
+    latency = prefetcher ? prefetcher->access(addr, addr, false)
+                         : cache->access(addr, false);
+  else
+    latency = 1;
+
+  /* Stages wait getLatency() - 1 cycles; a hit takes at least one. */
+  latency = std::max(latency, 1u);
+  portWait = bus.acquirePort(BusPort::Fetch,
+                             getBusCycles(cache, cached, latency));
+  latency += portWait;
+
   switch (size)
     {
       case 2:
-        return bus.readHalfWord(addr);
+        return readBigEndian<uint16_t>(tlb, bus, addr);
 
       case 4:
-        return bus.readWord(addr);
+        if (const uint32_t *word = tlb.translateWord(addr))
+          {
+            bus.addBytesRead(sizeof(uint32_t));
+            return *word;
+          }
+        return readBigEndian<uint32_t>(tlb, bus, addr);
 
       default:
         throw IllegalAccess("InstructionMemory::GetValue::Invalid size " + std::to_string(size));
@@ -44,16 +157,23 @@ InstructionMemory::getValue() const
 }
 
 
-DataMemory::DataMemory(MemoryBus &bus)
-  : bus{ bus }
+DataMemory::DataMemory(MemoryBus &bus, Cache *cache,
+                       PrefetchUnit *prefetcher, StoreBuffer *storeBuffer)
+  : bus{ bus }, cache{ cache }, prefetcher{ prefetcher },
+    storeBuffer{ storeBuffer }, tlb{ bus }
+{
+}
+
+void
+DataMemory::setPC(const MemAddress pc)
 {
+  this->pc = pc;
 }
 
 void
 DataMemory::setSize(const uint8_t size)
 {
-  // check if not 2 0r 4 throw illefgal access excecption
-  if (size != 1 && size != 2 && size != 4)
+  if (size != 1 && size != 2 && size != 4 && size != 8)
     throw IllegalAccess("DataMemory::DataMemory::Invalid size " + std::to_string(size));
 
   this->size = size;
@@ -66,7 +186,7 @@ DataMemory::setAddress(const MemAddress addr)
 }
 
 void
-DataMemory::setDataIn(const RegValue value)
+DataMemory::setDataIn(const uint64_t value)
 {
   this->dataIn = value;
 }
@@ -86,31 +206,104 @@ DataMemory::setWriteEnable(bool setting)
 RegValue
 DataMemory::getDataOut(bool signExtend) const
 {
-  if (this->size == 1 && this->readEnable){
-    if (!signExtend) return this->bus.readByte(this->addr);
-    else return (uint32_t)(int32_t)this->bus.readByte(this->addr);
+  if (this->size == 8 && this->readEnable)
+    throw IllegalAccess("DataMemory::getDataOut::8-byte load does not fit "
+                        "a register");
+
+  return load(signExtend);
+}
+
+uint64_t
+DataMemory::getDoubleWordOut() const
+{
+  return load(false);
+}
+
+uint64_t
+DataMemory::load(bool signExtend) const
+{
+  if (! this->readEnable)
+    return 0;
+
+  uint64_t value = 0;
+
+  if (this->size == 1){
+    if (!signExtend) value = readBigEndian<uint8_t>(tlb, bus, addr);
+    else value = (uint32_t)(int32_t)readBigEndian<uint8_t>(tlb, bus, addr);
 
-  }  else if (this->size == 2 && this->readEnable){
-    if (!signExtend) return this->bus.readHalfWord(this->addr);
-    else return (uint32_t)(int32_t)this->bus.readHalfWord(this->addr);
+  }  else if (this->size == 2){
+    if (!signExtend) value = readBigEndian<uint16_t>(tlb, bus, addr);
+    else value = (uint32_t)(int32_t)readBigEndian<uint16_t>(tlb, bus, addr);
 
-  } else if (this->size == 4 && this->readEnable){
-    if (!signExtend) return this->bus.readWord(this->addr);
-    else return (uint32_t)(int32_t)this->bus.readWord(this->addr);
+  } else if (this->size == 4){
+    if (!signExtend) value = readBigEndian<uint32_t>(tlb, bus, addr);
+    else value = (uint32_t)(int32_t)readBigEndian<uint32_t>(tlb, bus, addr);
 
-  }
-  else return 0;
+  } else if (this->size == 8)
+    value = readBigEndian<uint64_t>(tlb, bus, addr);
+
+  /* Buffered stores are newer than memory. */
+  bool covered = false;
+  if (storeBuffer && bus.isCacheable(addr))
+    value = storeBuffer->forward(addr, size, value, covered);
+
+  if (covered)
+    {
+      latency = 1;
+      portWait = 0;
+    }
+  else
+    accessCache(false);
+
+  return value;
 }
 
 void 
 DataMemory::clockPulse() const {
 
+  if (this->writeEnable && storeBuffer)
+    {
+      if (bus.isCacheable(addr))
+        {
+          latency = storeBuffer->store(pc, addr, size, dataIn);
+          portWait = 0;
+          return;
+        }
+
+      /* Keep the order of stores to memory and to devices. */
+      uint64_t wait = storeBuffer->flush();
+      accessCache(true);
+      latency += wait;
+    }
+  else if (this->writeEnable)
+    accessCache(true);
+
   if (this->size == 1 && this->writeEnable)
-    this->bus.writeByte(this->addr, static_cast<uint8_t>(this->dataIn));
+    writeBigEndian(tlb, bus, addr, static_cast<uint8_t>(dataIn));
 
   else if (this->size == 2 && this->writeEnable)
-    this->bus.writeHalfWord(this->addr, static_cast<uint16_t>(this->dataIn));
+    writeBigEndian(tlb, bus, addr, static_cast<uint16_t>(dataIn));
   
   else if (this->size == 4 && this->writeEnable)
-    this->bus.writeWord(this->addr, this->dataIn);
+    writeBigEndian(tlb, bus, addr, static_cast<uint32_t>(dataIn));
+
+  else if (this->size == 8 && this->writeEnable)
+    writeBigEndian(tlb, bus, addr, dataIn);
+}
+
+void
+DataMemory::accessCache(bool write) const
+{
+  const bool cached = cache && bus.isCacheable(addr);
+  if (cached)
+    latency = prefetcher ? prefetcher->access(pc, addr, write)
+                         : cache->access(addr, write);
+  else
+    latency = 1;
+
+  /* Stages wait getLatency() - 1 cycles; a hit takes at least one. */
+  latency = std::max(latency, 1u);
+  portWait = bus.acquirePort(BusPort::Data,
+                             getBusCycles(cache, cached, latency));
+  latency += portWait;
 }
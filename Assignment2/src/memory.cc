@@ -7,7 +7,16 @@
 
 #include "memory.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 
 #ifdef _MSC_VER
 #define __builtin_bswap64 _byteswap_uint64
@@ -24,20 +33,52 @@ Memory::Memory(const std::string &name,
 {
 }
 
+Memory::Memory(const std::string &name,
+               std::shared_ptr<std::byte> data,
+               const MemAddress base,
+               const size_t size)
+  : name(name), base(base), size(size), align(0),
+    data(data.get()), owner(std::move(data))
+{
+}
+
+Memory::Memory(const std::string &name,
+               std::shared_ptr<const std::byte> data,
+               const MemAddress base,
+               const size_t size)
+  : name(name), base(base), size(size), align(0),
+    data(const_cast<std::byte *>(data.get())), owner(std::move(data)),
+    readOnly(true)
+{
+}
+
 Memory::~Memory()
 {
   /* Memory was allocated with alignment and nothrow, so we must
    * also deallocate this way.
    */
-  operator delete[](data, std::align_val_t{ align }, std::nothrow);
+  if (! owner)
+    operator delete[](data, std::align_val_t{ align }, std::nothrow);
 }
 
 void
 Memory::setMayWrite(bool setting)
 {
+  if (setting && (readOnly || words))
+    throw std::logic_error("Shared memory " + name + " cannot be written.");
+
   mayWrite = setting;
 }
 
+void
+Memory::setHostWords(std::shared_ptr<const uint32_t[]> words)
+{
+  if (mayWrite || base % 4 != 0)
+    throw std::logic_error("Memory " + name + " cannot keep host words.");
+
+  this->words = std::move(words);
+}
+
 /*
  * MemoryInterface
  */
@@ -114,12 +155,51 @@ Memory::writeDoubleWord(MemAddress addr, uint64_t value)
   writeData(addr, __builtin_bswap64(value));
 }
 
+void
+Memory::readBlock(MemAddress addr, std::byte *data, size_t size)
+{
+  if (! canAccess(addr, size, false))
+    throw IllegalAccess(addr, size);
+
+  std::memcpy(data, this->data + (addr - base), size);
+}
+
+void
+Memory::writeBlock(MemAddress addr, const std::byte *data, size_t size)
+{
+  if (! canAccess(addr, size, true))
+    throw IllegalAccess(addr, size);
+
+  std::memcpy(this->data + (addr - base), data, size);
+}
+
 bool
 Memory::contains(MemAddress addr) const
 {
   return base <= addr && addr < base + size;
 }
 
+std::vector<AddressRange>
+Memory::getRanges() const
+{
+  return { { base, uint64_t{ base } + size } };
+}
+
+HostPage
+Memory::getHostPage(MemAddress addr)
+{
+  if (! contains(addr))
+    return {};
+
+  const uint64_t page = addr & ~MemAddress{ 0xfff };
+  const MemAddress begin = std::max<uint64_t>(base, page);
+  const uint64_t end = std::min<uint64_t>(uint64_t{ base } + size,
+                                          page + 0x1000);
+
+  return { data + (begin - base), begin, end, mayWrite,
+           words ? words.get() + (begin - base) / 4 : nullptr };
+}
+
 
 /*
  * Private methods
@@ -135,3 +215,33 @@ Memory::canAccess(MemAddress addr, size_t accessSize, bool write) const
 
   return true;
 }
+
+std::shared_ptr<std::byte>
+allocateZeroPages(size_t size)
+{
+  size = std::max<size_t>(size, 1);
+
+#ifdef _MSC_VER
+  void *pages = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT,
+                             PAGE_READWRITE);
+  if (pages == nullptr)
+    throw std::runtime_error("Could not allocate memory.");
+
+  return std::shared_ptr<std::byte>(static_cast<std::byte *>(pages),
+                                    [](std::byte *p)
+    {
+      VirtualFree(p, 0, MEM_RELEASE);
+    });
+#else
+  void *pages = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (pages == MAP_FAILED)
+    throw std::runtime_error("Could not allocate memory.");
+
+  return std::shared_ptr<std::byte>(static_cast<std::byte *>(pages),
+                                    [size](std::byte *p)
+    {
+      munmap(p, size);
+    });
+#endif
+}
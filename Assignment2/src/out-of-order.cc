@@ -0,0 +1,805 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    out-of-order.cc - Out-of-order core with register renaming.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "out-of-order.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+static constexpr uint64_t NotReady = std::numeric_limits<uint64_t>::max();
+
+OutOfOrderCore::OutOfOrderCore(const OutOfOrderConfig &config)
+  : config{ config },
+    values(config.physicalRegisters),
+    readyCycle(config.physicalRegisters),
+    occupancy(config.robSize + 1)
+{
+  if (config.width == 0)
+    throw std::out_of_range("ooo.width must be at least 1");
+  if (config.robSize == 0 || config.issueQueueSize == 0 ||
+      config.loadStoreQueueSize == 0)
+    throw std::out_of_range("ooo queue sizes must be at least 1");
+  if (config.physicalRegisters <= NumLogicalRegs)
+    throw std::out_of_range("ooo.phys_regs must be larger than " +
+                            std::to_string(NumLogicalRegs));
+
+  /* Initially logical register i lives in physical register i. */
+  for (size_t i = 0; i < NumLogicalRegs; ++i)
+    renameMap[i] = committedMap[i] = i;
+  for (size_t i = NumLogicalRegs; i < config.physicalRegisters; ++i)
+    freeList.push_back(i);
+}
+
+bool
+OutOfOrderCore::isReady(int reg) const
+{
+  return reg == NoReg || readyCycle[reg] <= cycle;
+}
+
+RegValue
+OutOfOrderCore::getValue(int reg) const
+{
+  return reg == NoReg ? 0 : values[reg];
+}
+
+int
+OutOfOrderCore::allocate()
+{
+  int reg = freeList.front();
+  freeList.pop_front();
+  readyCycle[reg] = NotReady;
+  return reg;
+}
+
+void
+OutOfOrderCore::release(int reg)
+{
+  if (reg != NoReg)
+    freeList.push_back(reg);
+}
+
+void
+OutOfOrderCore::recover(uint64_t branchSequence, MemAddress target)
+{
+  const uint64_t lastKept = branchSequence + 1;
+
+  while (! rob.empty() && rob.back().sequence > lastKept)
+    {
+      const Entry &entry = rob.back();
+
+      release(entry.dest);
+      release(entry.flagDest);
+      if (! entry.issued)
+        --issueQueueUsed;
+      if (entry.load || entry.store)
+        --loadStoreQueueUsed;
+      rob.pop_back();
+    }
+
+  renameMap = committedMap;
+  for (const auto &entry : rob)
+    {
+      if (entry.dest != NoReg)
+        renameMap[entry.rd] = entry.dest;
+      if (entry.flagDest != NoReg)
+        renameMap[FlagReg] = entry.flagDest;
+    }
+
+  fetchQueue.erase(std::remove_if(fetchQueue.begin(), fetchQueue.end(),
+                                  [lastKept](const FetchEntry &entry)
+                                    {
+                                      return entry.instruction.SEQUENCE > lastKept;
+                                    }),
+                   fetchQueue.end());
+
+  redirect = true;
+  redirectTarget = target;
+  redirectSequence = branchSequence;
+}
+
+void
+OutOfOrderCore::setFrontEndStall(CycleCategory category, MemAddress address,
+                                 uint64_t sequence)
+{
+  frontEndStall = { category, address };
+  frontEndStallSequence = sequence;
+}
+
+void
+OutOfOrderCore::dumpStatistics(std::ostream &os) const
+{
+  auto storeFlags(os.flags());
+
+  os << "Out-of-order core: " << nCommitted << " instructions committed in "
+     << cycle << " cycles";
+  if (cycle > 0)
+    os << ", IPC " << std::fixed << std::setprecision(2)
+       << (double(nCommitted) / cycle);
+  os.flags(storeFlags);
+  os << "." << std::endl;
+
+  auto stall = [this](StallReason reason)
+    {
+      return stalls[static_cast<size_t>(reason)];
+    };
+  os << "Dispatch stalls: "
+     << stall(StallReason::FrontEnd) << " front end, "
+     << stall(StallReason::ROBFull) << " ROB full, "
+     << stall(StallReason::IssueQueueFull) << " issue queue full, "
+     << stall(StallReason::LoadStoreQueueFull) << " load/store queue full, "
+     << stall(StallReason::NoFreeRegister) << " no free register."
+     << std::endl;
+
+  /* Fold the occupancy levels into at most eight ranges. */
+  const size_t range = (occupancy.size() + 7) / 8;
+  os << "ROB occupancy (entries: cycles):";
+  for (size_t first = 0; first < occupancy.size(); first += range)
+    {
+      size_t last = std::min(first + range, occupancy.size()) - 1;
+      uint64_t cycles = 0;
+      for (size_t i = first; i <= last; ++i)
+        cycles += occupancy[i];
+
+      os << " " << first;
+      if (last != first)
+        os << "-" << last;
+      os << ": " << cycles;
+    }
+  os << std::endl;
+}
+
+
+static bool
+overlaps(const OutOfOrderCore::Entry &a, const OutOfOrderCore::Entry &b)
+{
+  return a.address < b.address + b.size && b.address < a.address + a.size;
+}
+
+
+/*
+ * Commit
+ */
+
+void
+OutOfOrderCommitStage::propagate()
+{
+  if (! core.initialized)
+    initialize();
+
+  /* The machine kept running past the device store */
+  if (pendingRetire)
+    {
+      retire(pendingRetirePC);
+      pendingRetire = false;
+    }
+
+  cycleCause = getStallCause();
+
+  for (unsigned int n = 0; n < core.config.width && ! core.rob.empty(); ++n)
+    {
+      const OutOfOrderCore::Entry &head = core.rob.front();
+      if (! head.issued || head.readyCycle > core.cycle)
+        break;
+
+      if (head.fault)
+        std::rethrow_exception(head.fault);
+
+      commit(head);
+      if (n == 0)
+        cycleCause = { CycleCategory::Base, head.PC - 4 };
+
+      /* A store to a device may halt the machine; nothing younger
+       * may commit in the same cycle.
+       */
+      bool device = head.store && ! dataMemory.isCacheable(head.address);
+      core.rob.pop_front();
+      if (device)
+        break;
+    }
+}
+
+/* Copies the architectural registers, which may have been set before
+ * the simulation started.
+ */
+void
+OutOfOrderCommitStage::initialize()
+{
+  for (RegNumber reg = 1; reg < NumRegs; ++reg)
+    {
+      regfile.setRS1(reg);
+      core.values[reg] = regfile.getReadData1();
+    }
+
+  core.initialized = true;
+}
+
+void
+OutOfOrderCommitStage::commit(const OutOfOrderCore::Entry &entry)
+{
+  if (entry.dest != OutOfOrderCore::NoReg)
+    {
+      regfile.setRD(entry.rd);
+      regfile.setWriteData(core.getValue(entry.dest));
+      regfile.setWriteEnable(true);
+      regfile.clockPulse();
+      regfile.setWriteEnable(false);
+
+      core.release(entry.oldDest);
+      core.committedMap[entry.rd] = entry.dest;
+    }
+
+  if (entry.flagDest != OutOfOrderCore::NoReg)
+    {
+      core.release(entry.oldFlagDest);
+      core.committedMap[OutOfOrderCore::FlagReg] = entry.flagDest;
+    }
+
+  if (entry.store)
+    {
+      dataMemory.setPC(entry.PC);
+      dataMemory.setAddress(entry.address);
+      dataMemory.setSize(entry.size);
+      dataMemory.setDataIn(entry.storeData);
+      dataMemory.setWriteEnable(true);
+      dataMemory.clockPulse();
+      dataMemory.setWriteEnable(false);
+    }
+
+  if (entry.load || entry.store)
+    --core.loadStoreQueueUsed;
+
+  if (entry.branchKind != BranchKind::None)
+    branchPredictor.resolve(entry.PC - 4, entry.branchKind, entry.taken,
+                            entry.target, entry.predictionCorrect);
+
+  /* The in-order pipelines halt on a store in MEM, before WB counts it.
+   * For the same instruction count, a store to a device is only counted
+   * once the machine runs for another cycle, which it does not after a
+   * halt.
+   */
+  if (entry.store && ! dataMemory.isCacheable(entry.address))
+    {
+      pendingRetire = true;
+      pendingRetirePC = entry.PC - 4;
+    }
+  else
+    retire(entry.PC - 4);
+}
+
+void
+OutOfOrderCommitStage::retire(MemAddress PC)
+{
+  accounting.retire(PC);
+  ++nInstrCompleted;
+  ++core.nCommitted;
+}
+
+/* Why the head of the ROB cannot commit in this cycle. */
+StallCause
+OutOfOrderCommitStage::getStallCause() const
+{
+  if (core.rob.empty())
+    return core.frontEndStall;
+
+  const OutOfOrderCore::Entry &head = core.rob.front();
+  const MemAddress address = head.PC - 4;
+
+  if (! head.issued)
+    return { head.unitBusy ? CycleCategory::Structural : CycleCategory::Base,
+             address };
+
+  if (head.latency > 1 && head.load)
+    return { CycleCategory::DCacheMiss, address };
+  if (head.latency > 1 &&
+      head.signals.getExecutionUnit() != ExecutionUnit::ALU)
+    return { CycleCategory::Structural, address };
+
+  return { CycleCategory::Base, address };
+}
+
+void
+OutOfOrderCommitStage::clockPulse()
+{
+  accounting.account(cycleCause);
+  ++core.occupancy[core.rob.size()];
+}
+
+
+/*
+ * Issue and execute
+ */
+
+void
+OutOfOrderExecuteStage::propagate()
+{
+  unsigned int nIssued = 0;
+
+  /* Oldest first */
+  for (size_t i = 0; i < core.rob.size() && nIssued < core.config.width; ++i)
+    {
+      OutOfOrderCore::Entry &entry = core.rob[i];
+      if (entry.issued || ! isReady(entry))
+        continue;
+
+      if (! execute(entry, alus[nIssued]))
+        continue;
+
+      ++nIssued;
+      --core.issueQueueUsed;
+
+      /* A mispredicted branch removed everything after its delay slot. */
+      if (core.redirect)
+        break;
+    }
+}
+
+bool
+OutOfOrderExecuteStage::isReady(const OutOfOrderCore::Entry &entry) const
+{
+  return core.isReady(entry.srcA) && core.isReady(entry.srcB) &&
+      core.isReady(entry.srcFlag);
+}
+
+/* Returns false when a load cannot issue yet. */
+bool
+OutOfOrderExecuteStage::execute(OutOfOrderCore::Entry &entry, ALU &alu)
+{
+  const ControlSignals &signals = entry.signals;
+
+  FunctionalUnit *unit = units.select(signals.getExecutionUnit());
+  if (unit && ! unit->isFree(core.cycle))
+    {
+      unit->addStall();
+      entry.unitBusy = true;
+      return false;
+    }
+
+  Mux<RegValue, InputSelectorEXStage> mux1;
+  mux1.setInput(InputSelectorEXStage::InputOne, entry.PC);
+  mux1.setInput(InputSelectorEXStage::InputTwo, core.getValue(entry.srcA));
+  mux1.setSelector(signals.AInput());
+
+  Mux<RegValue, InputSelectorEXStage> mux2;
+  mux2.setInput(InputSelectorEXStage::InputOne, core.getValue(entry.srcB));
+  mux2.setInput(InputSelectorEXStage::InputTwo, entry.immediate);
+  mux2.setSelector(signals.BInput());
+
+  alu.setA(mux1.getOutput());
+  alu.setB(mux2.getOutput());
+  alu.setOp(entry.op);
+
+  RegValue result{};
+  try
+    {
+      result = alu.getResult();
+    }
+  catch (std::exception &)
+    {
+      entry.fault = std::current_exception();
+    }
+
+  RegValue value = signals.setLinkRegister() ? entry.PC : result;
+  uint64_t latency = 1;
+
+  if (entry.load && ! entry.fault)
+    {
+      entry.address = result;
+      if (! executeLoad(entry, value, latency))
+        return false;
+    }
+  else if (entry.store)
+    {
+      entry.address = result;
+      entry.storeData = core.getValue(entry.srcB);
+    }
+
+  if (unit)
+    latency = unit->issue(core.cycle) - core.cycle;
+
+  entry.issued = true;
+  entry.readyCycle = core.cycle + latency;
+  entry.latency = latency;
+
+  if (entry.dest != OutOfOrderCore::NoReg)
+    {
+      core.values[entry.dest] = value;
+      core.readyCycle[entry.dest] = entry.readyCycle;
+    }
+  if (entry.flagDest != OutOfOrderCore::NoReg)
+    {
+      core.values[entry.flagDest] = alu.getFlag();
+      core.readyCycle[entry.flagDest] = entry.readyCycle;
+    }
+
+  if (entry.branchKind != BranchKind::None && ! entry.fault)
+    {
+      entry.taken = signals.jump(core.getValue(entry.srcFlag) != 0);
+      entry.target = result;
+
+      RegValue actual = entry.taken ? result : entry.PC + 4;
+      RegValue predicted = entry.prediction.taken ? entry.prediction.target
+                                                  : entry.PC + 4;
+      entry.predictionCorrect = actual == predicted;
+      if (! entry.predictionCorrect)
+        {
+          core.setFrontEndStall(CycleCategory::BranchMispredict,
+                                entry.PC - 4, entry.sequence + 1);
+          core.recover(entry.sequence, actual);
+        }
+    }
+
+  return true;
+}
+
+/* The youngest older store that overlaps the load supplies its data
+ * when it wrote exactly the bytes that are loaded.
+ */
+bool
+OutOfOrderExecuteStage::executeLoad(OutOfOrderCore::Entry &entry,
+                                    RegValue &value, uint64_t &latency)
+{
+  const OutOfOrderCore::Entry *match = nullptr;
+
+  for (const auto &older : core.rob)
+    {
+      if (older.sequence >= entry.sequence)
+        break;
+      if (! older.store)
+        continue;
+      if (! older.issued)
+        return false;
+      if (overlaps(older, entry))
+        match = &older;
+    }
+
+  if (match)
+    {
+      if (match->address != entry.address || match->size != entry.size)
+        return false;
+
+      value = match->storeData;
+      if (entry.size < 4)
+        value &= (RegValue(1) << (8 * entry.size)) - 1;
+      return true;
+    }
+
+  /* Device registers are not read speculatively. */
+  if (! dataMemory.isCacheable(entry.address) &&
+      &core.rob.front() != &entry)
+    return false;
+
+  try
+    {
+      dataMemory.setPC(entry.PC);
+      dataMemory.setAddress(entry.address);
+      dataMemory.setSize(entry.size);
+      dataMemory.setReadEnable(true);
+      value = dataMemory.getDataOut(entry.signals.signExtendedRead());
+      dataMemory.setReadEnable(false);
+      latency = dataMemory.getLatency();
+    }
+  catch (std::exception &)
+    {
+      /* Possibly on the wrong path; raised only if it commits. */
+      dataMemory.setReadEnable(false);
+      entry.fault = std::current_exception();
+    }
+
+  return true;
+}
+
+void
+OutOfOrderExecuteStage::clockPulse()
+{
+}
+
+
+/*
+ * Decode, rename and dispatch
+ */
+
+void
+OutOfOrderDispatchStage::propagate()
+{
+  using StallReason = OutOfOrderCore::StallReason;
+
+  unsigned int n = 0;
+  StallReason reason = StallReason::FrontEnd;
+
+  for (; n < core.config.width; ++n)
+    {
+      if (core.fetchQueue.empty() ||
+          core.fetchQueue.front().availableCycle > core.cycle)
+        {
+          reason = StallReason::FrontEnd;
+          break;
+        }
+
+      OutOfOrderCore::Entry entry{};
+      decode(entry, core.fetchQueue.front().instruction);
+
+      if (core.rob.size() >= core.config.robSize)
+        reason = StallReason::ROBFull;
+      else if (! entry.issued &&
+               core.issueQueueUsed >= core.config.issueQueueSize)
+        reason = StallReason::IssueQueueFull;
+      else if ((entry.load || entry.store) &&
+               core.loadStoreQueueUsed >= core.config.loadStoreQueueSize)
+        reason = StallReason::LoadStoreQueueFull;
+      else if (! dispatch(entry))
+        reason = StallReason::NoFreeRegister;
+      else
+        {
+          core.fetchQueue.pop_front();
+          continue;
+        }
+
+      break;
+    }
+
+  if (n < core.config.width)
+    ++core.stalls[static_cast<size_t>(reason)];
+}
+
+void
+OutOfOrderDispatchStage::decode(OutOfOrderCore::Entry &entry,
+                                const IF_IDRegisters &in)
+{
+  InstructionDecoder &decoder = entry.decoder;
+  ControlSignals &signals = entry.signals;
+
+  entry.PC = in.PC;
+  entry.sequence = in.SEQUENCE;
+  entry.prediction = in.PREDICTION;
+
+  decoder.setInstructionWord(in.INSTRUCTION_WORD);
+  try
+    {
+      signals.setOpcode(decoder.getOpcode());
+      signals.setFunctionCode(decoder.getFunctionCode());
+    }
+  catch (IllegalInstruction &e)
+    {
+      /* Possibly on the wrong path; raised only if it commits. */
+      entry.fault = std::current_exception();
+      entry.issued = true;
+      return;
+    }
+
+  RegNumber RA, RB;
+  try {
+    RA = decoder.getA();
+  } catch (IllegalInstruction &e) {
+    RA = 0;
+  }
+  try {
+    RB = decoder.getB();
+  } catch (IllegalInstruction &e) {
+    RB = 0;
+  }
+  try {
+    entry.rd = signals.setLinkRegister() ? 9 : decoder.getD();
+  } catch (IllegalInstruction &e) {
+    entry.rd = 0;
+  }
+  try {
+    entry.immediate = decoder.getImmediate();
+  } catch (IllegalInstruction &e) {
+    entry.immediate = 0;
+  }
+
+  entry.op = signals.AluOp();
+  entry.branchKind = getBranchKind(decoder.getFunctionCode(), RB);
+  entry.load = signals.isReadOpBool();
+  entry.store = signals.isWriteOpBool();
+  if (entry.load || entry.store)
+    entry.size = signals.getDataSize();
+
+  /* Temporarily logical register numbers, renamed in dispatch. */
+  if (signals.AInput() == InputSelectorEXStage::InputTwo)
+    entry.srcA = RA;
+  if (signals.BInput() == InputSelectorEXStage::InputOne || entry.store)
+    entry.srcB = RB;
+  if (entry.branchKind == BranchKind::Conditional)
+    entry.srcFlag = OutOfOrderCore::FlagReg;
+  if (signals.regWriteInput() && entry.rd != 0)
+    entry.dest = entry.rd;
+  if (setsFlag(entry.op))
+    entry.flagDest = OutOfOrderCore::FlagReg;
+}
+
+/* Renames the operands and allocates the instruction in the ROB.
+ * Returns false when too few physical registers are free.
+ */
+bool
+OutOfOrderDispatchStage::dispatch(OutOfOrderCore::Entry &entry)
+{
+  using Core = OutOfOrderCore;
+
+  size_t needed = (entry.dest != Core::NoReg) + (entry.flagDest != Core::NoReg);
+  if (core.freeList.size() < needed)
+    return false;
+
+  auto rename = [this](int &reg)
+    {
+      if (reg > 0)
+        reg = core.renameMap[reg];
+      else
+        reg = Core::NoReg;
+    };
+  rename(entry.srcA);
+  rename(entry.srcB);
+  rename(entry.srcFlag);
+
+  if (entry.dest != Core::NoReg)
+    {
+      entry.oldDest = core.renameMap[entry.rd];
+      entry.dest = core.allocate();
+      core.renameMap[entry.rd] = entry.dest;
+    }
+  if (entry.flagDest != Core::NoReg)
+    {
+      entry.oldFlagDest = core.renameMap[Core::FlagReg];
+      entry.flagDest = core.allocate();
+      core.renameMap[Core::FlagReg] = entry.flagDest;
+    }
+
+  if (entry.issued)
+    entry.readyCycle = core.cycle + 1;
+  else
+    ++core.issueQueueUsed;
+  if (entry.load || entry.store)
+    ++core.loadStoreQueueUsed;
+
+  if (debugMode)
+    {
+      auto storeFlags(std::cerr.flags());
+
+      std::cerr << std::hex << std::showbase << entry.PC << "\t";
+      std::cerr.setf(storeFlags);
+
+      std::string symbol = symbols.format(entry.PC);
+      if (!symbol.empty())
+        std::cerr << "<" << symbol << ">\t";
+
+      std::cerr << entry.decoder << std::endl;
+    }
+
+  if (entry.sequence > core.frontEndStallSequence)
+    core.frontEndStall = StallCause{};
+
+  core.rob.push_back(entry);
+  ++nInstrIssued;
+  return true;
+}
+
+void
+OutOfOrderDispatchStage::clockPulse()
+{
+}
+
+
+/*
+ * Instruction fetch
+ */
+
+void
+OutOfOrderFetchStage::propagate()
+{
+  if (core.redirect)
+    {
+      core.redirect = false;
+      pendingException = nullptr;
+      busyUntil = core.cycle + 1;
+
+      /* The delay slot has not been fetched yet: redirect after it. */
+      if (fetchSequence <= core.redirectSequence)
+        {
+          redirectAfterDelaySlot = true;
+          predictedTarget = core.redirectTarget;
+          busyUntil = core.cycle;
+        }
+      else
+        {
+          redirectAfterDelaySlot = false;
+          PC = core.redirectTarget;
+        }
+    }
+
+  if (pendingException)
+    {
+      if (core.rob.empty() && core.fetchQueue.empty())
+        std::rethrow_exception(pendingException);
+      return;
+    }
+
+  if (core.cycle < busyUntil)
+    {
+      ++nFetchStalls;
+      return;
+    }
+
+  const unsigned int width = core.config.width;
+  if (core.fetchQueue.size() + width > 2 * width)
+    return;
+
+  /* A fetch group ends after the delay slot of a branch predicted
+   * taken.
+   */
+  unsigned int latency = 1;
+  size_t first = core.fetchQueue.size();
+
+  for (unsigned int i = 0; i < width; ++i)
+    {
+      OutOfOrderCore::FetchEntry entry{};
+
+      try
+        {
+          instructionMemory.setAddress(PC);
+          instructionMemory.setSize(4);
+          entry.instruction.INSTRUCTION_WORD = instructionMemory.getValue();
+          latency = std::max(latency, instructionMemory.getLatency());
+
+          if (entry.instruction.INSTRUCTION_WORD == TestEndMarker)
+            throw TestEndMarkerEncountered(PC);
+        }
+      catch (TestEndMarkerEncountered &e)
+        {
+          pendingException = std::current_exception();
+        }
+      catch (std::exception &e)
+        {
+          pendingException =
+              std::make_exception_ptr(InstructionFetchFailure(PC));
+        }
+
+      if (pendingException)
+        {
+          core.setFrontEndStall(CycleCategory::Drain, PC,
+                                std::numeric_limits<uint64_t>::max());
+          break;
+        }
+
+      entry.instruction.PC = PC + 4;
+      entry.instruction.SEQUENCE = ++fetchSequence;
+      if (! redirectAfterDelaySlot)
+        entry.instruction.PREDICTION = branchPredictor.predict(PC, PC + 4);
+      core.fetchQueue.push_back(entry);
+
+      PC += 4;
+      if (redirectAfterDelaySlot)
+        {
+          PC = predictedTarget;
+          redirectAfterDelaySlot = false;
+          break;
+        }
+      else if (entry.instruction.PREDICTION.taken)
+        {
+          redirectAfterDelaySlot = true;
+          predictedTarget = entry.instruction.PREDICTION.target;
+        }
+    }
+
+  for (size_t i = first; i < core.fetchQueue.size(); ++i)
+    core.fetchQueue[i].availableCycle = core.cycle + latency;
+  busyUntil = core.cycle + latency;
+
+  if (latency > 1 && first < core.fetchQueue.size())
+    core.setFrontEndStall(CycleCategory::ICacheMiss,
+                          core.fetchQueue[first].instruction.PC - 4,
+                          core.fetchQueue[first].instruction.SEQUENCE - 1);
+}
+
+void
+OutOfOrderFetchStage::clockPulse()
+{
+  /* Last stage of the cycle */
+  ++core.cycle;
+}
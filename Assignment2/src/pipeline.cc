@@ -7,54 +7,168 @@
 
 #include "pipeline.h"
 
+#include <limits>
+#include <stdexcept>
 
-Pipeline::Pipeline(bool pipelining,
+
+Pipeline::Pipeline(const MachineConfig &config,
                    bool debugMode,
                    MemAddress &PC,
                    InstructionMemory &instructionMemory,
                    InstructionDecoder &decoder,
                    RegisterFile &regfile,
                    bool &flag,
-                   DataMemory &dataMemory)
-  : pipelining{ pipelining }
+                   DataMemory &dataMemory,
+                   const SymbolTable &symbols)
+  : pipelining{ config.pipelining },
+    dualIssue{ config.pipelining && config.issueWidth == 2 },
+    depth{ config.depth },
+    accounting{ symbols },
+    branchPredictor{ config.branchPredictor },
+    functionalUnits{ config.multiplier, config.divider },
+    regfile{ regfile }
 {
+  config.validate();
+
+  if (pipelining && config.outOfOrder.enabled)
+    {
+      outOfOrderCore = std::make_unique<OutOfOrderCore>(config.outOfOrder);
+      auto &core = *outOfOrderCore;
+
+      /* Back to front, see out-of-order.h */
+      stages.emplace_back(std::make_unique<OutOfOrderCommitStage>(core, regfile,
+                                                                  dataMemory,
+                                                                  branchPredictor,
+                                                                  nInstrCompleted,
+                                                                  accounting));
+      stages.emplace_back(std::make_unique<OutOfOrderExecuteStage>(core,
+                                                                   dataMemory,
+                                                                   functionalUnits));
+      stages.emplace_back(std::make_unique<OutOfOrderDispatchStage>(core,
+                                                                    nInstrIssued,
+                                                                    symbols,
+                                                                    debugMode));
+      stages.emplace_back(std::make_unique<OutOfOrderFetchStage>(core,
+                                                                 instructionMemory,
+                                                                 PC,
+                                                                 branchPredictor,
+                                                                 nFetchStalls));
+      return;
+    }
+
+  if (dualIssue)
+    {
+      auto &regs = dualIssueRegisters;
+
+      stages.emplace_back(std::make_unique<DualFetchStage>(regs,
+                                                           instructionMemory,
+                                                           PC,
+                                                           branchPredictor,
+                                                           nFetchStalls));
+      stages.emplace_back(std::make_unique<DualDecodeStage>(regs, regfile,
+                                                            nInstrIssued,
+                                                            nStalls,
+                                                            issueStatistics,
+                                                            symbols,
+                                                            debugMode));
+      stages.emplace_back(std::make_unique<DualExecuteStage>(regs,
+                                                             branchPredictor,
+                                                             functionalUnits,
+                                                             cycle,
+                                                             waitCycles));
+      stages.emplace_back(std::make_unique<DualMemoryStage>(regs, dataMemory,
+                                                            waitCycles));
+      stages.emplace_back(std::make_unique<DualWriteBackStage>(regs, regfile,
+                                                               nInstrCompleted));
+      return;
+    }
+
   /* TODO: this might need modification in case the stages need access
    * to more shared components.
    */
 
-  HazardDetector HAZARD_DETECTOR;
+  /* The split stages only exist in pipelined mode; the registers in
+   * front of them are used in their place otherwise.
+   */
+  const bool fetch2 = pipelining && depth.fetchStages > 1;
+  const bool registerRead = pipelining && depth.registerRead;
+  const bool memory2 = pipelining && depth.memoryStages > 1;
+  const bool earlyBranches = pipelining && depth.earlyBranches;
+
+  /* Written by ID; IF reads the decisions of ID from it */
+  ID_EXRegisters &id_out = registerRead ? id_rr : id_ex;
+  const ID_EXRegisters *id_branch = earlyBranches ? &id_out : nullptr;
+
+  if (pipelining)
+    branchPredictor.setMispredictPenalty(depth.getBranchPenalty());
 
   stages.emplace_back(std::make_unique<InstructionFetchStage>(pipelining,
                                                               ex_m,
-                                                              if_id,
+                                                              fetch2 ? if_if2 : if_id,
                                                               instructionMemory,
                                                               PC, 
-                                                              HAZARD_DETECTOR));
+                                                              hazardDetector,
+                                                              branchPredictor,
+                                                              nFetchStalls,
+                                                              waitCycles,
+                                                              depth.getDepth() - 1,
+                                                              id_branch));
+  if (fetch2)
+    stages.emplace_back(std::make_unique<InstructionFetch2Stage>(pipelining,
+                                                                 if_if2, ex_m, if_id,
+                                                                 hazardDetector,
+                                                                 id_branch));
   stages.emplace_back(std::make_unique<InstructionDecodeStage>(pipelining,
-                                                               if_id, m_wb, id_ex,
+                                                               if_id, ex_m, m_wb,
+                                                               id_out,
+                                                               registerRead ? &id_ex : nullptr,
+                                                               memory2 ? &m_m2 : nullptr,
                                                                regfile,
                                                                decoder,
                                                                nInstrIssued,
                                                                nStalls, 
-                                                               HAZARD_DETECTOR,
+                                                               hazardDetector,
+                                                               functionalUnits,
+                                                               cycle,
+                                                               earlyBranches ? &branchPredictor : nullptr,
+                                                               nFlagStalls,
+                                                               symbols,
                                                                debugMode));
+  if (registerRead)
+    stages.emplace_back(std::make_unique<RegisterReadStage>(pipelining,
+                                                            id_rr, ex_m, m_wb, id_ex,
+                                                            regfile));
   stages.emplace_back(std::make_unique<ExecuteStage>(pipelining,
-                                                     id_ex, ex_m, 
-                                                     HAZARD_DETECTOR));
+                                                     id_ex,
+                                                     memory2 ? m_m2 : m_wb, m_wb,
+                                                     ex_m, 
+                                                     hazardDetector,
+                                                     branchPredictor,
+                                                     functionalUnits,
+                                                     cycle,
+                                                     waitCycles));
   stages.emplace_back(std::make_unique<MemoryStage>(pipelining,
-                                                    ex_m, m_wb,
+                                                    ex_m, memory2 ? m_m2 : m_wb,
                                                     dataMemory, 
-                                                    HAZARD_DETECTOR));
+                                                    hazardDetector,
+                                                    waitCycles));
+  if (memory2)
+    stages.emplace_back(std::make_unique<Memory2Stage>(pipelining, m_m2, m_wb));
   stages.emplace_back(std::make_unique<WriteBackStage>(pipelining,
                                                        m_wb,
                                                        regfile, flag,
                                                        nInstrCompleted, 
-                                                       HAZARD_DETECTOR));
+                                                       hazardDetector,
+                                                       functionalUnits,
+                                                       cycle));
 }
 
 void
 Pipeline::propagate()
 {
+  if (waitCycles.getCycles() > 0)
+    return;
+
   if (! pipelining)
     {
       /* Execute a single instruction execution step. */
@@ -71,6 +185,14 @@ Pipeline::propagate()
 void
 Pipeline::clockPulse()
 {
+  if (waitCycles.getCycles() > 0)
+    {
+      skipCycles(1);
+      return;
+    }
+
+  ++cycle;
+
   if (! pipelining)
     {
       stages[currentStage]->clockPulse();
@@ -78,7 +200,108 @@ Pipeline::clockPulse()
     }
   else
     {
+      /* WB's input, charged once the cycle completed */
+      const IssueGroup<M_WBRegisters> retiring =
+          dualIssue ? dualIssueRegisters.m_wb
+                    : IssueGroup<M_WBRegisters>{ m_wb, M_WBRegisters{} };
+
       for (auto &s : stages)
         s->clockPulse();
+
+      if (! outOfOrderCore)
+        accountCycle(retiring);
     }
+
+  /* The instruction in progress is in IF/ID once fetched. */
+  if (! pipelining)
+    {
+      accounting.account(CycleCategory::Base, if_id.FETCH_PC);
+      if (currentStage == 0)
+        accounting.retire(if_id.FETCH_PC);
+    }
+}
+
+void
+Pipeline::skipCycles(uint64_t cycles)
+{
+  StallCause cause;
+
+  while (cycles > 0 && waitCycles.getCycles() > 0)
+    {
+      uint64_t n = waitCycles.advance(cycles, cause);
+      accounting.account(cause, n);
+
+      cycle += n;
+      nMemoryStalls += n;
+      cycles -= n;
+    }
+}
+
+/* Charges the cycle to the instructions leaving the pipeline, or to the
+ * reason WB received a bubble. The out-of-order core accounts in its
+ * commit stage.
+ */
+void
+Pipeline::accountCycle(const IssueGroup<M_WBRegisters> &retiring)
+{
+  bool completed = false;
+
+  for (const auto &wb : retiring)
+    if (wb.PC != 0)
+      {
+        if (! completed)
+          accounting.account(CycleCategory::Base, wb.PC - 4);
+        accounting.retire(wb.PC - 4);
+        completed = true;
+      }
+
+  if (! completed)
+    accounting.account(retiring[0].BUBBLE_CAUSE);
+}
+
+/* Multi-cycle operations that were in flight when the machine halted
+ * still write their results.
+ */
+uint64_t
+Pipeline::drain()
+{
+  if (cycle == 0)
+    return 0;
+
+  /* A store that halts the machine does so in MEM. With a split memory
+   * stage the instruction ahead of it is still in MEM2 and completes in
+   * one more cycle of MEM2 and WB.
+   */
+  uint64_t cycles = 0;
+  if (pipelining && depth.memoryStages > 1 && m_wb.PC != 0 &&
+      ! dualIssue && ! outOfOrderCore)
+    {
+      const IssueGroup<M_WBRegisters> retiring{ m_wb, M_WBRegisters{} };
+      const auto tail = stages.end() - 2;
+
+      ++cycle;
+      for (auto s = tail; s != stages.end(); ++s)
+        (*s)->propagate();
+      for (auto s = tail; s != stages.end(); ++s)
+        (*s)->clockPulse();
+      accountCycle(retiring);
+      cycles = 1;
+    }
+
+  uint64_t unitCycles = functionalUnits.drain(cycle - 1);
+  accounting.account(CycleCategory::Drain, 0, unitCycles);
+  cycles += unitCycles;
+
+  regfile.setWriteEnable(false);
+  while (auto *result = functionalUnits.getCompleted(std::numeric_limits<uint64_t>::max()))
+    {
+      regfile.setRD2(result->rd);
+      regfile.setWriteData2(result->value);
+      regfile.setWriteEnable2(true);
+      regfile.clockPulse();
+      functionalUnits.retire(result->sequence);
+    }
+  regfile.setWriteEnable2(false);
+
+  return cycles;
 }
@@ -0,0 +1,333 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    prefetcher.cc - Hardware prefetcher models.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "prefetcher.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <stdexcept>
+
+/* Instructions are word-aligned; drop the low bits when indexing
+ * per-instruction tables.
+ */
+static size_t
+tableIndex(MemAddress pc, size_t tableSize)
+{
+  return (pc >> 2) % tableSize;
+}
+
+static void
+checkTableSize(size_t tableSize)
+{
+  if (tableSize == 0)
+    throw std::out_of_range("prefetcher table size must be at least 1");
+}
+
+
+/*
+ * Next-N-line
+ */
+
+NextLinePrefetcher::NextLinePrefetcher(size_t lineSize, unsigned int degree)
+  : lineSize{ lineSize }, degree{ degree }
+{
+}
+
+void
+NextLinePrefetcher::train(MemAddress /* pc */, MemAddress addr,
+                          bool /* miss */,
+                          std::vector<MemAddress> &prefetches)
+{
+  for (unsigned int i = 1; i <= degree; ++i)
+    prefetches.push_back(addr + i * lineSize);
+}
+
+
+/*
+ * Stride
+ */
+
+StridePrefetcher::StridePrefetcher(size_t tableSize, unsigned int degree)
+  : table(tableSize), degree{ degree }
+{
+  checkTableSize(tableSize);
+}
+
+void
+StridePrefetcher::train(MemAddress pc, MemAddress addr, bool /* miss */,
+                        std::vector<MemAddress> &prefetches)
+{
+  Entry &entry = table[tableIndex(pc, table.size())];
+
+  if (entry.pc != pc)
+    {
+      entry = Entry{ pc, addr, 0, 0 };
+      return;
+    }
+
+  int64_t stride = addr - entry.lastAddr;
+  entry.lastAddr = addr;
+
+  if (stride == entry.stride)
+    {
+      if (entry.confidence < 3)
+        ++entry.confidence;
+    }
+  else if (entry.confidence > 0)
+    --entry.confidence;
+  else
+    entry.stride = stride;
+
+  if (entry.confidence >= 2 && entry.stride != 0)
+    for (unsigned int i = 1; i <= degree; ++i)
+      prefetches.push_back(addr + i * entry.stride);
+}
+
+
+/*
+ * Stream
+ */
+
+StreamPrefetcher::StreamPrefetcher(size_t lineSize, size_t nStreams,
+                                   unsigned int degree)
+  : lineSize{ lineSize }, streams(nStreams), degree{ degree }
+{
+  checkTableSize(nStreams);
+}
+
+void
+StreamPrefetcher::train(MemAddress /* pc */, MemAddress addr, bool miss,
+                        std::vector<MemAddress> &prefetches)
+{
+  int64_t line = addr / lineSize;
+
+  Stream *stream = nullptr;
+  for (auto &s : streams)
+    if (s.valid && std::abs(line - s.lastLine) <= Window)
+      {
+        stream = &s;
+        break;
+      }
+
+  if (! stream)
+    {
+      /* Only misses start a new stream. */
+      if (! miss)
+        return;
+
+      stream = &streams[0];
+      for (auto &s : streams)
+        if (! s.valid || s.lastUse < stream->lastUse)
+          stream = &s;
+
+      *stream = Stream{ true, line, 0, 0, ++useCounter };
+      return;
+    }
+
+  stream->lastUse = ++useCounter;
+  if (line == stream->lastLine)
+    return;
+
+  int direction = line > stream->lastLine ? 1 : -1;
+  if (direction == stream->direction)
+    {
+      if (stream->confidence < 3)
+        ++stream->confidence;
+    }
+  else
+    {
+      stream->direction = direction;
+      stream->confidence = 0;
+    }
+  stream->lastLine = line;
+
+  if (stream->confidence >= 1)
+    for (unsigned int i = 1; i <= degree; ++i)
+      prefetches.push_back((line + direction * int64_t(i)) * lineSize);
+}
+
+
+/*
+ * Delta-correlating
+ */
+
+DeltaCorrelatingPrefetcher::DeltaCorrelatingPrefetcher(size_t tableSize,
+                                                       unsigned int degree)
+  : table(tableSize), degree{ degree }
+{
+  checkTableSize(tableSize);
+}
+
+/* The last two deltas of an instruction are searched for in its older
+ * history. When found, the deltas that followed that earlier occurrence
+ * are replayed from the current address.
+ */
+void
+DeltaCorrelatingPrefetcher::train(MemAddress pc, MemAddress addr,
+                                  bool /* miss */,
+                                  std::vector<MemAddress> &prefetches)
+{
+  Entry &entry = table[tableIndex(pc, table.size())];
+
+  if (entry.pc != pc)
+    {
+      entry = Entry{ pc, addr, {} };
+      return;
+    }
+
+  int64_t delta = addr - entry.lastAddr;
+  entry.lastAddr = addr;
+  if (delta == 0)
+    return;
+
+  auto &deltas = entry.deltas;
+  if (deltas.size() == HistoryLength)
+    deltas.erase(deltas.begin());
+  deltas.push_back(delta);
+
+  const size_t n = deltas.size();
+  if (n < 3)
+    return;
+
+  for (size_t i = n - 2; i-- > 1; )
+    if (deltas[i - 1] == deltas[n - 2] && deltas[i] == deltas[n - 1])
+      {
+        MemAddress target = addr;
+        for (size_t j = i + 1; j < n && prefetches.size() < degree; ++j)
+          {
+            target += deltas[j];
+            prefetches.push_back(target);
+          }
+        return;
+      }
+}
+
+
+std::unique_ptr<Prefetcher>
+makePrefetcher(const PrefetcherConfig &config, size_t lineSize)
+{
+  switch (config.type)
+    {
+      case PrefetcherType::None:
+        return nullptr;
+      case PrefetcherType::NextLine:
+        return std::make_unique<NextLinePrefetcher>(lineSize, config.degree);
+      case PrefetcherType::Stride:
+        return std::make_unique<StridePrefetcher>(config.tableSize,
+                                                  config.degree);
+      case PrefetcherType::Stream:
+        return std::make_unique<StreamPrefetcher>(lineSize, config.tableSize,
+                                                  config.degree);
+      case PrefetcherType::DeltaCorrelating:
+        return std::make_unique<DeltaCorrelatingPrefetcher>(config.tableSize,
+                                                            config.degree);
+    }
+
+  return nullptr;
+}
+
+
+/*
+ * Prefetch unit
+ */
+
+PrefetchUnit::PrefetchUnit(const PrefetcherConfig &config, Cache &cache,
+                           MemoryBus &bus, const uint64_t &clock)
+  : prefetcher{ makePrefetcher(config, cache.getConfig().lineSize) },
+    cache{ cache }, bus{ bus }, clock{ clock },
+    lineSize{ cache.getConfig().lineSize }
+{
+  if (lineSize < 4)
+    throw std::out_of_range(cache.getName() +
+                            ": prefetching needs lines of at least 4 bytes");
+}
+
+unsigned int
+PrefetchUnit::access(MemAddress pc, MemAddress addr, bool write)
+{
+  const MemAddress line = addr & ~MemAddress(lineSize - 1);
+  const bool present = cache.contains(addr);
+  unsigned int latency = cache.access(addr, write);
+
+  auto it = pending.find(line);
+  if (it != pending.end())
+    {
+      /* Lines evicted before their first use were useless. */
+      if (present)
+        {
+          ++nUseful;
+          if (it->second > clock)
+            {
+              ++nLate;
+              latency = std::max<uint64_t>(latency, it->second - clock);
+            }
+        }
+      pending.erase(it);
+    }
+
+  if (! present)
+    ++nDemandMisses;
+
+  if (prefetcher)
+    {
+      candidates.clear();
+      prefetcher->train(pc, addr, ! present, candidates);
+      for (MemAddress candidate : candidates)
+        issue(candidate & ~MemAddress(lineSize - 1));
+    }
+
+  return latency;
+}
+
+void
+PrefetchUnit::issue(MemAddress line)
+{
+  if (! bus.isCacheable(line) || cache.contains(line))
+    return;
+
+  ++nIssued;
+  pending[line] = clock + cache.prefetch(line);
+
+  /* Transfer the line over the bus, the data itself is not kept. A
+   * prefetch never faults: the transfer stops at the end of memory.
+   */
+  uint64_t bytesBefore = bus.getBytesRead();
+  try
+    {
+      for (MemAddress addr = line; addr < line + lineSize; addr += 4)
+        if (bus.isCacheable(addr))
+          bus.readWord(addr);
+    }
+  catch (IllegalAccess &)
+    {
+    }
+  extraBytes += bus.getBytesRead() - bytesBefore;
+}
+
+void
+PrefetchUnit::dumpStatistics(std::ostream &os) const
+{
+  if (! prefetcher)
+    return;
+
+  auto storeFlags(os.flags());
+  auto percentage = [](uint64_t part, uint64_t total)
+    {
+      return total > 0 ? 100.0 * part / total : 0.0;
+    };
+
+  os << cache.getName() << " " << prefetcher->getName() << " prefetcher: "
+     << nIssued << " issued, " << nUseful << " useful, "
+     << nLate << " late, " << extraBytes << " extra bytes read."
+     << std::endl;
+  os << std::fixed << std::setprecision(2)
+     << "  " << percentage(nUseful, nIssued) << "% accuracy, "
+     << percentage(nUseful, nUseful + nDemandMisses) << "% coverage, "
+     << percentage(nUseful - nLate, nUseful) << "% timely." << std::endl;
+  os.flags(storeFlags);
+}
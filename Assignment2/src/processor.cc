@@ -6,7 +6,9 @@
  */
 
 #include "processor.h"
+#include "flat-memory.h"
 #include "inst-decoder.h"
+#include "memory.h"
 #include "serial.h"
 #include "framebuffer.h"
 
@@ -14,21 +16,147 @@
 #include <iomanip>
 
 
-Processor::Processor(ELFFile &program, bool pipelining, bool debugMode)
-  : bus{ program.createMemories() },
-    instructionMemory{ bus },
-    dataMemory{ bus },
-    pipeline{ pipelining, debugMode, PC, instructionMemory, decoder,
-        regfile, flag, dataMemory }
+static std::unique_ptr<Cache>
+makeCache(std::string_view name, const CacheConfig &config,
+          MemoryLevel *next)
 {
-  bus.addClient(std::make_unique<Serial>(0x200));
+  if (config.size == 0)
+    return nullptr;
 
-  auto status = std::make_unique<SysStatus>(0x270);
+  return std::make_unique<Cache>(name, config, next);
+}
+
+static std::unique_ptr<DRAMController>
+makeDRAM(const DRAMConfig &config, unsigned int busClockDivider)
+{
+  if (!config.enabled)
+    return nullptr;
+
+  return std::make_unique<DRAMController>(config, busClockDivider);
+}
+
+static std::unique_ptr<PrefetchUnit>
+makePrefetchUnit(const PrefetcherConfig &config, Cache *cache,
+                 MemoryBus &bus, const uint64_t &clock)
+{
+  if (!cache || config.type == PrefetcherType::None)
+    return nullptr;
+
+  return std::make_unique<PrefetchUnit>(config, *cache, bus, clock);
+}
+
+static std::unique_ptr<StoreBuffer>
+makeStoreBuffer(const StoreBufferConfig &config, MemoryBus &bus,
+                Cache *cache, PrefetchUnit *prefetcher,
+                const uint64_t &clock)
+{
+  if (config.entries == 0)
+    return nullptr;
+
+  return std::make_unique<StoreBuffer>(config, bus, cache, prefetcher, clock);
+}
+
+/* The program and the RAM regions of the machine */
+static std::vector<std::unique_ptr<MemoryInterface>>
+createMemories(const ELFFile &program, const MachineConfig &config)
+{
+  std::vector<std::unique_ptr<MemoryInterface>> memories;
+  std::vector<AddressRange> programRanges;
+
+#ifndef _MSC_VER
+  std::unique_ptr<FlatMemory> flat;
+  if (config.flatMemory)
+    {
+      flat = program.createFlatMemory();
+      programRanges = flat->getRanges();
+    }
+  else
+#endif
+    {
+      memories = program.createMemories();
+      for (const auto &memory : memories)
+        for (const AddressRange &range : memory->getRanges())
+          programRanges.push_back(range);
+    }
+
+  for (const auto &region : config.ram.getRegions())
+    {
+      for (const AddressRange &range : programRanges)
+        if (region.base < range.end &&
+            range.begin < region.base + uint64_t{ region.size })
+          throw std::out_of_range("memory." + region.name +
+                                  " overlaps the program");
+
+#ifndef _MSC_VER
+      if (flat)
+        {
+          flat->map(region.base, region.size, nullptr, true);
+          continue;
+        }
+#endif
+
+      auto memory = std::make_unique<Memory>(region.name,
+                                             allocateZeroPages(region.size),
+                                             region.base, region.size);
+      memory->setMayWrite(true);
+      memories.push_back(std::move(memory));
+    }
+
+#ifndef _MSC_VER
+  if (flat)
+    memories.push_back(std::move(flat));
+#endif
+
+  return memories;
+}
+
+/* Returns the first level present in the hierarchy, if any. */
+static MemoryLevel *
+firstLevel(MemoryLevel *level, MemoryLevel *next)
+{
+  return level ? level : next;
+}
+
+
+Processor::Processor(const ELFFile &program, const MachineConfig &config,
+                     bool debugMode, std::ostream &console)
+  : console{ console },
+    busClockDivider{ config.busClockDivider },
+    skipStalls{ config.skipStalls },
+    bus{ createMemories(program, config) },
+    dram{ makeDRAM(config.dram, busClockDivider) },
+    l2Cache{ makeCache("L2", config.l2Cache, dram.get()) },
+    instructionCache{ makeCache("L1I", config.instructionCache,
+                                firstLevel(l2Cache.get(), dram.get())) },
+    dataCache{ makeCache("L1D", config.dataCache,
+                         firstLevel(l2Cache.get(), dram.get())) },
+    instructionPrefetcher{ makePrefetchUnit(config.instructionPrefetcher,
+                                            instructionCache.get(),
+                                            bus, nCycles) },
+    dataPrefetcher{ makePrefetchUnit(config.dataPrefetcher, dataCache.get(),
+                                     bus, nCycles) },
+    storeBuffer{ makeStoreBuffer(config.storeBuffer, bus, dataCache.get(),
+                                 dataPrefetcher.get(), nCycles) },
+    instructionMemory{ bus, instructionCache.get(),
+                       instructionPrefetcher.get() },
+    dataMemory{ bus, dataCache.get(), dataPrefetcher.get(),
+                storeBuffer.get() },
+    pipeline{ config, debugMode, PC, instructionMemory, decoder,
+        regfile, flag, dataMemory, program.getSymbolTable() },
+    symbols{ program.getSymbolTable() }
+{
+  bus.setArbitration(config.busArbitration, nCycles);
+  const PlatformConfig &platform = config.platform;
+  bus.addClient(std::make_unique<Serial>(platform.serialBase, console));
+
+  auto status = std::make_unique<SysStatus>(platform.sysStatusBase, console);
   sysStatus = status.get();
   bus.addClient(std::move(status));
 
 #ifdef ENABLE_FRAMEBUFFER
-  bus.addClient(std::make_unique<Framebuffer>(0x800, 0x1000000));
+  bus.addClient(std::make_unique<Framebuffer>(platform.framebufferControl,
+                                              platform.framebufferBase,
+                                              platform.framebufferUpdate));
 #endif
 
   /* Initialize PC */
@@ -71,8 +199,17 @@ Processor::run(bool testMode)
     {
       try
         {
-          /* The "bus clock" runs at 1/5 the frequency of the Processor. */
-          if (nCycles % 5 == 0)
+          if (uint64_t stalled = pipeline.getStalledCycles();
+              skipStalls && stalled > 0)
+            {
+              skipCycles(stalled);
+              continue;
+            }
+
+          /* The "bus clock" runs at 1/busClockDivider the frequency
+           * of the Processor.
+           */
+          if (nCycles % busClockDivider == 0)
             bus.clockPulse();
 
           pipeline.propagate();
@@ -82,36 +219,74 @@ Processor::run(bool testMode)
       catch (TestEndMarkerEncountered &e)
         {
           if (testMode)
-            return true;
+            {
+              nCycles += drain();
+              return true;
+            }
           /* else */
-          std::cerr << "ABNORMAL PROGRAM TERMINATION; PC = "
+          console << "ABNORMAL PROGRAM TERMINATION; PC = "
                     << std::hex << PC << std::dec << std::endl;
-          std::cerr << "Reason: " << e.what() << std::endl;
+          console << "Reason: " << e.what() << std::endl;
           return false;
         }
       catch (InstructionFetchFailure &e)
         {
           if (testMode)
-            return true;
+            {
+              nCycles += drain();
+              return true;
+            }
           /* else */
-          std::cerr << "ABNORMAL PROGRAM TERMINATION; PC = "
+          console << "ABNORMAL PROGRAM TERMINATION; PC = "
                     << std::hex << PC << std::dec << std::endl;
-          std::cerr << "Reason: " << e.what() << std::endl;
+          console << "Reason: " << e.what() << std::endl;
           return false;
         }
       catch (std::exception &e)
         {
           /* Catch exceptions such as IllegalInstruction and InvalidAccess */
-          std::cerr << "ABNORMAL PROGRAM TERMINATION; PC = "
+          console << "ABNORMAL PROGRAM TERMINATION; PC = "
                     << std::hex << PC << std::dec << std::endl;
-          std::cerr << "Reason: " << e.what() << std::endl;
+          console << "Reason: " << e.what() << std::endl;
           return false;
         }
     }
 
+  nCycles += drain();
   return true;
 }
 
+/* Completes the instructions in flight at a halt. Buffered stores are
+ * written to memory as well, which does not hold up the processor.
+ */
+uint64_t
+Processor::drain()
+{
+  uint64_t cycles = pipeline.drain();
+
+  if (storeBuffer)
+    storeBuffer->flush();
+
+  return cycles;
+}
+
+/* While the entire pipeline waits for a long-latency event, only the
+ * countdown and the bus clock advance. Jump over those cycles at once,
+ * giving the bus the pulses it would have received.
+ */
+void
+Processor::skipCycles(uint64_t cycles)
+{
+  auto busPulsesBefore = [this](uint64_t cycle)
+    {
+      return (cycle + busClockDivider - 1) / busClockDivider;
+    };
+
+  bus.clockPulses(busPulsesBefore(nCycles + cycles) - busPulsesBefore(nCycles));
+  pipeline.skipCycles(cycles);
+  nCycles += cycles;
+}
+
 void
 Processor::dumpRegisters() const
 {
@@ -141,7 +316,67 @@ Processor::dumpStatistics() const
             << pipeline.getInstrIssued() << " instructions issued, "
             << pipeline.getInstrCompleted() << " instructions completed." << std::endl;
   if (pipeline.getPipelining())
-    std::cerr << pipeline.getStalls() << " stall cycles inserted." << std::endl;
+    {
+      std::cerr << pipeline.getStalls() << " stall cycles inserted." << std::endl;
+      const PipelineDepthConfig &depth = pipeline.getDepth();
+      if (depth.getDepth() != 5)
+        std::cerr << depth.getDepth() << "-stage pipeline ("
+                  << depth.getStageNames() << "), branch penalty "
+                  << depth.getBranchPenalty() << ", load-use penalty "
+                  << depth.getLoadUsePenalty() << " cycles." << std::endl;
+      if (depth.earlyBranches)
+        std::cerr << "Direct branches resolved in ID, misprediction penalty "
+                  << depth.getBranchPenalty() << " cycles, "
+                  << pipeline.getFlagStalls()
+                  << " stall cycles waiting for SR[F]." << std::endl;
+      if (pipeline.getDualIssue())
+        pipeline.getIssueStatistics().dump(std::cerr);
+      if (pipeline.getOutOfOrder())
+        pipeline.getOutOfOrderCore().dumpStatistics(std::cerr);
+      pipeline.getBranchPredictor().dumpStatistics(std::cerr, symbols);
+      pipeline.getFunctionalUnits().dumpStatistics(std::cerr, nCycles);
+    }
+  pipeline.getCycleAccounting().dumpStatistics(std::cerr);
+  if (instructionCache || dataCache)
+    std::cerr << pipeline.getFetchStalls() << " fetch stall cycles, "
+              << pipeline.getMemoryStalls() << " memory stall cycles."
+              << std::endl;
+  if (instructionCache)
+    instructionCache->dumpStatistics(std::cerr);
+  if (instructionPrefetcher)
+    instructionPrefetcher->dumpStatistics(std::cerr);
+  if (dataCache)
+    dataCache->dumpStatistics(std::cerr);
+  if (dataPrefetcher)
+    dataPrefetcher->dumpStatistics(std::cerr);
+  if (storeBuffer)
+    storeBuffer->dumpStatistics(std::cerr);
+  if (l2Cache)
+    l2Cache->dumpStatistics(std::cerr);
+  if (dram)
+    dram->dumpStatistics(std::cerr);
+  bus.dumpArbitrationStatistics(std::cerr);
   std::cerr << bus.getBytesRead() << " bytes read, "
             << bus.getBytesWritten() << " bytes written." << std::endl;
 }
+
+ProcessorSummary
+Processor::getSummary() const
+{
+  ProcessorSummary summary;
+
+  summary.cycles = nCycles;
+  summary.instructions = pipeline.getInstrCompleted();
+  summary.stalls = pipeline.getStalls();
+  if (pipeline.getPipelining())
+    summary.mispredictions =
+        pipeline.getBranchPredictor().getMispredictions();
+  if (instructionCache)
+    summary.instructionCacheMisses = instructionCache->getMisses();
+  if (dataCache)
+    summary.dataCacheMisses = dataCache->getMisses();
+  summary.bytesRead = bus.getBytesRead();
+  summary.bytesWritten = bus.getBytesWritten();
+
+  return summary;
+}
@@ -9,8 +9,8 @@
 
 #include <iostream>
 
-Serial::Serial(const MemAddress base)
-  : base{ base }
+Serial::Serial(const MemAddress base, std::ostream &console)
+  : base{ base }, console{ console }
 {
 }
 
@@ -49,7 +49,7 @@ Serial::writeByte(MemAddress addr, uint8_t value)
   if (addr != base)
     throw IllegalAccess("Invalid address");
 
-  std::cerr << static_cast<char>(value);
+  console << static_cast<char>(value);
 }
 
 void
@@ -75,3 +75,9 @@ Serial::contains(MemAddress addr) const
 {
   return base <= addr && addr < base + 1;
 }
+
+std::vector<AddressRange>
+Serial::getRanges() const
+{
+  return { { base, uint64_t{ base } + 1 } };
+}
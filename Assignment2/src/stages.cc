@@ -7,15 +7,154 @@
 
 #include "stages.h"
 #include "mux.h"
+#include <array>
 #include <iostream>
 
+/*
+ * Pipeline depth
+ */
+
+std::string
+PipelineDepthConfig::getStageNames() const
+{
+  std::string names = fetchStages > 1 ? "IF1 IF2 ID" : "IF ID";
+  if (registerRead)
+    names += " RR";
+  names += memoryStages > 1 ? " EX MEM1 MEM2 WB" : " EX MEM WB";
+  return names;
+}
+
+
+/*
+ * Hazard detection unit
+ */
+
+void
+HazardDetector::detect(RegNumber rs1, RegNumber rs2,
+                       const ID_EXRegisters *id_rr,
+                       const ID_EXRegisters &id_ex,
+                       const EX_MRegisters &ex_m,
+                       const M_WBRegisters *m_m2,
+                       const M_WBRegisters &m_wb)
+{
+  reset();
+
+  std::array<Producer, 5> producers{};
+  size_t count = 0;
+
+  if (id_rr)
+    producers[count++] = { id_rr->RD, &id_rr->CONTROL_SIGNALS,
+                           InputSelectorForward::RegisterFile };
+  producers[count++] = { id_ex.RD, &id_ex.CONTROL_SIGNALS,
+                         InputSelectorForward::RegisterFile };
+  producers[count++] = { ex_m.RD, &ex_m.CONTROL_SIGNALS,
+                         InputSelectorForward::EX_M };
+  if (m_m2)
+    producers[count++] = { m_m2->RD, &m_m2->CONTROL_SIGNALS,
+                           InputSelectorForward::M_M2 };
+  producers[count++] = { m_wb.RD, &m_wb.CONTROL_SIGNALS,
+                         InputSelectorForward::M_WB };
+
+  detect(rs1, producers.data(), count, id_rr != nullptr, forwardA, bypassA);
+  detect(rs2, producers.data(), count, id_rr != nullptr, forwardB, bypassB);
+}
+
+void
+HazardDetector::reset()
+{
+  forwardA = forwardB = InputSelectorForward::RegisterFile;
+  bypassA = bypassB = InputSelectorForward::RegisterFile;
+  stall = false;
+}
+
+/* Only the youngest producer of a register matters, so the pipeline
+ * registers are checked from EX towards WB. A producer that is i
+ * registers ahead of ID occupies register i + 1 + registerRead when
+ * the instruction reaches EX; the last register is M/WB.
+ */
+void
+HazardDetector::detect(RegNumber rs,
+                       const Producer *producers, size_t count,
+                       bool registerRead,
+                       InputSelectorForward &forward,
+                       InputSelectorForward &bypass)
+{
+  /* r0 is hard-wired to zero, writes to it are discarded. */
+  if (rs == 0)
+    return;
+
+  const size_t writeBack = count - 1;
+
+  for (size_t i = 0; i < count; ++i)
+    {
+      const Producer &producer = producers[i];
+      if (producer.rd != rs || ! producer.signals->regWriteInput())
+        continue;
+
+      const size_t ahead = i + 1 + registerRead;
+      if (ahead <= writeBack)
+        {
+          /* A loaded value only becomes available at the end of
+           * the last memory stage.
+           */
+          if (producer.signals->isReadOpBool() && ahead != writeBack)
+            stall = true;
+          else
+            forward = producers[ahead].source;
+        }
+      else if (ahead == writeBack + 1 && ! registerRead)
+        bypass = InputSelectorForward::M_WB;
+      return;
+    }
+}
+
+RegValue
+HazardDetector::getResult(const EX_MRegisters &ex_m)
+{
+  if (ex_m.CONTROL_SIGNALS.setLinkRegister())
+    return ex_m.PC;
+
+  return ex_m.ALU_OUTPUT;
+}
+
+RegValue
+HazardDetector::getResult(const M_WBRegisters &m_wb)
+{
+  if (m_wb.CONTROL_SIGNALS.setLinkRegister())
+    return m_wb.PC;
+
+  Mux<RegValue, InputSelectorWBStage> mux;
+  mux.setInput(InputSelectorWBStage::InputOne, m_wb.DATA_READ_FROM_MEMORY);
+  mux.setInput(InputSelectorWBStage::InputTwo, m_wb.ALU_RESULT);
+  mux.setSelector(m_wb.CONTROL_SIGNALS.isReadOp());
+
+  return mux.getOutput();
+}
+
+
 /*
  * Instruction fetch
  */
 
+BranchRedirect
+BranchRedirect::get(const EX_MRegisters &ex_m, const ID_EXRegisters *id_ex)
+{
+  if (id_ex && id_ex->BRANCH_DECISION == InputSelectorIFStage::InputTwo)
+    return { true, id_ex->PC, id_ex->BRANCH_PC, id_ex->SEQUENCE };
+
+  return { ex_m.BRANCH_DECISION == InputSelectorIFStage::InputTwo,
+           ex_m.PC, ex_m.BRANCH_PC, ex_m.SEQUENCE };
+}
+
 void
 InstructionFetchStage::propagate()
 {
+  if (pipelining)
+    {
+      propagatePipelined();
+      return;
+    }
+
   try
     {
 
@@ -25,6 +164,7 @@ InstructionFetchStage::propagate()
         instructionMemory.setSize(4);
         // std::cout << std::hex << PC << std::endl;
 
+        fetchPC = PC;
         PC += 4;
       }
       
@@ -60,13 +200,19 @@ InstructionFetchStage::propagate()
         instructionMemory.setSize(4);
         // std::cout << std::hex << PC << std::endl;
 
+        fetchPC = PC;
         PC += 4;
       }
       
       instr = instructionMemory.getValue();
-      /* Enable this once you have implemented instruction fetch. */
+      /* Like the pipelined modes, stop at the marker itself: it is
+       * not executed, so PC does not move past it.
+       */
       if (instr == TestEndMarker)
-        throw TestEndMarkerEncountered(PC);
+        {
+          PC = fetchPC;
+          throw TestEndMarkerEncountered(fetchPC);
+        }
 
     }
     catch (TestEndMarkerEncountered &e)
@@ -82,14 +228,191 @@ InstructionFetchStage::propagate()
 void
 InstructionFetchStage::clockPulse()
 {
-  HAZARD_DETECTOR;
+  if (pipelining)
+    {
+      clockPulsePipelined();
+      return;
+    }
+
   // OUTPUT Mux - mux.getOutput();
   if_id.PC = PC;
+  if_id.FETCH_PC = fetchPC;
   
   // OUTPUT Instruction Memory
   if_id.INSTRUCTION_WORD = instr;
+
+  const unsigned int portWait = instructionMemory.getPortWait();
+  waitCycles.add(portWait, CycleCategory::Structural, fetchPC);
+  waitCycles.add(instructionMemory.getLatency() - 1 - portWait,
+                 CycleCategory::ICacheMiss, fetchPC);
 }
 
+/* In pipelined mode the delay slot is simply the next sequential
+ * instruction. The branch predictor decides which instruction is
+ * fetched after the delay slot. The branch is verified in EX two cycles
+ * after it was fetched; on a misprediction the instruction fetched after
+ * the delay slot is squashed in ID and fetch is redirected.
+ */
+void
+InstructionFetchStage::propagatePipelined()
+{
+  const BranchRedirect branch = BranchRedirect::get(ex_m, id_ex);
+  bool redirect = branch.taken;
+
+  /* After an instruction cache miss, the delay slot may not have been
+   * passed to ID yet. Finish fetching it and redirect afterwards.
+   */
+  if (redirect && fetchSequence <= branch.sequence)
+    {
+      redirectAfterDelaySlot = true;
+      predictedTarget = branch.target;
+      redirect = false;
+    }
+
+  /* A pending prediction belongs to a branch on the wrong path. */
+  if (redirect)
+    redirectAfterDelaySlot = false;
+
+  if (pendingException)
+    {
+      if (! redirect)
+        {
+          if (drainCycles == 0)
+            std::rethrow_exception(pendingException);
+          return;
+        }
+
+      pendingException = nullptr;
+    }
+
+  Mux<MemAddress, InputSelectorIFStage> mux;
+  mux.setInput(InputSelectorIFStage::InputOne, PC);
+  mux.setInput(InputSelectorIFStage::InputTwo, branch.target);
+  mux.setSelector(redirect ? InputSelectorIFStage::InputTwo
+                           : InputSelectorIFStage::InputOne);
+
+  /* When held by a stall, the instruction was already fetched. */
+  if (holding && fetchPC == mux.getOutput())
+    return;
+
+  fetchPC = mux.getOutput();
+  prediction = BranchPrediction{};
+  fetchWait = 0;
+  fetchPortWait = 0;
+
+  try
+    {
+      instructionMemory.setAddress(fetchPC);
+      instructionMemory.setSize(4);
+      instr = instructionMemory.getValue();
+
+      if (instr == TestEndMarker)
+        throw TestEndMarkerEncountered(fetchPC);
+
+      fetchWait = instructionMemory.getLatency() - 1;
+      fetchPortWait = instructionMemory.getPortWait();
+
+      /* A delay slot cannot hold a branch. The link value is what
+       * l.jal writes to r9, see WriteBackStage.
+       */
+      if (! redirectAfterDelaySlot)
+        prediction = branchPredictor.predict(fetchPC, fetchPC + 4);
+    }
+  catch (TestEndMarkerEncountered &e)
+    {
+      pendingException = std::current_exception();
+    }
+  catch (std::exception &e)
+    {
+      pendingException =
+          std::make_exception_ptr(InstructionFetchFailure(fetchPC));
+    }
+
+  /* ID, EX, MEM and WB in the 5-stage pipeline */
+  if (pendingException)
+    drainCycles = stagesAfterFetch;
+}
+
+void
+InstructionFetchStage::clockPulsePipelined()
+{
+  if (fetchWait > 0)
+    {
+      /* Waiting for the bus port comes before the transfer. */
+      CycleCategory cause = CycleCategory::ICacheMiss;
+      if (fetchPortWait > 0)
+        {
+          --fetchPortWait;
+          cause = CycleCategory::Structural;
+        }
+
+      --fetchWait;
+      holding = true;
+      PC = fetchPC;
+      if (! HAZARD_DETECTOR.getStall())
+        {
+          if_id = IF_IDRegisters{};
+          if_id.BUBBLE_CAUSE = { cause, fetchPC };
+          ++nFetchStalls;
+        }
+      return;
+    }
+
+  holding = HAZARD_DETECTOR.getStall();
+  if (holding)
+    return;
+
+  if (pendingException)
+    {
+      if_id = IF_IDRegisters{};
+      if_id.BUBBLE_CAUSE = { CycleCategory::Drain, fetchPC };
+      --drainCycles;
+      return;
+    }
+
+  PC = fetchPC + 4;
+
+  if_id.PC = PC;
+  if_id.FETCH_PC = fetchPC;
+  if_id.INSTRUCTION_WORD = instr;
+  if_id.PREDICTION = prediction;
+  if_id.SEQUENCE = ++fetchSequence;
+
+  if (redirectAfterDelaySlot)
+    {
+      PC = predictedTarget;
+      redirectAfterDelaySlot = false;
+    }
+  else if (prediction.taken)
+    {
+      redirectAfterDelaySlot = true;
+      predictedTarget = prediction.target;
+    }
+}
+
+void
+InstructionFetch2Stage::propagate()
+{
+  REGS = if_if2;
+
+  /* Squashed like a wrong-path instruction in ID */
+  const BranchRedirect branch = BranchRedirect::get(ex_m, id_ex);
+  if (branch.taken && REGS.SEQUENCE > branch.sequence + 1)
+    {
+      REGS = IF_IDRegisters{};
+      REGS.BUBBLE_CAUSE = { CycleCategory::BranchMispredict, branch.PC - 4 };
+    }
+}
+
+void
+InstructionFetch2Stage::clockPulse()
+{
+  /* ID decodes the same instruction again, IF holds as well. */
+  if (HAZARD_DETECTOR.getStall())
+    return;
+
+  if_id = REGS;
+}
 
 
 
@@ -102,11 +425,64 @@ void
 dump_instruction(std::ostream &os, const uint32_t instructionWord,
                  const InstructionDecoder &decoder);
 
+bool
+setsFlag(ALUOp op)
+{
+  switch (op)
+    {
+      case ALUOp::EQ:
+      case ALUOp::NEQ:
+      case ALUOp::LT:
+      case ALUOp::LTE:
+      case ALUOp::GT:
+      case ALUOp::GTE:
+        return true;
+      default:
+        return false;
+    }
+}
+
+BranchKind
+getBranchKind(InstructionMnemonic mnemonic, RegNumber rb)
+{
+  switch (mnemonic)
+    {
+      case InstructionMnemonic::L_BF:
+      case InstructionMnemonic::L_BNF:
+        return BranchKind::Conditional;
+      case InstructionMnemonic::L_J:
+        return BranchKind::Jump;
+      case InstructionMnemonic::L_JAL:
+        return BranchKind::Call;
+      case InstructionMnemonic::L_JR:
+        return rb == 9 ? BranchKind::Return : BranchKind::Indirect;
+      default:
+        return BranchKind::None;
+    }
+}
+
 void
 InstructionDecodeStage::propagate()
 {
   // PC
   PC = if_id.PC;
+  PREDICTION = if_id.PREDICTION;
+  SEQUENCE = if_id.SEQUENCE;
+  BUBBLE_CAUSE = if_id.BUBBLE_CAUSE;
+
+  /* In pipelined mode, a mispredicted branch in EX/M means the instruction
+   * in ID was fetched on the wrong path, unless it is the delay slot. It
+   * is not decoded at all, since it may not even be a valid instruction.
+   */
+  FLUSH = pipelining &&
+      ex_m.BRANCH_DECISION == InputSelectorIFStage::InputTwo &&
+      SEQUENCE > ex_m.SEQUENCE + 1;
+  if (FLUSH)
+    {
+      HAZARD_DETECTOR.reset();
+      BUBBLE_CAUSE = { CycleCategory::BranchMispredict, ex_m.PC - 4 };
+      return;
+    }
 
   // decode instruction
   decoder.setInstructionWord(if_id.INSTRUCTION_WORD);
@@ -115,20 +491,65 @@ InstructionDecodeStage::propagate()
   CONTROL_SIGNALS.setFunctionCode(decoder.getFunctionCode());
 
   // Registers INPUT 1 - decoder.getA()
+  RegNumber RS1;
   try {
-    regfile.setRS1(decoder.getA());
+    RS1 = decoder.getA();
   } catch (IllegalInstruction &e) {
-    regfile.setRS1((RegNumber)MaxRegs);
+    RS1 = (RegNumber)MaxRegs;
     // the control signal rs1Input needs to return false;
   }
+  regfile.setRS1(RS1);
 
   // Registers INPUT 2 - decoder.getB()
+  RegNumber RS2;
   try {
-    regfile.setRS2(decoder.getB());
+    RS2 = decoder.getB();
   } catch (IllegalInstruction &e) {
-    regfile.setRS2((RegNumber)MaxRegs);
+    RS2 = (RegNumber)MaxRegs;
     // the control signal rs2Input needs to return false;
   }
+  regfile.setRS2(RS2);
+  RA = RS1;
+  RB = RS2;
+
+  BRANCH_KIND = getBranchKind(decoder.getFunctionCode(), RS2);
+
+  try {
+    RD = CONTROL_SIGNALS.setLinkRegister() ? 9 : decoder.getD();
+  } catch (IllegalInstruction &e) {
+    RD = (RegNumber) MaxRegs;
+  }
+
+  // Compare RS1 and RS2 against the destinations further down
+  if (pipelining)
+    {
+      HAZARD_DETECTOR.detect(RS1, RS2, rr_ex ? &id_ex : nullptr,
+                             rr_ex ? *rr_ex : id_ex, ex_m, m_m2, m_wb);
+      const bool loadUse = HAZARD_DETECTOR.getStall();
+
+      /* Wait for outstanding multi-cycle results that are read or
+       * overwritten, and for a busy unit in the next cycle.
+       */
+      FunctionalUnit *unit =
+          units.select(CONTROL_SIGNALS.getExecutionUnit());
+      if (unit && ! unit->isMultiCycle())
+        unit = nullptr;
+      UNIT = unit ? CONTROL_SIGNALS.getExecutionUnit() : ExecutionUnit::ALU;
+      /* The instruction reaches EX in the next cycle, or after RR. */
+      UNIT_BUSY = unit && ! unit->isFree(cycle + (rr_ex ? 2 : 1));
+
+      const bool pending = units.isPending(RS1) || units.isPending(RS2) ||
+          (CONTROL_SIGNALS.regWriteInput() && units.isPending(RD));
+      FLAG_PENDING = branchPredictor &&
+          BRANCH_KIND == BranchKind::Conditional && isFlagPending();
+      if (pending || FLAG_PENDING || UNIT_BUSY)
+        HAZARD_DETECTOR.hold();
+
+      if (HAZARD_DETECTOR.getStall())
+        BUBBLE_CAUSE = { loadUse ? CycleCategory::LoadUse
+                         : pending || FLAG_PENDING ? CycleCategory::DataHazard
+                         : CycleCategory::Structural, PC - 4 };
+    }
 
   // Registers INPUT 3 - RD (the register we want to write data to)
   // handled in the WB stage
@@ -144,6 +565,80 @@ InstructionDecodeStage::propagate()
     // the control signal immediateInput needs to return false;
   }
 
+  if (pipelining && branchPredictor)
+    resolveBranch();
+}
+
+/* SR[F] is read from EX/M. A compare that has not passed EX yet must
+ * execute first.
+ */
+bool
+InstructionDecodeStage::isFlagPending() const
+{
+  auto setsFlagAhead = [](const ID_EXRegisters &regs)
+    {
+      return regs.PC != 0 && setsFlag(regs.CONTROL_SIGNALS.AluOp());
+    };
+
+  return setsFlagAhead(id_ex) || (rr_ex && setsFlagAhead(*rr_ex));
+}
+
+/* Resolves l.bf, l.bnf, l.j and l.jal like EX would, see
+ * ExecuteStage::propagateBranch(). The target is computed by an adder
+ * of ID, as SHIFT_ADD in the ALU.
+ */
+void
+InstructionDecodeStage::resolveBranch()
+{
+  BRANCH_RESOLVED = false;
+  BRANCH_DECISION = InputSelectorIFStage::InputOne;
+
+  if (PC == 0 || HAZARD_DETECTOR.getStall())
+    return;
+  if (BRANCH_KIND != BranchKind::Conditional &&
+      BRANCH_KIND != BranchKind::Jump && BRANCH_KIND != BranchKind::Call)
+    return;
+
+  BRANCH_TARGET = (PC - 4) + (SIGN_EXTENDED_IMMEDIATE << 2);
+  BRANCH_TAKEN = CONTROL_SIGNALS.jump(ex_m.FLAG);
+
+  const RegValue actual = BRANCH_TAKEN ? BRANCH_TARGET : PC + 4;
+  const RegValue predicted = PREDICTION.taken ? PREDICTION.target : PC + 4;
+
+  BRANCH_RESOLVED = true;
+  BRANCH_PC = actual;
+  PREDICTION_CORRECT = actual == predicted;
+  BRANCH_DECISION = PREDICTION_CORRECT ? InputSelectorIFStage::InputOne
+                                       : InputSelectorIFStage::InputTwo;
+}
+
+void InstructionDecodeStage::clockPulse()
+{
+  /* Squashed or stalled: insert a bubble. When stalled, IF holds so
+   * that this instruction is decoded again in the next cycle.
+   */
+  if (FLUSH || HAZARD_DETECTOR.getStall())
+    {
+      if (! FLUSH)
+        ++nStalls;
+      if (! FLUSH && UNIT_BUSY)
+        units.select(UNIT)->addStall();
+      if (! FLUSH && FLAG_PENDING)
+        ++nFlagStalls;
+
+      id_ex = ID_EXRegisters{};
+      id_ex.BUBBLE_CAUSE = BUBBLE_CAUSE;
+      return;
+    }
+
+  FunctionalUnit *unit = units.select(UNIT);
+  if (pipelining && unit)
+    {
+      unit->issue(cycle + (rr_ex ? 2 : 1));
+      if (CONTROL_SIGNALS.regWriteInput() && RD != 0 && RD < NumRegs)
+        units.reserve(SEQUENCE, *unit, RD);
+    }
+
   /* debug mode: dump decoded instructions to cerr.
    * In case of no pipelining: always dump.
    * In case of pipelining: special case, if the PC == 0x0 (so on the
@@ -159,42 +654,63 @@ InstructionDecodeStage::propagate()
       std::cerr << std::hex << std::showbase << PC << "\t";
       std::cerr.setf(storeFlags);
 
+      std::string symbol = symbols.format(PC);
+      if (!symbol.empty())
+        std::cerr << "<" << symbol << ">\t";
+
       std::cerr << decoder << std::endl;
     }
 
-
-
-}
-
-void InstructionDecodeStage::clockPulse()
-{
-  HAZARD_DETECTOR;
-
   // PC
   id_ex.PC = PC;
 
   id_ex.CONTROL_SIGNALS = CONTROL_SIGNALS;
 
-  // Registers OUTPUT 1
-  id_ex.RS1 = regfile.getReadData1();
+  // Registers OUTPUT 1, bypassed when the register is written back
+  // in this very cycle
+  Mux<RegValue, InputSelectorForward> bypass1;
+  bypass1.setInput(InputSelectorForward::RegisterFile, regfile.getReadData1());
+  bypass1.setInput(InputSelectorForward::EX_M, 0);
+  bypass1.setInput(InputSelectorForward::M_WB, HazardDetector::getResult(m_wb));
+  bypass1.setSelector(pipelining ? HAZARD_DETECTOR.getBypassA()
+                                 : InputSelectorForward::RegisterFile);
+  id_ex.RS1 = bypass1.getOutput();
+
   // Registers OUTPUT 2
-  id_ex.RS2 = regfile.getReadData2();
+  Mux<RegValue, InputSelectorForward> bypass2;
+  bypass2.setInput(InputSelectorForward::RegisterFile, regfile.getReadData2());
+  bypass2.setInput(InputSelectorForward::EX_M, 0);
+  bypass2.setInput(InputSelectorForward::M_WB, HazardDetector::getResult(m_wb));
+  bypass2.setSelector(pipelining ? HAZARD_DETECTOR.getBypassB()
+                                 : InputSelectorForward::RegisterFile);
+  id_ex.RS2 = bypass2.getOutput();
+
+  // Forwarding into EX
+  if (pipelining)
+    {
+      id_ex.FORWARD_A = HAZARD_DETECTOR.getForwardA();
+      id_ex.FORWARD_B = HAZARD_DETECTOR.getForwardB();
+
+      id_ex.RA = RA;
+      id_ex.RB = RB;
+      id_ex.PREDICTION = PREDICTION;
+      id_ex.BRANCH_KIND = BRANCH_KIND;
+      id_ex.SEQUENCE = SEQUENCE;
+      id_ex.BUBBLE_CAUSE = BUBBLE_CAUSE;
+
+      id_ex.BRANCH_RESOLVED = BRANCH_RESOLVED;
+      id_ex.BRANCH_PC = BRANCH_PC;
+      id_ex.BRANCH_DECISION = BRANCH_DECISION;
+      if (BRANCH_RESOLVED)
+        branchPredictor->resolve(PC - 4, BRANCH_KIND, BRANCH_TAKEN,
+                                 BRANCH_TARGET, PREDICTION_CORRECT);
+    }
 
   // Sign Extend OUTPUT 1
   id_ex.IMMEDIATE = SIGN_EXTENDED_IMMEDIATE;
 
-  // Register RD
-  try {
-    // set rd to 9
-    if (CONTROL_SIGNALS.setLinkRegister()) {
-      // set link register
-      id_ex.RD = 9;
-    } else {
-      id_ex.RD = decoder.getD();
-    }
-  } catch (IllegalInstruction &e) {
-    id_ex.RD = (RegNumber) MaxRegs;
-  }
+  // Register RD, r9 for the link register
+  id_ex.RD = RD;
 
   /* ignore the "instruction" in the first cycle. */
   if (! pipelining || (pipelining && PC != 0x0))
@@ -204,6 +720,56 @@ void InstructionDecodeStage::clockPulse()
 
 
 
+/*
+ * Register read
+ */
+
+void
+RegisterReadStage::propagate()
+{
+  REGS = id_rr;
+
+  /* Squashed like a wrong-path instruction in ID */
+  if (ex_m.BRANCH_DECISION == InputSelectorIFStage::InputTwo &&
+      REGS.SEQUENCE > ex_m.SEQUENCE + 1)
+    {
+      REGS = ID_EXRegisters{};
+      REGS.BUBBLE_CAUSE = { CycleCategory::BranchMispredict, ex_m.PC - 4 };
+      return;
+    }
+
+  if (REGS.RA < NumRegs)
+    regfile.setRS3(REGS.RA);
+  if (REGS.RB < NumRegs)
+    regfile.setRS4(REGS.RB);
+}
+
+/* Registers that ID could not decode keep the value read in ID. */
+RegValue
+RegisterReadStage::readOperand(RegNumber reg, RegValue value) const
+{
+  if (reg == 0 || reg >= NumRegs)
+    return value;
+
+  if (m_wb.RD == reg && m_wb.CONTROL_SIGNALS.regWriteInput())
+    return HazardDetector::getResult(m_wb);
+
+  return reg == REGS.RA ? regfile.getReadData3() : regfile.getReadData4();
+}
+
+void
+RegisterReadStage::clockPulse()
+{
+  if (REGS.PC != 0)
+    {
+      REGS.RS1 = readOperand(REGS.RA, REGS.RS1);
+      REGS.RS2 = readOperand(REGS.RB, REGS.RS2);
+    }
+
+  id_ex = REGS;
+}
+
+
 /*
  * Execute
  */
@@ -219,24 +785,41 @@ ExecuteStage::propagate()
   // PC
   PC = id_ex.PC;
   CONTROL_SIGNALS = id_ex.CONTROL_SIGNALS;
+  BUBBLE_CAUSE = id_ex.BUBBLE_CAUSE;
+
+  // INPUT Forward Mux - id_ex.RS1 / EX->EX / MEM->EX / MEM2->EX
+  Mux<RegValue, InputSelectorForward> forward1;
+  forward1.setInput(InputSelectorForward::RegisterFile, id_ex.RS1);
+  forward1.setInput(InputSelectorForward::EX_M, HazardDetector::getResult(ex_m));
+  forward1.setInput(InputSelectorForward::M_M2, HazardDetector::getResult(m_m2));
+  forward1.setInput(InputSelectorForward::M_WB, HazardDetector::getResult(m_wb));
+  forward1.setSelector(id_ex.FORWARD_A);
+
+  // INPUT Forward Mux - id_ex.RS2 / EX->EX / MEM->EX / MEM2->EX
+  Mux<RegValue, InputSelectorForward> forward2;
+  forward2.setInput(InputSelectorForward::RegisterFile, id_ex.RS2);
+  forward2.setInput(InputSelectorForward::EX_M, HazardDetector::getResult(ex_m));
+  forward2.setInput(InputSelectorForward::M_M2, HazardDetector::getResult(m_m2));
+  forward2.setInput(InputSelectorForward::M_WB, HazardDetector::getResult(m_wb));
+  forward2.setSelector(id_ex.FORWARD_B);
 
 
   // INPUT Mux - id_ex.PC
-  // INPUT Mux - id_ex.RS1
+  // INPUT Mux - forward1.getOutput()
   // INPUT Mux (implicit) - CONTROL_SIGNALS.AInput()
   // OUTPUT Mux - mux.getOutput();
   Mux<RegValue, InputSelectorEXStage> mux1;
   mux1.setInput(InputSelectorEXStage::InputOne, PC);
-  mux1.setInput(InputSelectorEXStage::InputTwo, id_ex.RS1);
+  mux1.setInput(InputSelectorEXStage::InputTwo, forward1.getOutput());
   mux1.setSelector(CONTROL_SIGNALS.AInput());
   
 
-  // INPUT Mux - id_ex.RS2
+  // INPUT Mux - forward2.getOutput()
   // INPUT Mux - id_ex.IMMEDIATE
   // INPUT Mux (implicit) - NEXT_PC
   // OUTPUT Mux - CONTROL_SIGNALS.BInput()
   Mux<RegValue, InputSelectorEXStage> mux2;
-  mux2.setInput(InputSelectorEXStage::InputOne, id_ex.RS2);
+  mux2.setInput(InputSelectorEXStage::InputOne, forward2.getOutput());
   mux2.setInput(InputSelectorEXStage::InputTwo, id_ex.IMMEDIATE);
   mux2.setSelector(CONTROL_SIGNALS.BInput());
 
@@ -269,7 +852,9 @@ ExecuteStage::propagate()
   if (BRANCH_DELAY_SLOT) {
     BRANCH_DELAY_SLOT = false;
   }
-  if (CONTROL_SIGNALS.jump(FLAG)){
+  if (pipelining) {
+    propagateBranch();
+  } else if (CONTROL_SIGNALS.jump(FLAG)){
     // std::cout << "We BRANCH" << std::endl;
     BRANCH_DECISION = InputSelectorIFStage::InputTwo;
     BRANCH_DELAY_SLOT = true;
@@ -280,12 +865,43 @@ ExecuteStage::propagate()
 
 
   // RS2
-  RS2 = id_ex.RS2;
+  RS2 = forward2.getOutput();
 
   // RD
   RD = id_ex.RD;
 }
 
+/* Compare the address fetched after the delay slot against the actual
+ * outcome. PC is the address of the branch plus 4, so the instruction
+ * after the delay slot is at PC + 4.
+ */
+void
+ExecuteStage::propagateBranch()
+{
+  /* Already resolved in ID */
+  BRANCH_KIND = id_ex.BRANCH_RESOLVED ? BranchKind::None : id_ex.BRANCH_KIND;
+  SEQUENCE = id_ex.SEQUENCE;
+  BRANCH_TAKEN = CONTROL_SIGNALS.jump(FLAG);
+
+  Mux<RegValue, InputSelectorIFStage> actual;
+  actual.setInput(InputSelectorIFStage::InputOne, PC + 4);
+  actual.setInput(InputSelectorIFStage::InputTwo, alu.getResult());
+  actual.setSelector(BRANCH_TAKEN ? InputSelectorIFStage::InputTwo
+                                  : InputSelectorIFStage::InputOne);
+
+  Mux<RegValue, InputSelectorIFStage> predicted;
+  predicted.setInput(InputSelectorIFStage::InputOne, PC + 4);
+  predicted.setInput(InputSelectorIFStage::InputTwo, id_ex.PREDICTION.target);
+  predicted.setSelector(id_ex.PREDICTION.taken ? InputSelectorIFStage::InputTwo
+                                               : InputSelectorIFStage::InputOne);
+
+  BRANCH_PC = actual.getOutput();
+  PREDICTION_CORRECT = PC == 0 || id_ex.BRANCH_RESOLVED ||
+      actual.getOutput() == predicted.getOutput();
+  BRANCH_DECISION = PREDICTION_CORRECT ? InputSelectorIFStage::InputOne
+                                       : InputSelectorIFStage::InputTwo;
+}
+
 void
 ExecuteStage::clockPulse()
 {
@@ -293,8 +909,6 @@ ExecuteStage::clockPulse()
    * includes the result (output) of the ALU. For memory-operations
    * the ALU computes the effective memory address.
    */
-  HAZARD_DETECTOR;
-
   // PC
   ex_m.PC = PC;
 
@@ -303,11 +917,19 @@ ExecuteStage::clockPulse()
 
   // Equality test
   ex_m.BRANCH_DECISION = BRANCH_DECISION;
+  ex_m.BRANCH_PC = BRANCH_PC;
+  ex_m.SEQUENCE = SEQUENCE;
+  ex_m.BUBBLE_CAUSE = BUBBLE_CAUSE;
+
+  if (pipelining && BRANCH_KIND != BranchKind::None)
+    branchPredictor.resolve(PC - 4, BRANCH_KIND, BRANCH_TAKEN,
+                            alu.getResult(), PREDICTION_CORRECT);
 
   ex_m.BRANCH_DELAY_SLOT = BRANCH_DELAY_SLOT;
 
   // ALU 
   ex_m.ALU_OUTPUT = alu.getResult();
+  ex_m.FLAG = alu.getFlag();
 
   // RS2
   ex_m.RS2 = RS2;
@@ -315,6 +937,24 @@ ExecuteStage::clockPulse()
   // RD
   ex_m.RD = RD;
 
+  /* A multi-cycle result was reserved in ID and is written back by
+   * FunctionalUnits; it leaves EX as if writing r0.
+   */
+  FunctionalUnit *unit = units.select(CONTROL_SIGNALS.getExecutionUnit());
+  if (unit && unit->isMultiCycle() && PC != 0)
+    {
+      if (! pipelining)
+        {
+          unit->issue(cycle);
+          waitCycles.add(unit->getLatency() - 1,
+                         CycleCategory::Structural, PC - 4);
+        }
+      else
+        {
+          units.complete(SEQUENCE, alu.getResult(), cycle);
+          ex_m.RD = 0;
+        }
+    }
 }
 
 /*
@@ -330,11 +970,13 @@ MemoryStage::propagate()
 
   PC = ex_m.PC;
   CONTROL_SIGNALS = ex_m.CONTROL_SIGNALS;
+  BUBBLE_CAUSE = ex_m.BUBBLE_CAUSE;
   RegValue DATA = ex_m.RS2;
   RegValue EFFECTIVE_ADDRESS = ex_m.ALU_OUTPUT;
 
   
 
+  dataMemory.setPC(PC);
   dataMemory.setDataIn(DATA);
   dataMemory.setAddress(EFFECTIVE_ADDRESS);
 
@@ -371,7 +1013,6 @@ MemoryStage::clockPulse()
 
   /* TODO: write necessary fields in pipeline register */
 
-  HAZARD_DETECTOR;
   m_wb.PC = PC;
 
   m_wb.DATA_READ_FROM_MEMORY = DATA_READ_FROM_MEMORY;
@@ -384,8 +1025,17 @@ MemoryStage::clockPulse()
 
   // CONTROL SIGNALS
   m_wb.CONTROL_SIGNALS = CONTROL_SIGNALS;
+  m_wb.BUBBLE_CAUSE = BUBBLE_CAUSE;
 
   dataMemory.clockPulse();
+
+  if (CONTROL_SIGNALS.isReadOpBool() || CONTROL_SIGNALS.isWriteOpBool())
+    {
+      const unsigned int portWait = dataMemory.getPortWait();
+      waitCycles.add(portWait, CycleCategory::Structural, PC - 4);
+      waitCycles.add(dataMemory.getLatency() - 1 - portWait,
+                     CycleCategory::DCacheMiss, PC - 4);
+    }
 }
 
 /*
@@ -427,12 +1077,25 @@ WriteBackStage::propagate()
   } else {
     regfile.setWriteEnable(false);
   }
+
+  /* Oldest available multi-cycle result, written after port 1. */
+  const FunctionalUnits::Result *result = units.getCompleted(cycle);
+  COMPLETED = result != nullptr;
+  if (COMPLETED)
+    {
+      COMPLETED_SEQUENCE = result->sequence;
+      regfile.setRD2(result->rd);
+      regfile.setWriteData2(result->value);
+    }
+  regfile.setWriteEnable2(COMPLETED);
 }
 
 void
 WriteBackStage::clockPulse()
 {
   /* TODO: pulse the register file */
-  HAZARD_DETECTOR;
   regfile.clockPulse();
+
+  if (COMPLETED)
+    units.retire(COMPLETED_SEQUENCE);
 }
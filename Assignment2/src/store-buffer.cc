@@ -0,0 +1,190 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    store-buffer.cc - Write-combining store buffer.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "store-buffer.h"
+
+#include <algorithm>
+#include <iomanip>
+
+static constexpr MemAddress WordMask = ~MemAddress{ 3 };
+
+StoreBuffer::StoreBuffer(const StoreBufferConfig &config, MemoryBus &bus,
+                         Cache *cache, PrefetchUnit *prefetcher,
+                         const uint64_t &clock)
+  : config{ config }, bus{ bus }, cache{ cache }, prefetcher{ prefetcher },
+    clock{ clock }
+{
+}
+
+StoreBuffer::Entry *
+StoreBuffer::find(MemAddress word)
+{
+  for (auto &entry : entries)
+    if (entry.word == word)
+      return &entry;
+
+  return nullptr;
+}
+
+/* Writes the entries that are due by now. */
+void
+StoreBuffer::update()
+{
+  while (! entries.empty())
+    {
+      uint64_t start = std::max(busyUntil,
+                                entries.front().opened + config.combineCycles);
+      if (start > clock)
+        break;
+
+      writeOldest(start);
+    }
+}
+
+void
+StoreBuffer::writeOldest(uint64_t start)
+{
+  const Entry entry = entries.front();
+  entries.pop_front();
+
+  unsigned int latency = 1;
+  if (cache)
+    latency = prefetcher ? prefetcher->access(entry.pc, entry.word, true)
+                         : cache->access(entry.word, true);
+  busyUntil = start + latency;
+
+  /* Memory is big endian */
+  if (entry.mask == 0xf)
+    {
+      bus.writeWord(entry.word, uint32_t{ entry.data[0] } << 24 |
+                                uint32_t{ entry.data[1] } << 16 |
+                                uint32_t{ entry.data[2] } << 8 |
+                                entry.data[3]);
+      ++nBusWrites;
+      return;
+    }
+
+  for (unsigned int i = 0; i < 4; i += 2)
+    {
+      const uint8_t half = (entry.mask >> i) & 0x3;
+
+      if (half == 0x3)
+        {
+          bus.writeHalfWord(entry.word + i,
+                            uint16_t(entry.data[i] << 8 | entry.data[i + 1]));
+          ++nBusWrites;
+          continue;
+        }
+
+      for (unsigned int j = i; j < i + 2; ++j)
+        if (entry.mask & (1 << j))
+          {
+            bus.writeByte(entry.word + j, entry.data[j]);
+            ++nBusWrites;
+          }
+    }
+}
+
+unsigned int
+StoreBuffer::store(MemAddress pc, MemAddress addr, uint8_t size,
+                   uint64_t value)
+{
+  update();
+  ++nStores;
+
+  /* Cycle in which the store has found room in the buffer */
+  uint64_t ready = clock;
+  bool combined = true;
+
+  for (uint8_t i = 0; i < size; ++i)
+    {
+      const MemAddress byteAddr = addr + i;
+      Entry *entry = find(byteAddr & WordMask);
+
+      if (! entry)
+        {
+          combined = false;
+          if (entries.size() >= config.entries)
+            {
+              writeOldest(std::max(busyUntil, ready));
+              ready = busyUntil;
+            }
+
+          entries.push_back(Entry{ byteAddr & WordMask, pc, {}, 0, ready });
+          entry = &entries.back();
+        }
+
+      const unsigned int offset = byteAddr & 0x3;
+      entry->data[offset] = value >> (8 * (size - 1 - i));
+      entry->mask |= 1 << offset;
+      entry->pc = pc;
+    }
+
+  if (combined)
+    ++nCombined;
+  nFullCycles += ready - clock;
+
+  return 1 + (ready - clock);
+}
+
+uint64_t
+StoreBuffer::forward(MemAddress addr, uint8_t size, uint64_t value,
+                     bool &covered)
+{
+  /* Entries that are due are written by the next store; until then
+   * they still hold the newest data.
+   */
+  covered = true;
+
+  for (uint8_t i = 0; i < size; ++i)
+    {
+      const MemAddress byteAddr = addr + i;
+      const unsigned int offset = byteAddr & 0x3;
+      const Entry *entry = find(byteAddr & WordMask);
+
+      if (! entry || ! (entry->mask & (1 << offset)))
+        {
+          covered = false;
+          continue;
+        }
+
+      const unsigned int shift = 8 * (size - 1 - i);
+      value = (value & ~(uint64_t{ 0xff } << shift)) |
+          uint64_t{ entry->data[offset] } << shift;
+    }
+
+  if (covered)
+    ++nForwarded;
+
+  return value;
+}
+
+uint64_t
+StoreBuffer::flush()
+{
+  while (! entries.empty())
+    writeOldest(std::max(busyUntil, clock));
+
+  return busyUntil > clock ? busyUntil - clock : 0;
+}
+
+void
+StoreBuffer::dumpStatistics(std::ostream &os) const
+{
+  auto storeFlags(os.flags());
+  const int64_t saved = static_cast<int64_t>(nStores) -
+      static_cast<int64_t>(nBusWrites);
+
+  os << "Store buffer: " << nStores << " stores, " << nCombined
+     << " combined (" << std::fixed << std::setprecision(2)
+     << (nStores > 0 ? 100.0 * nCombined / nStores : 0.0) << "%), "
+     << nBusWrites << " bus writes, " << saved
+     << " bus transactions saved." << std::endl;
+  os << "  " << nForwarded << " loads forwarded, " << nFullCycles
+     << " cycles waiting for a free entry." << std::endl;
+  os.flags(storeFlags);
+}
@@ -0,0 +1,223 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    sweep.cc - Design-space sweep over machine configurations.
+ *
+ * Copyright (C) 2016-2021  Leiden University, The Netherlands.
+ */
+
+#include "sweep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+bool
+parseSweepPoint(std::string_view line, const MachineConfig &base,
+                SweepPoint &point)
+{
+  line = line.substr(0, line.find('#'));
+
+  std::istringstream settings{ std::string{ line } };
+  std::string setting;
+
+  point.label.clear();
+  point.config = base;
+
+  while (settings >> setting)
+    {
+      point.config.set(setting);
+      point.label += (point.label.empty() ? "" : " ") + setting;
+    }
+
+  return ! point.label.empty();
+}
+
+
+Sweep::Sweep(const ELFFile &program, std::vector<SweepPoint> points,
+             const std::vector<RegisterInit> &initializers)
+  : program{ program }, points{ std::move(points) },
+    initializers{ initializers }
+{
+}
+
+std::vector<SweepPoint>
+Sweep::readFile(const std::string &filename, const MachineConfig &base)
+{
+  std::ifstream file(filename);
+  if (! file)
+    throw std::runtime_error("Could not open sweep file " + filename);
+
+  std::vector<SweepPoint> points;
+  std::string line;
+  size_t lineNumber = 0;
+
+  while (std::getline(file, line))
+    {
+      SweepPoint point;
+      ++lineNumber;
+
+      try
+        {
+          if (parseSweepPoint(line, base, point))
+            {
+              point.config.validate();
+              points.push_back(std::move(point));
+            }
+        }
+      catch (std::invalid_argument &e)
+        {
+          throw std::invalid_argument(filename + ":" +
+                                      std::to_string(lineNumber) + ": " +
+                                      e.what());
+        }
+      catch (std::out_of_range &e)
+        {
+          throw std::out_of_range(filename + ":" +
+                                  std::to_string(lineNumber) + ": " +
+                                  e.what());
+        }
+    }
+
+  if (points.empty())
+    throw std::invalid_argument("No configurations in " + filename);
+
+  return points;
+}
+
+/* Runs on a worker thread. Everything the program prints is kept
+ * apart per simulation; only the reason of a failure is reported.
+ */
+Sweep::Result
+Sweep::simulate(const SweepPoint &point) const
+{
+  Result result;
+  std::ostringstream console;
+
+  try
+    {
+      Processor p(program, point.config, false, console);
+
+      for (auto &initializer : initializers)
+        p.initRegister(initializer.number, initializer.value);
+
+      result.completed = p.run();
+      result.summary = p.getSummary();
+
+      if (! result.completed)
+        {
+          std::string output = console.str();
+          size_t pos = output.rfind("Reason: ");
+          result.error = pos != std::string::npos
+              ? output.substr(pos, output.find('\n', pos) - pos)
+              : "abnormal program termination";
+        }
+    }
+  catch (std::out_of_range &e)
+    {
+      result.error = std::string{ "Out of range parameter: " } + e.what();
+    }
+  catch (std::exception &e)
+    {
+      result.error = e.what();
+    }
+
+  return result;
+}
+
+bool
+Sweep::run(unsigned int threads)
+{
+  if (threads == 0)
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+  threads = std::min<size_t>(threads, points.size());
+
+  results.assign(points.size(), Result{});
+
+  /* Every worker takes the next configuration until none are left, so
+   * that long simulations do not hold up the others.
+   */
+  std::atomic<size_t> next{ 0 };
+  auto worker = [this, &next]()
+    {
+      for (size_t i = next++; i < points.size(); i = next++)
+        results[i] = simulate(points[i]);
+    };
+
+  std::vector<std::thread> pool;
+  for (unsigned int i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+
+  for (auto &thread : pool)
+    thread.join();
+
+  return std::all_of(results.begin(), results.end(),
+                     [](const Result &r) { return r.completed; });
+}
+
+void
+Sweep::dumpResults(std::ostream &os) const
+{
+  auto storeFlags(os.flags());
+
+  size_t labelWidth = std::string_view{ "configuration" }.size();
+  for (const auto &point : points)
+    labelWidth = std::max(labelWidth, point.label.size());
+
+  /* Columns that do not apply to a configuration show "-". */
+  auto column = [&os](bool present, uint64_t value)
+    {
+      os << "  " << std::setw(10);
+      if (present)
+        os << value;
+      else
+        os << "-";
+    };
+
+  os << std::left << std::setw(labelWidth) << "configuration" << std::right
+     << "  " << std::setw(10) << "cycles"
+     << "  " << std::setw(10) << "instrs"
+     << "  " << std::setw(6) << "CPI"
+     << "  " << std::setw(10) << "stalls"
+     << "  " << std::setw(10) << "mispredict"
+     << "  " << std::setw(10) << "L1I misses"
+     << "  " << std::setw(10) << "L1D misses" << std::endl;
+
+  for (size_t i = 0; i < points.size(); ++i)
+    {
+      const SweepPoint &point = points[i];
+      const Result &result = results.at(i);
+      const ProcessorSummary &summary = result.summary;
+
+      os << std::left << std::setw(labelWidth) << point.label << std::right;
+      if (! result.error.empty() && summary.cycles == 0)
+        {
+          os << "  " << result.error << std::endl;
+          continue;
+        }
+
+      os << "  " << std::setw(10) << summary.cycles
+         << "  " << std::setw(10) << summary.instructions << "  "
+         << std::setw(6) << std::fixed << std::setprecision(3);
+      if (summary.instructions > 0)
+        os << double(summary.cycles) / summary.instructions;
+      else
+        os << "-";
+      os.flags(storeFlags);
+
+      column(point.config.pipelining, summary.stalls);
+      column(point.config.pipelining, summary.mispredictions);
+      column(point.config.instructionCache.size > 0,
+             summary.instructionCacheMisses);
+      column(point.config.dataCache.size > 0, summary.dataCacheMisses);
+      if (! result.completed)
+        os << "  (" << result.error << ")";
+      os << std::endl;
+    }
+
+  os.flags(storeFlags);
+}
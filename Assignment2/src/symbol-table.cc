@@ -0,0 +1,106 @@
+/* rv64-emu -- Simple 64-bit RISC-V simulator
+ *
+ *    symbol-table.cc - Address to symbol lookup.
+ *
+ * Copyright (C) 2016  Leiden University, The Netherlands.
+ */
+
+#include "symbol-table.h"
+
+#include <algorithm>
+#include <sstream>
+
+void
+SymbolTable::clear()
+{
+  symbols.clear();
+}
+
+void
+SymbolTable::addSymbol(MemAddress address, size_t size,
+                       std::string_view name)
+{
+  symbols.push_back(Symbol{ address, size, std::string{ name } });
+}
+
+void
+SymbolTable::finalize()
+{
+  /* Sort on address. When several symbols share an address, the one
+   * with the largest size comes first and is the one we keep, so that
+   * e.g. "main" wins over a label without size.
+   */
+  std::stable_sort(symbols.begin(), symbols.end(),
+                   [](const Symbol &a, const Symbol &b)
+                   {
+                     if (a.address != b.address)
+                       return a.address < b.address;
+                     return a.size > b.size;
+                   });
+
+  auto last = std::unique(symbols.begin(), symbols.end(),
+                          [](const Symbol &a, const Symbol &b)
+                          {
+                            return a.address == b.address;
+                          });
+  symbols.erase(last, symbols.end());
+  symbols.shrink_to_fit();
+}
+
+const Symbol *
+SymbolTable::lookup(MemAddress addr, const Symbol *hint) const
+{
+  if (hint && contains(*hint, addr))
+    return hint;
+
+  auto it = std::upper_bound(symbols.begin(), symbols.end(), addr,
+                             [](MemAddress a, const Symbol &s)
+                             {
+                               return a < s.address;
+                             });
+  if (it == symbols.begin())
+    return nullptr;
+
+  --it;
+  if (!contains(*it, addr))
+    return nullptr;
+
+  return &*it;
+}
+
+std::string
+SymbolTable::format(MemAddress addr) const
+{
+  const Symbol *symbol = lookup(addr);
+  if (!symbol)
+    return std::string{};
+
+  std::stringstream ss;
+  ss << symbol->name;
+  if (addr != symbol->address)
+    ss << "+0x" << std::hex << (addr - symbol->address);
+
+  return ss.str();
+}
+
+/*
+ * Private methods
+ */
+bool
+SymbolTable::contains(const Symbol &symbol, MemAddress addr) const
+{
+  if (addr < symbol.address)
+    return false;
+
+  if (symbol.size > 0)
+    return addr - symbol.address < symbol.size;
+
+  /* Symbols without size extend up to the next symbol. The final
+   * symbol only covers its own address.
+   */
+  size_t index = &symbol - symbols.data();
+  if (index + 1 < symbols.size())
+    return addr < symbols[index + 1].address;
+
+  return addr == symbol.address;
+}
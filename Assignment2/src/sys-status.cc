@@ -9,8 +9,8 @@
 
 #include <iostream>
 
-SysStatus::SysStatus(const MemAddress base)
-  : base{ base }
+SysStatus::SysStatus(const MemAddress base, std::ostream &console)
+  : base{ base }, console{ console }
 {
 }
 
@@ -49,7 +49,7 @@ SysStatus::writeByte(MemAddress addr, uint8_t value)
   if (addr != base + 0x8)
     throw IllegalAccess("Invalid system status address");
 
-  std::cerr << "System halt requested." << std::endl;
+  console << "System halt requested." << std::endl;
   shouldHaltFlag = true;
 }
 
@@ -65,7 +65,7 @@ SysStatus::writeWord(MemAddress addr, uint32_t value)
   if (addr != base + 0x8)
     throw IllegalAccess("Invalid system status address");
 
-  std::cerr << "System halt requested." << std::endl;
+  console << "System halt requested." << std::endl;
   shouldHaltFlag = true;
 }
 
@@ -80,3 +80,9 @@ SysStatus::contains(MemAddress addr) const
 {
   return base <= addr && addr < base + 0x10;
 }
+
+std::vector<AddressRange>
+SysStatus::getRanges() const
+{
+  return { { base, uint64_t{ base } + 0x10 } };
+}
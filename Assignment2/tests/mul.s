@@ -0,0 +1,20 @@
+	.text
+        .align 4
+	.globl	_start
+	.type	_start, @function
+_start:
+	l.mul 	r1,r1,r2
+	l.mul 	r1,r1,r3
+	l.add 	r6,r4,r5
+	l.mul 	r1,r1,r4
+	l.divu 	r7,r1,r2
+	l.add 	r1,r1,r5
+	l.mul 	r8,r7,r3
+	l.add 	r5,r7,r5
+	l.nop
+	l.nop
+	l.nop
+	l.nop
+	l.nop
+	.word	0x40ffccff
+	.size	_start, .-_start
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "branch-predictor.h"
+
+TEST(BranchPredictorTest, BackwardTaken) {
+    StaticBackwardTakenPredictor predictor;
+    EXPECT_TRUE(predictor.predict(0x1000, 0x0ff0));
+    EXPECT_FALSE(predictor.predict(0x1000, 0x1010));
+}
+
+TEST(BranchPredictorTest, BimodalLearnsDirection) {
+    BimodalPredictor predictor(4);
+    predictor.update(0x1000, 0x2000, false);
+    predictor.update(0x1000, 0x2000, false);
+    EXPECT_FALSE(predictor.predict(0x1000, 0x2000));
+
+    predictor.update(0x1000, 0x2000, true);
+    predictor.update(0x1000, 0x2000, true);
+    EXPECT_TRUE(predictor.predict(0x1000, 0x2000));
+}
+
+TEST(BranchPredictorTest, GShareLearnsAlternatingPattern) {
+    GSharePredictor predictor(8, 4);
+    bool taken = false;
+    for (int i = 0; i < 64; ++i, taken = !taken)
+        predictor.update(0x1000, 0x2000, taken);
+
+    int correct = 0;
+    for (int i = 0; i < 16; ++i, taken = !taken) {
+        correct += predictor.predict(0x1000, 0x2000) == taken;
+        predictor.update(0x1000, 0x2000, taken);
+    }
+    EXPECT_EQ(correct, 16);
+}
+
+TEST(BranchPredictorTest, TargetBufferRequiresPowerOfTwo) {
+    EXPECT_THROW(BranchTargetBuffer(12), std::out_of_range);
+}
+
+TEST(BranchPredictorTest, TargetBufferMatchesFullAddress) {
+    BranchTargetBuffer btb(4);
+    MemAddress target{};
+    BranchKind kind{};
+
+    btb.update(0x1000, 0x2000, BranchKind::Jump);
+    EXPECT_TRUE(btb.lookup(0x1000, target, kind));
+    EXPECT_EQ(target, 0x2000u);
+    EXPECT_EQ(kind, BranchKind::Jump);
+
+    /* Same index, different branch */
+    EXPECT_FALSE(btb.lookup(0x1010, target, kind));
+}
+
+TEST(BranchPredictorTest, ReturnAddressStackOverflowKeepsNewest) {
+    ReturnAddressStack ras(2);
+    MemAddress addr{};
+
+    ras.push(0x100);
+    ras.push(0x200);
+    ras.push(0x300);
+    EXPECT_TRUE(ras.pop(addr));
+    EXPECT_EQ(addr, 0x300u);
+    EXPECT_TRUE(ras.pop(addr));
+    EXPECT_EQ(addr, 0x200u);
+    EXPECT_FALSE(ras.pop(addr));
+}
+
+TEST(BranchPredictorTest, CallAndReturnUseStack) {
+    BranchPredictorConfig config;
+    config.type = BranchPredictorType::Bimodal;
+    BranchPredictionUnit unit(config);
+
+    /* First encounter: nothing in the BTB yet. */
+    EXPECT_FALSE(unit.predict(0x1000, 0x1004).taken);
+    unit.resolve(0x1000, BranchKind::Call, true, 0x3000, false);
+    unit.resolve(0x3010, BranchKind::Return, true, 0x1004, false);
+
+    BranchPrediction call = unit.predict(0x1000, 0x1004);
+    EXPECT_TRUE(call.taken);
+    EXPECT_EQ(call.target, 0x3000u);
+
+    BranchPrediction ret = unit.predict(0x3010, 0x3014);
+    EXPECT_TRUE(ret.taken);
+    EXPECT_EQ(ret.target, 0x1004u);
+
+    EXPECT_EQ(unit.getMispredictions(), 2u);
+}
+
+TEST(BranchPredictorTest, NotTakenFetchesSequentially) {
+    BranchPredictionUnit unit(BranchPredictorConfig{});
+
+    unit.resolve(0x1000, BranchKind::Jump, true, 0x3000, false);
+    EXPECT_FALSE(unit.predict(0x1000, 0x1004).taken);
+    EXPECT_EQ(unit.getCyclesSaved(), 0);
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include "cache.h"
+
+static CacheConfig makeConfig(size_t size, size_t lineSize, size_t assoc,
+                              ReplacementPolicy replacement) {
+    CacheConfig config;
+    config.size = size;
+    config.lineSize = lineSize;
+    config.associativity = assoc;
+    config.replacement = replacement;
+    config.hitLatency = 1;
+    config.missPenalty = 10;
+    return config;
+}
+
+TEST(CacheTest, RejectsInvalidGeometry) {
+    EXPECT_THROW(Cache("L1", makeConfig(1000, 16, 2, ReplacementPolicy::LRU)),
+                 std::out_of_range);
+    EXPECT_THROW(Cache("L1", makeConfig(32, 16, 4, ReplacementPolicy::LRU)),
+                 std::out_of_range);
+}
+
+TEST(CacheTest, MissThenHitWithinLine) {
+    Cache cache("L1", makeConfig(256, 16, 2, ReplacementPolicy::LRU));
+
+    EXPECT_EQ(cache.access(0x1000, false), 11u);
+    EXPECT_EQ(cache.access(0x100c, false), 1u);
+    EXPECT_EQ(cache.getHits(), 1u);
+    EXPECT_EQ(cache.getMisses(), 1u);
+}
+
+TEST(CacheTest, LRUEvictsLeastRecentlyUsed) {
+    /* 2 sets of 2 ways, 0x1000, 0x1020 and 0x1040 map to set 0. */
+    Cache cache("L1", makeConfig(64, 16, 2, ReplacementPolicy::LRU));
+
+    cache.access(0x1000, false);
+    cache.access(0x1020, false);
+    cache.access(0x1000, false);
+    cache.access(0x1040, false);
+
+    EXPECT_TRUE(cache.contains(0x1000));
+    EXPECT_FALSE(cache.contains(0x1020));
+    EXPECT_EQ(cache.getEvictions(), 1u);
+}
+
+TEST(CacheTest, PLRUProtectsRecentlyUsedWay) {
+    Cache cache("L1", makeConfig(64, 16, 4, ReplacementPolicy::PLRU));
+
+    for (MemAddress addr : { 0x1000, 0x1010, 0x1020, 0x1030 })
+        cache.access(addr, false);
+    cache.access(0x1000, false);
+    cache.access(0x1040, false);
+
+    EXPECT_TRUE(cache.contains(0x1000));
+    EXPECT_TRUE(cache.contains(0x1040));
+    EXPECT_EQ(cache.getEvictions(), 1u);
+}
+
+TEST(CacheTest, DirtyVictimIsWrittenBack) {
+    Cache cache("L1", makeConfig(32, 16, 1, ReplacementPolicy::LRU));
+
+    cache.access(0x1000, true);
+    EXPECT_EQ(cache.access(0x1020, false), 21u);
+    EXPECT_EQ(cache.getWriteBacks(), 1u);
+}
+
+TEST(CacheTest, WriteThroughWithoutAllocate) {
+    CacheConfig config = makeConfig(64, 16, 2, ReplacementPolicy::LRU);
+    config.writeBack = false;
+    config.writeAllocate = false;
+    Cache cache("L1", config);
+
+    EXPECT_EQ(cache.access(0x1000, true), 11u);
+    EXPECT_FALSE(cache.contains(0x1000));
+    EXPECT_EQ(cache.getWriteBacks(), 0u);
+}
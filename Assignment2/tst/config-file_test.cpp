@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include "config-file.h"
+#include "machine-config.h"
+
+#include <cstdio>
+#include <fstream>
+
+static std::string writeFile(const std::string &contents) {
+    std::string filename = testing::TempDir() + "config-file_test.ini";
+    std::ofstream file(filename);
+    file << contents;
+    return filename;
+}
+
+TEST(ConfigFileTest, SkipsComments) {
+    std::string filename = writeFile("# machine\n"
+                                     "top = 1 ; global\n"
+                                     "  [l1d]   # data cache\n"
+                                     "  size = 1024\n"
+                                     "; assoc = 2\n");
+    ConfigFile file(filename);
+
+    EXPECT_TRUE(file.hasProperty("__GLOBAL", "top"));
+    EXPECT_TRUE(file.hasSection("l1d"));
+    ASSERT_EQ(file.getProperties("l1d").size(), 1u);
+    EXPECT_EQ(file.getProperties("l1d")[0].second, "1024");
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigFileTest, LoadsMachineDescription) {
+    std::string filename = writeFile("bus.clock_divider = 2\n"
+                                     "[pipeline]\n"
+                                     "enabled = yes\n"
+                                     "[platform]\n"
+                                     "serial = 0x300\n");
+    MachineConfig config;
+    config.load(filename);
+
+    EXPECT_TRUE(config.pipelining);
+    EXPECT_EQ(config.busClockDivider, 2u);
+    EXPECT_EQ(config.platform.serialBase, 0x300u);
+    std::remove(filename.c_str());
+}
+
+TEST(ConfigFileTest, RejectsOverlappingDevices) {
+    MachineConfig config;
+    config.validate();
+
+    config.set("platform.serial", "0x278");
+    EXPECT_THROW(config.validate(), std::out_of_range);
+}
+
+TEST(ConfigFileTest, RejectsBadComponentParameters) {
+    const std::vector<std::vector<std::string>> bad{
+        { "l1d.size=1000" },
+        { "l1i.size=4096", "l1i.line_size=24" },
+        { "l1d.size=4096", "l1d.assoc=3" },
+        { "l2.size=64", "l2.line_size=32", "l2.assoc=4" },
+        { "l1d.size=8192", "l1d.line_size=16", "l1d.assoc=128" },
+        { "l1d.size=4096", "l1d.line_size=2" },
+        { "l1i.size=4096", "l1i.line_size=4" },
+        { "l1d.size=4096", "l1d.prefetcher=stride",
+          "l1d.prefetch_table=0" },
+        { "bpred.btb_entries=100" },
+        { "dram.enabled=1", "dram.banks=6" },
+        { "dram.enabled=1", "dram.row_size=1000" },
+        { "ooo.enabled=1", "ooo.phys_regs=33" },
+    };
+
+    for (const auto &assignments : bad) {
+        MachineConfig config;
+        for (const auto &assignment : assignments)
+            config.set(assignment);
+        EXPECT_THROW(config.validate(), std::out_of_range) << assignments[0];
+    }
+
+    MachineConfig latency;
+    EXPECT_THROW(latency.set("l1d.hit_latency=0"), std::out_of_range);
+    EXPECT_THROW(latency.set("l1i.hit_latency=0"), std::out_of_range);
+    latency.set("l1d.size=4096");
+    latency.dataCache.hitLatency = 0;
+    EXPECT_THROW(latency.validate(), std::out_of_range);
+
+    /* Disabled parts are not checked */
+    MachineConfig config;
+    config.set("dram.banks=6");
+    config.set("ooo.phys_regs=33");
+    config.set("l1d.assoc=3");
+    config.validate();
+}
+
+TEST(ConfigFileTest, RejectsAddressesAbove4GiB) {
+    MachineConfig config;
+
+    config.set("platform.framebuffer", "0xffff0000");
+    EXPECT_EQ(config.platform.framebufferBase, 0xffff0000u);
+
+    EXPECT_THROW(config.set("platform.serial", "0x100000200"),
+                 std::out_of_range);
+    EXPECT_THROW(config.set("platform.framebuffer", "0x100000000"),
+                 std::out_of_range);
+    EXPECT_EQ(config.platform.framebufferBase, 0xffff0000u);
+
+    EXPECT_THROW(config.set("memory.heap_base", "0x100000000"),
+                 std::out_of_range);
+    EXPECT_THROW(config.set("memory.scratch_base", "0x100001000"),
+                 std::out_of_range);
+
+    config.set("memory.stack_top", "0x100000000");
+    EXPECT_THROW(config.set("memory.stack_top", "0x100001000"),
+                 std::out_of_range);
+    EXPECT_THROW(config.set("memory.stack_top", "0x110000000"),
+                 std::out_of_range);
+    EXPECT_EQ(config.ram.stackTop, 0x100000000u);
+}
+
+TEST(ConfigFileTest, PlacesRamRegions) {
+    MachineConfig config;
+    EXPECT_TRUE(config.ram.getRegions().empty());
+
+    config.set("memory.stack", "0x100000");
+    config.set("memory.heap", "0x1000");
+    config.validate();
+
+    auto regions = config.ram.getRegions();
+    ASSERT_EQ(regions.size(), 2u);
+    EXPECT_EQ(regions[0].base, 0x20000000u);
+    EXPECT_EQ(regions[1].base, 0x7ff00000u);
+
+    config.set("memory.heap_base", "0x7fff0000");
+    EXPECT_THROW(config.validate(), std::out_of_range);
+}
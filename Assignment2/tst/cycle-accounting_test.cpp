@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include "cycle-accounting.h"
+#include "memory.h"
+#include "pipeline.h"
+
+#include <algorithm>
+#include <array>
+#include <new>
+#include <sstream>
+
+TEST(CycleAccountingTest, PipelineWaitAdvancesOldestCauseFirst) {
+    PipelineWait wait;
+    StallCause cause;
+
+    wait.add(0, CycleCategory::ICacheMiss, 0x1000);
+    EXPECT_EQ(wait.getCycles(), 0u);
+
+    wait.add(3, CycleCategory::DCacheMiss, 0x1004);
+    wait.add(2, CycleCategory::Structural, 0x1008);
+    EXPECT_EQ(wait.getCycles(), 5u);
+
+    EXPECT_EQ(wait.advance(10, cause), 3u);
+    EXPECT_EQ(cause.category, CycleCategory::DCacheMiss);
+    EXPECT_EQ(cause.address, 0x1004u);
+
+    EXPECT_EQ(wait.advance(1, cause), 1u);
+    EXPECT_EQ(cause.category, CycleCategory::Structural);
+    EXPECT_EQ(wait.getCycles(), 1u);
+}
+
+TEST(CycleAccountingTest, ChargesCyclesPerFunction) {
+    SymbolTable symbols;
+    symbols.addSymbol(0x1000, 0x100, "main");
+    symbols.addSymbol(0x2000, 0x100, "helper");
+    symbols.finalize();
+
+    CycleAccounting accounting(symbols);
+    accounting.account(CycleCategory::Base, 0x1000);
+    accounting.retire(0x1000);
+    accounting.account(CycleCategory::LoadUse, 0x1004, 2);
+    accounting.account(CycleCategory::Base, 0x2000);
+    accounting.retire(0x2000);
+    accounting.account(CycleCategory::Drain, 0);
+
+    EXPECT_EQ(accounting.getCycles(), 5u);
+    EXPECT_EQ(accounting.getCycles(CycleCategory::Base), 2u);
+    EXPECT_EQ(accounting.getCycles(CycleCategory::LoadUse), 2u);
+    EXPECT_EQ(accounting.getInstructions(), 2u);
+
+    std::ostringstream os;
+    accounting.dumpStatistics(os);
+    EXPECT_NE(os.str().find("<main>: 1 instructions, 3 cycles, CPI 3.00 "
+                            "(base 1.00, load-use 2.00)"),
+              std::string::npos);
+    EXPECT_NE(os.str().find("<unknown>: 0 instructions, 1 cycles "
+                            "(drain at halt 1)"),
+              std::string::npos);
+}
+
+/* The delay slot of a call belongs to the caller, although the
+ * non-pipelined datapath has already moved PC to the callee.
+ */
+TEST(CycleAccountingTest, NonPipelinedChargesDelaySlotToCaller) {
+    static constexpr std::array<std::pair<MemAddress, uint32_t>, 4> program{ {
+        { 0x1000, 0x04000400 },     /* l.jal 0x2000 */
+        { 0x1004, NopInstructionWord },
+        { 0x2000, NopInstructionWord },
+        { 0x2004, TestEndMarker },
+    } };
+
+    auto *data = new (std::align_val_t{ 4 }, std::nothrow) std::byte[0x2000];
+    std::fill_n(data, 0x2000, std::byte{ 0 });
+    auto text = std::make_unique<Memory>("text", data, 0x1000, 0x2000, 4);
+    text->setMayWrite(true);
+    std::vector<std::unique_ptr<MemoryInterface>> clients;
+    clients.push_back(std::move(text));
+    MemoryBus bus(std::move(clients));
+    for (const auto &[address, word] : program)
+        bus.writeWord(address, word);
+
+    SymbolTable symbols;
+    symbols.addSymbol(0x1000, 0x10, "main");
+    symbols.addSymbol(0x2000, 0x10, "helper");
+    symbols.finalize();
+
+    MachineConfig config;
+    MemAddress PC = 0x1000;
+    InstructionMemory instructionMemory(bus);
+    InstructionDecoder decoder;
+    RegisterFile regfile;
+    bool flag = false;
+    DataMemory dataMemory(bus);
+    Pipeline pipeline(config, false, PC, instructionMemory, decoder,
+                      regfile, flag, dataMemory, symbols);
+
+    EXPECT_THROW({
+        for (int cycle = 0; cycle < 100; ++cycle)
+          {
+            pipeline.propagate();
+            pipeline.clockPulse();
+          }
+    }, TestEndMarkerEncountered);
+
+    std::ostringstream os;
+    pipeline.getCycleAccounting().dumpStatistics(os);
+    EXPECT_NE(os.str().find("<main>: 2 instructions"), std::string::npos);
+    EXPECT_NE(os.str().find("<helper>: 1 instructions"), std::string::npos);
+    EXPECT_EQ(os.str().find("<unknown>"), std::string::npos);
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include "dram.h"
+
+static DRAMConfig makeConfig() {
+    DRAMConfig config;
+    config.enabled = true;
+    config.banks = 2;
+    config.rowSize = 1024;
+    config.tCAS = 2;
+    config.tRCD = 3;
+    config.tRP = 4;
+    config.tBurst = 1;
+    return config;
+}
+
+TEST(DRAMTest, RejectsInvalidGeometry) {
+    DRAMConfig config = makeConfig();
+    config.banks = 3;
+    EXPECT_THROW(DRAMController(config, 1), std::out_of_range);
+}
+
+TEST(DRAMTest, RowBufferStates) {
+    DRAMController dram(makeConfig(), 1);
+
+    /* Idle bank: activate + column access + burst. */
+    EXPECT_EQ(dram.access(0x0000, false), 6u);
+    /* Open row. */
+    EXPECT_EQ(dram.access(0x0040, false), 3u);
+    /* Other row in bank 0: precharge + activate + column access + burst. */
+    EXPECT_EQ(dram.access(0x0800, true), 10u);
+    /* Bank 1 is still idle. */
+    EXPECT_EQ(dram.access(0x0400, false), 6u);
+
+    EXPECT_EQ(dram.getRowHits(), 1u);
+    EXPECT_EQ(dram.getRowEmpty(), 2u);
+    EXPECT_EQ(dram.getRowConflicts(), 1u);
+}
+
+TEST(DRAMTest, ScalesByBusClockDivider) {
+    DRAMController dram(makeConfig(), 5);
+
+    EXPECT_EQ(dram.access(0x0000, false), 30u);
+    EXPECT_EQ(dram.access(0x0000, false), 15u);
+}
+
+TEST(DRAMTest, CacheMissGoesToNextLevel) {
+    DRAMController dram(makeConfig(), 1);
+    CacheConfig config;
+    config.size = 256;
+    config.lineSize = 16;
+    config.associativity = 1;
+    Cache cache("L2", config, &dram);
+
+    EXPECT_EQ(cache.access(0x1000, false), 1u + 6u);
+    EXPECT_EQ(cache.access(0x1004, false), 1u);
+    /* Evicts the dirty line of 0x1000 first (row hit), then fills. */
+    cache.access(0x1000, true);
+    EXPECT_EQ(cache.access(0x1100, false), 1u + 3u + 3u);
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include "elf-file.h"
+#include "elf.h"
+#include "flat-memory.h"
+
+#include <cstdio>
+#include <fstream>
+
+/* A big-endian OpenRISC executable with the given PT_LOAD headers. The
+ * file is padded to size; the contents of the segments are written by
+ * the test.
+ */
+struct TestSegment {
+    uint32_t offset, vaddr, filesz, memsz, flags;
+};
+
+static void put16(std::vector<uint8_t> &image, size_t pos, uint16_t value) {
+    image[pos] = value >> 8;
+    image[pos + 1] = value;
+}
+
+static void put32(std::vector<uint8_t> &image, size_t pos, uint32_t value) {
+    for (int i = 0; i < 4; ++i)
+        image[pos + i] = value >> (24 - 8 * i);
+}
+
+static std::vector<uint8_t> makeImage(const std::vector<TestSegment> &segments,
+                                      size_t size) {
+    std::vector<uint8_t> image(size);
+    const uint8_t ident[] = { 0x7f, 'E', 'L', 'F', ELFCLASS32, ELFDATA2MSB,
+                              EV_CURRENT };
+    std::copy(std::begin(ident), std::end(ident), image.begin());
+    put16(image, 16, ET_EXEC);
+    put16(image, 18, EM_OPENRISC);
+    put32(image, 20, EV_CURRENT);
+    put32(image, 24, 0x10000);                   /* e_entry */
+    put32(image, 28, sizeof(Elf32_Ehdr));        /* e_phoff */
+    put16(image, 40, sizeof(Elf32_Ehdr));
+    put16(image, 42, sizeof(Elf32_Phdr));
+    put16(image, 44, segments.size());
+
+    size_t pos = sizeof(Elf32_Ehdr);
+    for (const auto &segment : segments) {
+        put32(image, pos, PT_LOAD);
+        put32(image, pos + 4, segment.offset);
+        put32(image, pos + 8, segment.vaddr);
+        put32(image, pos + 12, segment.vaddr);
+        put32(image, pos + 16, segment.filesz);
+        put32(image, pos + 20, segment.memsz);
+        put32(image, pos + 24, segment.flags);
+        put32(image, pos + 28, 0x1000);
+        pos += sizeof(Elf32_Phdr);
+    }
+    return image;
+}
+
+static std::string writeFile(const std::vector<uint8_t> &image) {
+    std::string filename = testing::TempDir() + "elf-file_test.bin";
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(image.data()), image.size());
+    return filename;
+}
+
+/* 8 bytes of text and a .data word followed by .bss */
+static std::vector<uint8_t> makeProgram() {
+    auto image = makeImage({ { 0x1000, 0x10000, 8, 8, PF_R | PF_X },
+                             { 0x2000, 0x20000, 4, 0x100, PF_R | PF_W } },
+                           0x2004);
+    put32(image, 0x1000, 0x12345678);
+    put32(image, 0x1004, 0x9abcdef0);
+    put32(image, 0x2000, 0xcafef00d);
+    return image;
+}
+
+TEST(ElfFileTest, LoadsSegments) {
+    std::string filename = writeFile(makeProgram());
+    ELFFile program(filename);
+
+    EXPECT_EQ(program.getEntrypoint(), 0x10000u);
+
+    auto memories = program.createMemories();
+    ASSERT_EQ(memories.size(), 2u);
+
+    MemoryInterface &text = *memories[0];
+    EXPECT_EQ(text.readWord(0x10000), 0x12345678u);
+    EXPECT_EQ(text.readWord(0x10004), 0x9abcdef0u);
+    EXPECT_FALSE(text.contains(0x10008));
+
+    MemoryInterface &data = *memories[1];
+    EXPECT_EQ(data.readWord(0x20000), 0xcafef00du);
+    data.writeWord(0x20000, 1);
+    EXPECT_EQ(data.readWord(0x20000), 1u);
+    std::remove(filename.c_str());
+}
+
+TEST(ElfFileTest, ClearsBssTail) {
+    std::string filename = writeFile(makeProgram());
+    ELFFile program(filename);
+
+    auto memories = program.createMemories();
+    ASSERT_EQ(memories.size(), 2u);
+    MemoryInterface &data = *memories[1];
+    EXPECT_EQ(data.readWord(0x20004), 0u);
+    EXPECT_EQ(data.readWord(0x200fc), 0u);
+    EXPECT_TRUE(data.contains(0x200ff));
+    EXPECT_FALSE(data.contains(0x20100));
+
+    auto flat = program.createFlatMemory();
+    EXPECT_EQ(flat->readWord(0x10004), 0x9abcdef0u);
+    EXPECT_EQ(flat->readWord(0x20000), 0xcafef00du);
+    EXPECT_EQ(flat->readWord(0x20004), 0u);
+    EXPECT_EQ(flat->readWord(0x200fc), 0u);
+    std::remove(filename.c_str());
+}
+
+TEST(ElfFileTest, RejectsSegmentsPastEndOfFile) {
+    /* The .data bytes run past the end of the file */
+    auto image = makeImage({ { 0x1000, 0x10000, 8, 8, PF_R | PF_X },
+                             { 0x2000, 0x20000, 0x10, 0x100, PF_R | PF_W } },
+                           0x2004);
+    std::string filename = writeFile(image);
+    EXPECT_THROW(ELFFile program(filename), std::runtime_error);
+
+    /* As do the program headers */
+    image = makeImage({ { 0x1000, 0x10000, 8, 8, PF_R | PF_X } }, 0x1008);
+    put16(image, 44, 200);
+    filename = writeFile(image);
+    EXPECT_THROW(ELFFile program(filename), std::runtime_error);
+    std::remove(filename.c_str());
+}
+
+TEST(ElfFileTest, RejectsSectionsPastEndOfFile) {
+    /* A section header table that is cut off by the end of the file */
+    auto image = makeProgram();
+    put32(image, 32, 0x1f00);                    /* e_shoff */
+    put16(image, 46, sizeof(Elf32_Shdr));
+    put16(image, 48, 8);
+    std::string filename = writeFile(image);
+    EXPECT_THROW(ELFFile program(filename), std::runtime_error);
+
+    /* A complete table with a .symtab that runs past the end */
+    image = makeProgram();
+    put32(image, 32, 0x1100);
+    put16(image, 46, sizeof(Elf32_Shdr));
+    put16(image, 48, 2);
+    put32(image, 0x1100 + sizeof(Elf32_Shdr) + 4, SHT_SYMTAB);
+    put32(image, 0x1100 + sizeof(Elf32_Shdr) + 16, 0x2000);
+    put32(image, 0x1100 + sizeof(Elf32_Shdr) + 20, 0x100);
+    filename = writeFile(image);
+    EXPECT_THROW(ELFFile program(filename), std::runtime_error);
+    std::remove(filename.c_str());
+}
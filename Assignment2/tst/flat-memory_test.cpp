@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include "flat-memory.h"
+
+#include <array>
+#include <cstdio>
+#include <unistd.h>
+
+TEST(FlatMemoryTest, ReadsMappedSections) {
+    const std::array<std::byte, 4> text{
+        std::byte{ 0x12 }, std::byte{ 0x34 },
+        std::byte{ 0x56 }, std::byte{ 0x78 } };
+    FlatMemory memory;
+
+    memory.map(0x10000, text.size(), text.data(), false);
+    memory.map(0x20000, 0x100, nullptr, true);
+
+    EXPECT_EQ(memory.readWord(0x10000), 0x12345678u);
+    EXPECT_EQ(memory.readHalfWord(0x10002), 0x5678u);
+    EXPECT_EQ(memory.readWord(0x20000), 0u);
+
+    memory.writeDoubleWord(0x20008, 0x0123456789abcdefu);
+    EXPECT_EQ(memory.readWord(0x2000c), 0x89abcdefu);
+    EXPECT_TRUE(memory.contains(0x200ff));
+    EXPECT_FALSE(memory.contains(0x20100));
+
+    std::shared_ptr<uint32_t[]> words(new uint32_t[1]{ 0x12345678 });
+    memory.setHostWords(0x10000, text.size(), words);
+    memory.setHostWords(0x20000, 4, words);
+    EXPECT_EQ(memory.getHostPage(0x10000).words, words.get());
+    EXPECT_EQ(memory.getHostPage(0x20000).words, nullptr);
+}
+
+TEST(FlatMemoryTest, FaultsBecomeIllegalAccess) {
+    FlatMemory memory;
+
+    memory.map(0x10000, 0x100, nullptr, false);
+
+    EXPECT_THROW(memory.writeWord(0x10000, 1), IllegalAccess);
+    EXPECT_THROW(memory.readWord(0x40000), IllegalAccess);
+    EXPECT_THROW(memory.readWord(0xfffffffe), IllegalAccess);
+    EXPECT_EQ(memory.readWord(0x10000), 0u);
+
+    std::array<std::byte, 8> block{};
+    EXPECT_NO_THROW(memory.readBlock(0x10000, block.data(), block.size()));
+    EXPECT_THROW(memory.writeBlock(0x10000, block.data(), block.size()),
+                 IllegalAccess);
+    EXPECT_THROW(memory.readBlock(0x40000, block.data(), block.size()),
+                 IllegalAccess);
+}
+
+TEST(FlatMemoryTest, MapsFilePagesCopyOnWrite) {
+    FILE *file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    for (int i = 0; i < 0x2000; ++i)
+        std::fputc(i & 0xff, file);
+    std::fflush(file);
+
+    FlatMemory memory;
+    const int fd = fileno(file);
+
+    EXPECT_FALSE(memory.mapFile(0x10004, 0x100, fd, 0x1000, true));
+    EXPECT_TRUE(memory.mapFile(0x10004, 0x100, fd, 0x1004, true));
+    EXPECT_FALSE(memory.mapFile(0x10200, 0x100, fd, 0x1200, false));
+    EXPECT_EQ(memory.readWord(0x10004), 0x04050607u);
+
+    memory.writeWord(0x10004, 0);
+    EXPECT_EQ(memory.readWord(0x10004), 0u);
+
+    uint8_t byte = 0;
+    EXPECT_EQ(pread(fd, &byte, 1, 0x1004), 1);
+    EXPECT_EQ(byte, 0x04);
+    std::fclose(file);
+}
+
+TEST(FlatMemoryTest, ClearsSharedPagesOnly) {
+    const std::array<std::byte, 4> data{
+        std::byte{ 0xff }, std::byte{ 0xff },
+        std::byte{ 0xff }, std::byte{ 0xff } };
+    FlatMemory memory;
+
+    memory.map(0x10000, data.size(), data.data(), true);
+    memory.writeWord(0x10004, 0xffffffff);
+    memory.map(0x10004, 0x10000000, nullptr, true);
+
+    EXPECT_EQ(memory.readWord(0x10000), 0xffffffffu);
+    EXPECT_EQ(memory.readWord(0x10004), 0u);
+    EXPECT_EQ(memory.readWord(0x10000000), 0u);
+}
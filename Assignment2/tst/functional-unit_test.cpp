@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include "functional-unit.h"
+
+TEST(FunctionalUnitTest, RejectsZeroLatency) {
+    EXPECT_THROW(FunctionalUnit("Divider", FunctionalUnitConfig{ 0, false }),
+                 std::out_of_range);
+}
+
+TEST(FunctionalUnitTest, PipelinedAcceptsEveryCycle) {
+    FunctionalUnit unit("Multiplier", FunctionalUnitConfig{ 3, true });
+
+    EXPECT_EQ(unit.issue(10), 13u);
+    EXPECT_FALSE(unit.isFree(10));
+    EXPECT_TRUE(unit.isFree(11));
+    EXPECT_EQ(unit.issue(11), 14u);
+    EXPECT_EQ(unit.getOperations(), 2u);
+}
+
+TEST(FunctionalUnitTest, UnpipelinedBusyForLatency) {
+    FunctionalUnit unit("Divider", FunctionalUnitConfig{ 4, false });
+
+    EXPECT_EQ(unit.issue(10), 14u);
+    EXPECT_FALSE(unit.isFree(13));
+    EXPECT_TRUE(unit.isFree(14));
+}
+
+TEST(FunctionalUnitTest, ResultsWrittenBackWhenReady) {
+    FunctionalUnits units(FunctionalUnitConfig{ 3, true },
+                          FunctionalUnitConfig{ 8, false });
+
+    units.reserve(1, units.divider, 3);
+    units.reserve(2, units.multiplier, 4);
+    EXPECT_TRUE(units.isPending(3));
+    EXPECT_TRUE(units.isPending(4));
+    EXPECT_FALSE(units.isPending(5));
+
+    /* Not written back before EX computed the value. */
+    EXPECT_EQ(units.getCompleted(100), nullptr);
+
+    units.complete(1, 42, 10);
+    units.complete(2, 7, 11);
+
+    /* The younger multiply finishes first. */
+    const FunctionalUnits::Result *result = units.getCompleted(15);
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->sequence, 2u);
+    EXPECT_EQ(result->value, 7u);
+    units.retire(result->sequence);
+    EXPECT_FALSE(units.isPending(4));
+
+    EXPECT_EQ(units.getCompleted(18), nullptr);
+    result = units.getCompleted(19);
+    ASSERT_NE(result, nullptr);
+    EXPECT_EQ(result->rd, 3);
+}
+
+TEST(FunctionalUnitTest, DrainDropsUnfinishedInstructions) {
+    FunctionalUnits units(FunctionalUnitConfig{ 3, true },
+                          FunctionalUnitConfig{ 8, false });
+
+    units.reserve(1, units.divider, 3);
+    units.reserve(2, units.multiplier, 4);
+    units.reserve(3, units.multiplier, 5);
+    units.complete(1, 42, 10);
+    units.complete(2, 7, 12);
+
+    /* Halt after cycle 12: the multiply in EX during that cycle and the
+     * one still in ID are squashed, the divide finishes in cycle 19.
+     */
+    EXPECT_EQ(units.drain(12), 7u);
+    EXPECT_TRUE(units.isPending(3));
+    EXPECT_FALSE(units.isPending(4));
+    EXPECT_FALSE(units.isPending(5));
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "memory-bus.h"
+#include "memory.h"
+#include "serial.h"
+#include "sys-status.h"
+
+#include <algorithm>
+#include <array>
+#include <new>
+#include <sstream>
+
+static BusArbitrationConfig makeConfig(bool unified, BusPort priority,
+                                       unsigned int turnaround = 0) {
+    BusArbitrationConfig config;
+    config.unified = unified;
+    config.priority = priority;
+    config.turnaround = turnaround;
+    return config;
+}
+
+TEST(MemoryBusTest, SplitPortsNeverWait) {
+    MemoryBus bus({});
+    uint64_t clock = 5;
+    bus.setArbitration(makeConfig(false, BusPort::Data), clock);
+
+    EXPECT_EQ(bus.acquirePort(BusPort::Fetch, 10), 0u);
+    EXPECT_EQ(bus.acquirePort(BusPort::Data, 10), 0u);
+    EXPECT_EQ(bus.getConflicts(), 0u);
+}
+
+TEST(MemoryBusTest, UnifiedPortMakesOtherPortWait) {
+    MemoryBus bus({});
+    uint64_t clock = 5;
+    bus.setArbitration(makeConfig(true, BusPort::Fetch, 1), clock);
+
+    EXPECT_EQ(bus.acquirePort(BusPort::Fetch, 3), 0u);
+    EXPECT_EQ(bus.acquirePort(BusPort::Data, 1), 4u);
+    EXPECT_EQ(bus.getConflicts(), 1u);
+    EXPECT_EQ(bus.getContentionCycles(BusPort::Data), 4u);
+
+    /* A hit in the cache does not use the port. */
+    EXPECT_EQ(bus.acquirePort(BusPort::Data, 0), 0u);
+}
+
+TEST(MemoryBusTest, PriorityPortOvertakesWaitingTransfer) {
+    MemoryBus bus({});
+    uint64_t clock = 5;
+    bus.setArbitration(makeConfig(true, BusPort::Data), clock);
+
+    /* The fetch started in this cycle; the data transfer waits. */
+    EXPECT_EQ(bus.acquirePort(BusPort::Fetch, 1), 0u);
+    EXPECT_EQ(bus.acquirePort(BusPort::Data, 2), 1u);
+
+    /* The next fetch waits for the data transfer. */
+    EXPECT_EQ(bus.acquirePort(BusPort::Fetch, 1), 3u);
+    EXPECT_EQ(bus.getContentionCycles(BusPort::Fetch), 3u);
+
+    /* That fetch has not started yet and is overtaken. */
+    ++clock;
+    EXPECT_EQ(bus.acquirePort(BusPort::Data, 1), 2u);
+    EXPECT_EQ(bus.getContentionCycles(BusPort::Data), 3u);
+}
+
+TEST(MemoryBusTest, DecodesAddressesWithMap) {
+    std::vector<std::unique_ptr<MemoryInterface>> clients;
+    auto *data = new (std::align_val_t{ 4 }, std::nothrow) std::byte[0x2000];
+    std::fill_n(data, 0x2000, std::byte{ 0 });
+    clients.push_back(std::make_unique<Memory>("data", data, 0x1ff000,
+                                               0x2000, 4));
+    std::ostringstream console;
+    MemoryBus bus(std::move(clients));
+    bus.addClient(std::make_unique<Serial>(0x200, console));
+    bus.addClient(std::make_unique<SysStatus>(0x270, console));
+
+    EXPECT_TRUE(bus.isCacheable(0x1ff000));
+    EXPECT_TRUE(bus.isCacheable(0x200fff));
+    EXPECT_FALSE(bus.isCacheable(0x201000));
+    EXPECT_FALSE(bus.isCacheable(0x1fefff));
+    EXPECT_EQ(bus.readWord(0x200ffc), 0u);
+    EXPECT_THROW(bus.readWord(0x201000), IllegalAccess);
+
+    /* Devices share the first page */
+    EXPECT_NO_THROW(bus.writeByte(0x200, 'x'));
+    EXPECT_THROW(bus.writeByte(0x201, 'x'), IllegalAccess);
+    EXPECT_THROW(bus.writeByte(0x270, 0), IllegalAccess);
+    EXPECT_NO_THROW(bus.writeByte(0x278, 0));
+}
+
+TEST(MemoryBusTest, SplitsBlocksBetweenClients) {
+    std::vector<std::unique_ptr<MemoryInterface>> clients;
+    for (MemAddress base : { 0x1000u, 0x1010u }) {
+        auto *data = new (std::align_val_t{ 4 }, std::nothrow) std::byte[0x10];
+        std::fill_n(data, 0x10, std::byte{ 0 });
+        auto memory = std::make_unique<Memory>("data", data, base, 0x10, 4);
+        memory->setMayWrite(true);
+        clients.push_back(std::move(memory));
+    }
+    MemoryBus bus(std::move(clients));
+
+    std::array<std::byte, 8> block{};
+    for (size_t i = 0; i < block.size(); ++i)
+        block[i] = std::byte(i + 1);
+    bus.writeBlock(0x100c, block.data(), block.size());
+    EXPECT_EQ(bus.readWord(0x100c), 0x01020304u);
+    EXPECT_EQ(bus.readWord(0x1010), 0x05060708u);
+
+    std::array<std::byte, 8> copy{};
+    bus.readBlock(0x100c, copy.data(), copy.size());
+    EXPECT_EQ(copy, block);
+    EXPECT_EQ(bus.getBytesWritten(), 8u);
+    EXPECT_EQ(bus.getBytesRead(), 16u);
+
+    /* Only the part before the fault is counted */
+    EXPECT_THROW(bus.readBlock(0x101c, copy.data(), copy.size()),
+                 IllegalAccess);
+    EXPECT_EQ(bus.getBytesRead(), 20u);
+    EXPECT_THROW(bus.writeBlock(0x2000, block.data(), block.size()),
+                 IllegalAccess);
+    EXPECT_EQ(bus.getBytesWritten(), 8u);
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "memory-control.h"
+#include "memory.h"
+#include "serial.h"
+
+#include <algorithm>
+#include <new>
+#include <sstream>
+
+static std::unique_ptr<Memory> makeMemory(MemAddress base, size_t size,
+                                          bool writable) {
+    auto *data = new (std::align_val_t{ 4 }, std::nothrow) std::byte[size];
+    std::fill_n(data, size, std::byte{ 0 });
+
+    auto memory = std::make_unique<Memory>("data", data, base, size, 4);
+    memory->setMayWrite(writable);
+    return memory;
+}
+
+TEST(MemoryControlTest, AccessesHostPagesDirectly) {
+    std::vector<std::unique_ptr<MemoryInterface>> clients;
+    clients.push_back(makeMemory(0x1000, 0x2000, true));
+    MemoryBus bus(std::move(clients));
+    DataMemory memory(bus);
+
+    memory.setAddress(0x1ffe);
+    memory.setSize(2);
+    memory.setDataIn(0xbeef);
+    memory.setWriteEnable(true);
+    memory.clockPulse();
+    memory.setWriteEnable(false);
+
+    memory.setReadEnable(true);
+    memory.setAddress(0x1ffc);
+    memory.setSize(4);
+    EXPECT_EQ(memory.getDataOut(false), 0xbeefu);
+    EXPECT_EQ(bus.readWord(0x1ffc), 0xbeefu);
+
+    /* Crosses into the next page */
+    memory.setAddress(0x1ffe);
+    EXPECT_EQ(memory.getDataOut(false), 0xbeef0000u);
+
+    EXPECT_EQ(bus.getBytesWritten(), 2u);
+    EXPECT_EQ(bus.getBytesRead(), 12u);
+}
+
+TEST(MemoryControlTest, OtherAccessesUseTheBus) {
+    std::vector<std::unique_ptr<MemoryInterface>> clients;
+    clients.push_back(makeMemory(0x1000, 0x100, false));
+    std::ostringstream console;
+    MemoryBus bus(std::move(clients));
+    bus.addClient(std::make_unique<Serial>(0x200, console));
+    DataMemory memory(bus);
+
+    memory.setSize(1);
+    memory.setWriteEnable(true);
+    memory.setAddress(0x1000);
+    memory.setDataIn('x');
+    EXPECT_THROW(memory.clockPulse(), IllegalAccess);
+
+    memory.setAddress(0x200);
+    memory.clockPulse();
+    EXPECT_EQ(console.str(), "x");
+
+    memory.setWriteEnable(false);
+    memory.setReadEnable(true);
+    memory.setAddress(0x10fe);
+    memory.setSize(4);
+    EXPECT_THROW(memory.getDataOut(false), IllegalAccess);
+}
+
+TEST(MemoryControlTest, FetchesHostWords) {
+    auto text = makeMemory(0x1000, 0x10, false);
+    std::shared_ptr<uint32_t[]> words(new uint32_t[4]{ 1, 2, 3, 4 });
+    text->setHostWords(words);
+    EXPECT_THROW(text->setMayWrite(true), std::logic_error);
+
+    std::vector<std::unique_ptr<MemoryInterface>> clients;
+    clients.push_back(std::move(text));
+    MemoryBus bus(std::move(clients));
+    InstructionMemory memory(bus);
+
+    memory.setSize(4);
+    memory.setAddress(0x1008);
+    EXPECT_EQ(memory.getValue(), 3u);
+    EXPECT_EQ(bus.getBytesRead(), 4u);
+
+    /* Data reads see the memory itself */
+    memory.setSize(2);
+    EXPECT_EQ(memory.getValue(), 0u);
+}
+
+TEST(MemoryControlTest, AccessesDoubleWords) {
+    std::vector<std::unique_ptr<MemoryInterface>> clients;
+    clients.push_back(makeMemory(0x1000, 0x100, true));
+    MemoryBus bus(std::move(clients));
+    uint64_t clock = 0;
+    StoreBuffer buffer({ 4, 4 }, bus, nullptr, nullptr, clock);
+    DataMemory memory(bus, nullptr, nullptr, &buffer);
+
+    memory.setAddress(0x1008);
+    memory.setSize(8);
+    memory.setDataIn(0x0123456789abcdefu);
+    memory.setWriteEnable(true);
+    memory.clockPulse();
+    memory.setWriteEnable(false);
+
+    memory.setReadEnable(true);
+    EXPECT_EQ(memory.getDoubleWordOut(), 0x0123456789abcdefu);
+    EXPECT_THROW(memory.getDataOut(false), IllegalAccess);
+
+    buffer.flush();
+    EXPECT_EQ(bus.readWord(0x100c), 0x89abcdefu);
+}
+
+TEST(MemoryControlTest, AccessTakesAtLeastOneCycle) {
+    std::vector<std::unique_ptr<MemoryInterface>> clients;
+    clients.push_back(makeMemory(0x1000, 0x100, true));
+    MemoryBus bus(std::move(clients));
+    CacheConfig config;
+    config.size = 1024;
+    config.hitLatency = 0;
+    Cache cache("L1", config);
+    InstructionMemory fetch(bus, &cache);
+    DataMemory memory(bus, &cache);
+
+    fetch.setAddress(0x1000);
+    fetch.setSize(4);
+    fetch.getValue();
+    fetch.getValue();
+    EXPECT_EQ(fetch.getLatency(), 1u);
+
+    memory.setReadEnable(true);
+    memory.setAddress(0x1004);
+    memory.setSize(4);
+    memory.getDataOut(false);
+    EXPECT_EQ(memory.getLatency(), 1u);
+}
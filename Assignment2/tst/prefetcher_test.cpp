@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include "prefetcher.h"
+
+TEST(PrefetcherTest, NextLineProposesFollowingLines) {
+    NextLinePrefetcher prefetcher(32, 2);
+    std::vector<MemAddress> prefetches;
+
+    prefetcher.train(0x1000, 0x1004, true, prefetches);
+    EXPECT_EQ(prefetches, (std::vector<MemAddress>{ 0x1024, 0x1044 }));
+}
+
+TEST(PrefetcherTest, StrideNeedsConfidence) {
+    StridePrefetcher prefetcher(16, 1);
+    std::vector<MemAddress> prefetches;
+
+    for (MemAddress addr = 0x2000; addr < 0x2030; addr += 0x10)
+        prefetcher.train(0x100, addr, true, prefetches);
+    EXPECT_TRUE(prefetches.empty());
+
+    prefetcher.train(0x100, 0x2030, true, prefetches);
+    EXPECT_EQ(prefetches, (std::vector<MemAddress>{ 0x2040 }));
+}
+
+TEST(PrefetcherTest, StreamFollowsDescendingLines) {
+    StreamPrefetcher prefetcher(16, 4, 1);
+    std::vector<MemAddress> prefetches;
+
+    prefetcher.train(0, 0x3000, true, prefetches);
+    prefetcher.train(0, 0x2ff0, true, prefetches);
+    EXPECT_TRUE(prefetches.empty());
+
+    prefetcher.train(0, 0x2fe0, true, prefetches);
+    EXPECT_EQ(prefetches, (std::vector<MemAddress>{ 0x2fd0 }));
+}
+
+TEST(PrefetcherTest, DeltaCorrelatingReplaysPattern) {
+    DeltaCorrelatingPrefetcher prefetcher(16, 2);
+    std::vector<MemAddress> prefetches;
+
+    /* Deltas 4, 8, 4, 8, ... */
+    MemAddress addr = 0x4000;
+    prefetcher.train(0x200, addr, true, prefetches);
+    for (int i = 0; i < 4; ++i) {
+        addr += (i % 2 == 0) ? 4 : 8;
+        prefetcher.train(0x200, addr, true, prefetches);
+    }
+    ASSERT_EQ(prefetches.size(), 2u);
+    EXPECT_EQ(prefetches[0], addr + 4);
+    EXPECT_EQ(prefetches[1], addr + 12);
+}
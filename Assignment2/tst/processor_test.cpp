@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+#include "processor.h"
+
+#include <sstream>
+
+static void expectSameRun(MachineConfig config, const char *program) {
+    ELFFile elf(std::string{ TEST_PROGRAMS_DIR "/" } + program);
+    std::ostringstream skippedConsole, steppedConsole;
+
+    config.skipStalls = true;
+    Processor skipped(elf, config, false, skippedConsole);
+    ASSERT_TRUE(skipped.run()) << skippedConsole.str();
+
+    config.skipStalls = false;
+    Processor stepped(elf, config, false, steppedConsole);
+    ASSERT_TRUE(stepped.run()) << steppedConsole.str();
+
+    EXPECT_EQ(skippedConsole.str(), steppedConsole.str());
+
+    ProcessorSummary a = skipped.getSummary(), b = stepped.getSummary();
+    EXPECT_EQ(a.cycles, b.cycles);
+    EXPECT_EQ(a.instructions, b.instructions);
+    EXPECT_EQ(a.bytesRead, b.bytesRead);
+    EXPECT_EQ(a.bytesWritten, b.bytesWritten);
+
+    const CycleAccounting &x = skipped.getCycleAccounting();
+    const CycleAccounting &y = stepped.getCycleAccounting();
+    EXPECT_EQ(x.getCycles(), a.cycles);
+    for (size_t i = 0; i < static_cast<size_t>(CycleCategory::LAST); ++i) {
+        const auto category = static_cast<CycleCategory>(i);
+        EXPECT_EQ(x.getCycles(category), y.getCycles(category))
+            << getCategoryName(category);
+    }
+}
+
+TEST(ProcessorTest, SkippingStalledCyclesMatchesStepping) {
+    MachineConfig config;
+    config.set("l1i.size=512");
+    config.set("l1d.size=256");
+    config.set("l1d.assoc=1");
+    config.set("dram.enabled=1");
+    expectSameRun(config, "comp.bin");
+
+    config.pipelining = true;
+    expectSameRun(config, "comp.bin");
+    expectSameRun(config, "hello.bin");
+
+    /* Both ports on one bus, a store buffer and slow division */
+    config.set("bus.ports=unified");
+    config.set("sb.entries=4");
+    config.set("div.latency=40");
+    config.set("div.pipelined=0");
+    expectSameRun(config, "comp.bin");
+
+    config.set("ooo.enabled=1");
+    expectSameRun(config, "comp.bin");
+}
@@ -0,0 +1,318 @@
+#include <gtest/gtest.h>
+#include "stages.h"
+#include "dual-issue.h"
+#include "out-of-order.h"
+
+static ControlSignals makeControlSignals(InstructionMnemonic mnemonic) {
+    ControlSignals signals;
+    signals.setFunctionCode(mnemonic);
+    return signals;
+}
+
+TEST(HazardDetectorTest, NoDependencyReadsRegisterFile) {
+    HazardDetector detector;
+    ID_EXRegisters id_ex;
+    EX_MRegisters ex_m;
+    M_WBRegisters m_wb;
+
+    id_ex.RD = 3;
+    id_ex.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_ADD);
+
+    detector.detect(1, 2, id_ex, ex_m, m_wb);
+    EXPECT_EQ(detector.getForwardA(), InputSelectorForward::RegisterFile);
+    EXPECT_EQ(detector.getForwardB(), InputSelectorForward::RegisterFile);
+    EXPECT_FALSE(detector.getStall());
+}
+
+TEST(HazardDetectorTest, ForwardsFromExAndMem) {
+    HazardDetector detector;
+    ID_EXRegisters id_ex;
+    EX_MRegisters ex_m;
+    M_WBRegisters m_wb;
+
+    id_ex.RD = 1;
+    id_ex.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_ADDI);
+    ex_m.RD = 2;
+    ex_m.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_ORI);
+
+    detector.detect(1, 2, id_ex, ex_m, m_wb);
+    EXPECT_EQ(detector.getForwardA(), InputSelectorForward::EX_M);
+    EXPECT_EQ(detector.getForwardB(), InputSelectorForward::M_WB);
+    EXPECT_FALSE(detector.getStall());
+}
+
+TEST(HazardDetectorTest, YoungestProducerWins) {
+    HazardDetector detector;
+    ID_EXRegisters id_ex;
+    EX_MRegisters ex_m;
+    M_WBRegisters m_wb;
+
+    id_ex.RD = 5;
+    id_ex.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_ADD);
+    ex_m.RD = 5;
+    ex_m.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_ADD);
+    m_wb.RD = 5;
+    m_wb.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_ADD);
+
+    detector.detect(5, 0, id_ex, ex_m, m_wb);
+    EXPECT_EQ(detector.getForwardA(), InputSelectorForward::EX_M);
+    EXPECT_EQ(detector.getBypassA(), InputSelectorForward::RegisterFile);
+}
+
+TEST(HazardDetectorTest, WriteBackBypassesRegisterFile) {
+    HazardDetector detector;
+    ID_EXRegisters id_ex;
+    EX_MRegisters ex_m;
+    M_WBRegisters m_wb;
+
+    m_wb.RD = 7;
+    m_wb.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_LWZ);
+    m_wb.DATA_READ_FROM_MEMORY = 0x1234;
+    m_wb.ALU_RESULT = 0x8000;
+
+    detector.detect(0, 7, id_ex, ex_m, m_wb);
+    EXPECT_EQ(detector.getForwardB(), InputSelectorForward::RegisterFile);
+    EXPECT_EQ(detector.getBypassB(), InputSelectorForward::M_WB);
+    EXPECT_EQ(HazardDetector::getResult(m_wb), 0x1234u);
+}
+
+TEST(HazardDetectorTest, LoadUseStalls) {
+    HazardDetector detector;
+    ID_EXRegisters id_ex;
+    EX_MRegisters ex_m;
+    M_WBRegisters m_wb;
+
+    id_ex.RD = 4;
+    id_ex.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_LWZ);
+
+    detector.detect(0, 4, id_ex, ex_m, m_wb);
+    EXPECT_TRUE(detector.getStall());
+
+    detector.reset();
+    EXPECT_FALSE(detector.getStall());
+}
+
+TEST(HazardDetectorTest, RegisterZeroNeverConflicts) {
+    HazardDetector detector;
+    ID_EXRegisters id_ex;
+    EX_MRegisters ex_m;
+    M_WBRegisters m_wb;
+
+    id_ex.RD = 0;
+    id_ex.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_LWZ);
+
+    detector.detect(0, 0, id_ex, ex_m, m_wb);
+    EXPECT_FALSE(detector.getStall());
+    EXPECT_EQ(detector.getForwardA(), InputSelectorForward::RegisterFile);
+}
+
+TEST(HazardDetectorTest, BubblesDoNotConflict) {
+    HazardDetector detector;
+    ID_EXRegisters id_ex;
+    EX_MRegisters ex_m;
+    M_WBRegisters m_wb;
+
+    detector.detect(1, 2, id_ex, ex_m, m_wb);
+    EXPECT_FALSE(detector.getStall());
+    EXPECT_EQ(detector.getForwardA(), InputSelectorForward::RegisterFile);
+    EXPECT_EQ(detector.getForwardB(), InputSelectorForward::RegisterFile);
+}
+
+TEST(HazardDetectorTest, SplitMemoryStageDelaysLoads) {
+    HazardDetector detector;
+    ID_EXRegisters id_ex;
+    EX_MRegisters ex_m;
+    M_WBRegisters m_m2;
+    M_WBRegisters m_wb;
+
+    /* A load in MEM1 still stalls, an ALU result in MEM2 is forwarded. */
+    ex_m.RD = 4;
+    ex_m.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_LWZ);
+    m_m2.RD = 5;
+    m_m2.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_ADD);
+
+    detector.detect(4, 0, nullptr, id_ex, ex_m, &m_m2, m_wb);
+    EXPECT_TRUE(detector.getStall());
+
+    detector.detect(0, 5, nullptr, id_ex, ex_m, &m_m2, m_wb);
+    EXPECT_FALSE(detector.getStall());
+    EXPECT_EQ(detector.getForwardB(), InputSelectorForward::M_WB);
+
+    PipelineDepthConfig depth;
+    depth.memoryStages = 2;
+    EXPECT_EQ(depth.getDepth(), 6u);
+    EXPECT_EQ(depth.getLoadUsePenalty(), 2u);
+}
+
+TEST(HazardDetectorTest, RegisterReadStageShiftsForwarding) {
+    HazardDetector detector;
+    ID_EXRegisters id_rr;
+    ID_EXRegisters id_ex;
+    EX_MRegisters ex_m;
+    M_WBRegisters m_wb;
+
+    /* Producers in RR and EX are forwarded from MEM and WB; one in MEM
+     * is written back before RR reads the register file.
+     */
+    id_rr.RD = 1;
+    id_rr.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_ADD);
+    id_ex.RD = 2;
+    id_ex.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_LWZ);
+    ex_m.RD = 3;
+    ex_m.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_ADD);
+
+    detector.detect(1, 2, &id_rr, id_ex, ex_m, nullptr, m_wb);
+    EXPECT_EQ(detector.getForwardA(), InputSelectorForward::EX_M);
+    EXPECT_EQ(detector.getForwardB(), InputSelectorForward::M_WB);
+    EXPECT_FALSE(detector.getStall());
+
+    detector.detect(3, 0, &id_rr, id_ex, ex_m, nullptr, m_wb);
+    EXPECT_EQ(detector.getForwardA(), InputSelectorForward::RegisterFile);
+    EXPECT_EQ(detector.getBypassA(), InputSelectorForward::RegisterFile);
+}
+
+TEST(HazardDetectorTest, LinkRegisterForwardsReturnAddress) {
+    EX_MRegisters ex_m;
+    ex_m.PC = 0x10068;
+    ex_m.ALU_OUTPUT = 0x10000;
+    ex_m.CONTROL_SIGNALS = makeControlSignals(InstructionMnemonic::L_JAL);
+
+    EXPECT_EQ(HazardDetector::getResult(ex_m), 0x10068u);
+}
+
+TEST(BranchRedirectTest, DecisionOfIdComesFirst) {
+    EX_MRegisters ex_m;
+    ID_EXRegisters id_ex;
+    PipelineDepthConfig depth;
+
+    EXPECT_FALSE(BranchRedirect::get(ex_m, &id_ex).taken);
+
+    id_ex.PC = 0x1004;
+    id_ex.SEQUENCE = 7;
+    id_ex.BRANCH_PC = 0x2000;
+    id_ex.BRANCH_DECISION = InputSelectorIFStage::InputTwo;
+    BranchRedirect branch = BranchRedirect::get(ex_m, &id_ex);
+    EXPECT_TRUE(branch.taken);
+    EXPECT_EQ(branch.target, 0x2000u);
+    EXPECT_EQ(branch.sequence, 7u);
+
+    /* Ignored unless ID resolves branches */
+    EXPECT_FALSE(BranchRedirect::get(ex_m, nullptr).taken);
+
+    EXPECT_EQ(depth.getBranchPenalty(), 1u);
+    depth.earlyBranches = true;
+    EXPECT_EQ(depth.getBranchPenalty(), 0u);
+}
+
+/* l.addi rD,rA,imm and l.add rD,rA,rB */
+static uint32_t addi(unsigned rD, unsigned rA, unsigned imm) {
+    return (0x27u << 26) | (rD << 21) | (rA << 16) | imm;
+}
+
+static uint32_t add(unsigned rD, unsigned rA, unsigned rB) {
+    return (0x38u << 26) | (rD << 21) | (rA << 16) | (rB << 11);
+}
+
+static uint32_t lwz(unsigned rD, unsigned rA) {
+    return (0x21u << 26) | (rD << 21) | (rA << 16);
+}
+
+static uint64_t issuePair(uint32_t first, uint32_t second,
+                          IssueStatistics &statistics) {
+    DualIssueRegisters regs;
+    RegisterFile regfile;
+    SymbolTable symbols;
+    uint64_t nIssued = 0, nStalls = 0;
+    DualDecodeStage decode(regs, regfile, nIssued, nStalls, statistics,
+                           symbols, false);
+
+    IF_IDRegisters entry;
+    entry.PC = 0x1004;
+    entry.INSTRUCTION_WORD = first;
+    entry.SEQUENCE = 1;
+    regs.fetchQueue.push_back(entry);
+    entry.PC = 0x1008;
+    entry.INSTRUCTION_WORD = second;
+    entry.SEQUENCE = 2;
+    regs.fetchQueue.push_back(entry);
+
+    decode.propagate();
+    decode.clockPulse();
+    return nIssued;
+}
+
+TEST(DualIssueTest, IndependentInstructionsPair) {
+    IssueStatistics statistics;
+    EXPECT_EQ(issuePair(addi(3, 1, 1), addi(4, 2, 1), statistics), 2u);
+    EXPECT_EQ(statistics.nDualIssue, 1u);
+}
+
+TEST(DualIssueTest, DependentInstructionsDoNotPair) {
+    IssueStatistics statistics;
+    EXPECT_EQ(issuePair(addi(3, 1, 1), add(4, 3, 2), statistics), 1u);
+    EXPECT_EQ(statistics.failures[static_cast<size_t>(PairingFailure::Dependency)], 1u);
+}
+
+TEST(DualIssueTest, SingleMemoryPort) {
+    IssueStatistics statistics;
+    EXPECT_EQ(issuePair(lwz(3, 1), lwz(4, 2), statistics), 1u);
+    EXPECT_EQ(statistics.failures[static_cast<size_t>(PairingFailure::MemoryPort)], 1u);
+}
+
+static void dispatchAll(OutOfOrderCore &core,
+                        std::initializer_list<uint32_t> words) {
+    SymbolTable symbols;
+    uint64_t nIssued = 0;
+    OutOfOrderDispatchStage dispatch(core, nIssued, symbols, false);
+
+    MemAddress PC = 0x1004;
+    for (uint32_t word : words) {
+        OutOfOrderCore::FetchEntry entry;
+        entry.instruction.PC = PC;
+        entry.instruction.INSTRUCTION_WORD = word;
+        entry.instruction.SEQUENCE = (PC - 0x1000) / 4;
+        core.fetchQueue.push_back(entry);
+        PC += 4;
+    }
+
+    while (! core.fetchQueue.empty()) {
+        dispatch.propagate();
+        dispatch.clockPulse();
+        ++core.cycle;
+    }
+}
+
+TEST(OutOfOrderTest, RenamesDependentSources) {
+    OutOfOrderCore core(OutOfOrderConfig{});
+    dispatchAll(core, { addi(3, 1, 1), add(4, 3, 2), addi(3, 3, 1) });
+
+    ASSERT_EQ(core.rob.size(), 3u);
+    EXPECT_EQ(core.rob[1].srcA, core.rob[0].dest);
+    EXPECT_EQ(core.rob[2].srcA, core.rob[0].dest);
+    EXPECT_NE(core.rob[2].dest, core.rob[0].dest);
+    EXPECT_EQ(core.renameMap[3], core.rob[2].dest);
+    EXPECT_EQ(core.issueQueueUsed, 3u);
+}
+
+TEST(OutOfOrderTest, RecoveryKeepsDelaySlot) {
+    OutOfOrderCore core(OutOfOrderConfig{});
+    const size_t nFree = core.freeList.size();
+    dispatchAll(core, { addi(3, 1, 1), addi(4, 1, 1), addi(3, 1, 2),
+                        addi(5, 1, 1) });
+
+    /* Branch is instruction 1, its delay slot instruction 2. */
+    core.recover(1, 0x2000);
+
+    ASSERT_EQ(core.rob.size(), 2u);
+    EXPECT_EQ(core.renameMap[3], core.rob[0].dest);
+    EXPECT_EQ(core.renameMap[5], 5);
+    EXPECT_EQ(core.freeList.size(), nFree - 2);
+    EXPECT_TRUE(core.redirect);
+    EXPECT_EQ(core.redirectTarget, 0x2000u);
+}
+
+TEST(OutOfOrderTest, RejectsTooFewPhysicalRegisters) {
+    OutOfOrderConfig config;
+    config.physicalRegisters = OutOfOrderCore::NumLogicalRegs;
+    EXPECT_THROW(OutOfOrderCore core(config), std::out_of_range);
+}
@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include "memory.h"
+#include "store-buffer.h"
+
+#include <algorithm>
+#include <new>
+
+static std::unique_ptr<MemoryBus> makeBus() {
+    auto *data = new (std::align_val_t{ 4 }, std::nothrow) std::byte[64];
+    std::fill_n(data, 64, std::byte{ 0 });
+
+    auto memory = std::make_unique<Memory>("data", data, 0x1000, 64, 4);
+    memory->setMayWrite(true);
+
+    std::vector<std::unique_ptr<MemoryInterface>> clients;
+    clients.push_back(std::move(memory));
+    return std::make_unique<MemoryBus>(std::move(clients));
+}
+
+TEST(StoreBufferTest, CombinesStoresToSameWord) {
+    auto bus = makeBus();
+    uint64_t clock = 0;
+    StoreBuffer buffer({ 4, 4 }, *bus, nullptr, nullptr, clock);
+
+    for (MemAddress i = 0; i < 4; ++i) {
+        EXPECT_EQ(buffer.store(0x100, 0x1000 + i, 1, 0x11 * (i + 1)), 1u);
+        ++clock;
+    }
+    EXPECT_EQ(bus->readWord(0x1000), 0u);
+
+    buffer.flush();
+    EXPECT_EQ(bus->readWord(0x1000), 0x11223344u);
+    EXPECT_EQ(buffer.getCombined(), 3u);
+    EXPECT_EQ(buffer.getBusWrites(), 1u);
+}
+
+TEST(StoreBufferTest, ForwardsBufferedBytes) {
+    auto bus = makeBus();
+    uint64_t clock = 0;
+    StoreBuffer buffer({ 4, 4 }, *bus, nullptr, nullptr, clock);
+    bool covered = false;
+
+    buffer.store(0x100, 0x1002, 2, 0xbeef);
+    EXPECT_EQ(buffer.forward(0x1002, 2, 0, covered), 0xbeefu);
+    EXPECT_TRUE(covered);
+
+    EXPECT_EQ(buffer.forward(0x1000, 4, 0x12345678, covered), 0x1234beefu);
+    EXPECT_FALSE(covered);
+}
+
+TEST(StoreBufferTest, FullBufferWritesOldestEntry) {
+    auto bus = makeBus();
+    uint64_t clock = 0;
+    StoreBuffer buffer({ 1, 4 }, *bus, nullptr, nullptr, clock);
+
+    buffer.store(0x100, 0x1000, 4, 0xcafef00d);
+    buffer.store(0x104, 0x1004, 4, 0x1);
+    EXPECT_EQ(bus->readWord(0x1000), 0xcafef00du);
+    EXPECT_EQ(buffer.getOccupancy(), 1u);
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "sweep.h"
+
+#include <sstream>
+
+TEST(SweepTest, ParsesSettingsOnTopOfBase) {
+    MachineConfig base;
+    base.pipelining = true;
+    SweepPoint point;
+
+    ASSERT_TRUE(parseSweepPoint("  bpred.type=gshare\tl1d.size=1024 # fast",
+                                base, point));
+    EXPECT_EQ(point.label, "bpred.type=gshare l1d.size=1024");
+    EXPECT_TRUE(point.config.pipelining);
+    EXPECT_EQ(point.config.branchPredictor.type, BranchPredictorType::GShare);
+    EXPECT_EQ(point.config.dataCache.size, 1024u);
+}
+
+TEST(SweepTest, SkipsEmptyLines) {
+    MachineConfig base;
+    SweepPoint point;
+
+    EXPECT_FALSE(parseSweepPoint("", base, point));
+    EXPECT_FALSE(parseSweepPoint("   # comment", base, point));
+}
+
+TEST(SweepTest, RejectsUnknownParameters) {
+    MachineConfig base;
+    SweepPoint point;
+
+    EXPECT_THROW(parseSweepPoint("bpred.kind=gshare", base, point),
+                 std::invalid_argument);
+    EXPECT_THROW(parseSweepPoint("l1d.size", base, point),
+                 std::invalid_argument);
+}
+
+TEST(SweepTest, ParallelRunMatchesSerialRun) {
+    MachineConfig base;
+    base.pipelining = true;
+
+    std::vector<SweepPoint> points;
+    for (const char *line : { "pipeline.enabled=0",
+                              "bpred.type=not-taken",
+                              "bpred.type=gshare l1i.size=1024",
+                              "l1d.size=512 l1d.assoc=1",
+                              "pipeline.issue_width=2",
+                              "ooo.enabled=1",
+                              "pipeline.depth=8" }) {
+        SweepPoint point;
+        ASSERT_TRUE(parseSweepPoint(line, base, point));
+        points.push_back(point);
+    }
+
+    ELFFile program(TEST_PROGRAMS_DIR "/comp.bin");
+    std::ostringstream serial, parallel;
+
+    Sweep serialSweep(program, points, {});
+    ASSERT_TRUE(serialSweep.run(1));
+    serialSweep.dumpResults(serial);
+
+    Sweep parallelSweep(program, points, {});
+    ASSERT_TRUE(parallelSweep.run(4));
+    parallelSweep.dumpResults(parallel);
+
+    EXPECT_EQ(parallel.str(), serial.str());
+
+    /* One row per configuration, in input order */
+    std::istringstream rows(parallel.str());
+    std::string row;
+    std::getline(rows, row);
+    for (const auto &point : points) {
+        ASSERT_TRUE(std::getline(rows, row));
+        EXPECT_EQ(row.compare(0, point.label.size(), point.label), 0) << row;
+    }
+}
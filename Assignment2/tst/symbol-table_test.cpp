@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include "symbol-table.h"
+
+static void fillTable(SymbolTable &table) {
+    /* Added out of order; finalize() sorts them */
+    table.addSymbol(0x2000, 0x20, "putchar");
+    table.addSymbol(0x1000, 0x100, "main");
+    table.addSymbol(0x1000, 0, "_start");
+    table.addSymbol(0x1800, 0, "loop");
+    table.addSymbol(0x3000, 0, "end");
+    table.finalize();
+}
+
+TEST(SymbolTableTest, FindsContainingSymbol) {
+    SymbolTable table;
+    fillTable(table);
+
+    /* _start shares the address of main and is dropped */
+    EXPECT_EQ(table.size(), 4u);
+    EXPECT_EQ(table.lookup(0x1000)->name, "main");
+    EXPECT_EQ(table.lookup(0x10fc)->name, "main");
+    EXPECT_EQ(table.lookup(0x2000)->name, "putchar");
+    EXPECT_EQ(table.lookup(0x201f)->name, "putchar");
+    EXPECT_EQ(table.lookup(0x2020), nullptr);
+    EXPECT_EQ(table.lookup(0x1100), nullptr);
+}
+
+TEST(SymbolTableTest, SizelessSymbolsExtendToNextSymbol) {
+    SymbolTable table;
+    fillTable(table);
+
+    EXPECT_EQ(table.lookup(0x1800)->name, "loop");
+    EXPECT_EQ(table.lookup(0x1fff)->name, "loop");
+
+    /* The last symbol only covers its own address */
+    EXPECT_EQ(table.lookup(0x3000)->name, "end");
+    EXPECT_EQ(table.lookup(0x3004), nullptr);
+}
+
+TEST(SymbolTableTest, AddressesOutsideTheTable) {
+    SymbolTable table;
+    fillTable(table);
+
+    EXPECT_EQ(table.lookup(0), nullptr);
+    EXPECT_EQ(table.lookup(0xfff), nullptr);
+    EXPECT_EQ(table.lookup(0xffffffff), nullptr);
+
+    SymbolTable empty;
+    empty.finalize();
+    EXPECT_EQ(empty.lookup(0x1000), nullptr);
+}
+
+TEST(SymbolTableTest, HintDoesNotShadowOtherSymbols) {
+    SymbolTable table;
+    fillTable(table);
+
+    const Symbol *main = table.lookup(0x1004);
+    EXPECT_EQ(table.lookup(0x1008, main), main);
+    EXPECT_EQ(table.lookup(0x2004, main)->name, "putchar");
+    EXPECT_EQ(table.lookup(0x1100, main), nullptr);
+    EXPECT_EQ(table.lookup(0x100c, main), main);
+
+    /* A label without size ends at the next symbol */
+    const Symbol *loop = table.lookup(0x1800);
+    EXPECT_EQ(table.lookup(0x2000, loop)->name, "putchar");
+}
+
+TEST(SymbolTableTest, FormatsAddresses) {
+    SymbolTable table;
+    fillTable(table);
+
+    EXPECT_EQ(table.format(0x1000), "main");
+    EXPECT_EQ(table.format(0x10a4), "main+0xa4");
+    EXPECT_EQ(table.format(0x1804), "loop+0x4");
+    EXPECT_EQ(table.format(0x2020), "");
+}